@@ -0,0 +1,92 @@
+//*****************************************//
+//  benchutil.h
+//
+//  Port wiring shared by the benchmarks: each one opens the wrapper
+//  input and output of a backend under its own client name and
+//  connects them together.
+//
+//*****************************************//
+
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include "MidiWrapper.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char *apiName( int api )
+{
+  switch ( api ) {
+  case MIDI_API_COREMIDI: return "coremidi";
+  case MIDI_API_ALSA: return "alsa";
+  case MIDI_API_JACK: return "jack";
+  case MIDI_API_WINMM: return "winmm";
+  case MIDI_API_ALSA_RAW: return "alsaraw";
+  case MIDI_API_LOOPBACK: return "loopback";
+  }
+  return "unknown";
+}
+
+// Find the output port leading to our virtual input.
+static int findVirtualInput( const char *client )
+{
+  std::string output = std::string( client ) + " out";
+  std::vector<PortInfo> ports( getOutPortCount() + 1 );
+  int n = enumerateOutputPorts( &ports[0], ports.size() );
+  for ( int i=0; i<n && i<(int)ports.size(); i++ )
+    if ( std::strstr( ports[i].name, client ) && !std::strstr( ports[i].name, output.c_str() ) ) return i;
+  return -1;
+}
+
+// Open the input and output of the given backend, connected together,
+// with the given callback on the input.
+static bool connect( const char *client, int api, int inPort, int outPort, unsigned int queueSize,
+                     RtMidiIn::RtMidiCallback callback )
+{
+  std::string output = std::string( client ) + " out";
+  if ( !createInputEx( api, client, queueSize ) || !createOutputEx( api, output.c_str() ) ) return false;
+  RtMidiIn *midiin = static_cast<RtMidiIn *>( getMidiIn() );
+
+  if ( api == MIDI_API_LOOPBACK ) {
+    inPort = 0;
+    outPort = 0;
+  }
+  if ( inPort >= 0 && outPort >= 0 ) {
+    if ( !openInputPort( inPort ) ) return false;
+  }
+  else if ( api == MIDI_API_ALSA_RAW ) {
+    std::printf( "%s: skipped, needs a loopback cable (-i and -o)\n", apiName( api ) );
+    return false;
+  }
+  else {
+    try {
+      midiin->openVirtualPort( client );
+    }
+    catch ( RtMidiError & ) {
+      return false;
+    }
+    outPort = findVirtualInput( client );
+    if ( outPort < 0 ) {
+      std::printf( "%s: skipped, the virtual input port was not found\n", apiName( api ) );
+      return false;
+    }
+  }
+  if ( !openOutputPort( outPort ) ) return false;
+
+  midiin->ignoreTypes( false, false, false );
+  midiin->cancelCallback();
+  midiin->setCallback( callback, getDefaultInputHandle() );
+  return true;
+}
+
+static void disconnect( void )
+{
+  closeInputPort();
+  closeOutputPort();
+  destroyInput();
+  destroyOutput();
+}
+
+#endif // BENCHUTIL_H
@@ -0,0 +1,259 @@
+//*****************************************//
+//  midilatency.cpp
+//
+//  End-to-end latency and jitter benchmark.
+//
+//  Sends messages one at a time from the wrapper output to the wrapper
+//  input, on each backend, and times three stages of each message:
+//
+//    send     : return of the send call (noteOn() or RtMidiOut::sendMessage())
+//    callback : entry in the input callback (backend delivery)
+//    dequeue  : getNextMessageStruct() handing it over (notes only, the
+//               other messages are not available through the facade)
+//
+//  Loopback and virtual ports are wired automatically.  The rawmidi
+//  backend needs a physical loopback cable: give its ports with -i/-o.
+//
+//  Build (Linux):
+//    g++ -std=c++11 -O2 -Isrc benchmarks/midilatency.cpp src/*.cpp
+//        -o midilatency -lasound -lpthread
+//
+//*****************************************//
+
+#include "MidiWrapper.h"
+#include "benchutil.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The wrapper input callback, chained after ours to time its entry.
+extern "C" void incallback( double deltatime, std::vector< unsigned char > *message, void *userData );
+
+static unsigned long long now( void )
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static std::atomic<unsigned long long> callbackTime( 0 );
+static std::atomic<unsigned int> callbackTag( 0 );
+
+// Tags identify the messages: the second byte for channel messages,
+// the size for the others.
+static unsigned int messageTag( const std::vector<unsigned char> &message )
+{
+  if ( message.size() > 1 && message[0] < 0xF0 ) return message[1];
+  return message.size();
+}
+
+static void benchcallback( double deltatime, std::vector< unsigned char > *message, void *userData )
+{
+  unsigned long long t = now();
+  callbackTag.store( messageTag( *message ) );
+  callbackTime.store( t );
+  incallback( deltatime, message, userData );
+}
+
+struct MessageType {
+  const char *name;
+  bool facade;  // sent with noteOn() and read back with getNextMessageStruct()
+  unsigned int size;
+};
+
+static const MessageType messageTypes[] = {
+  { "note", true, 3 },
+  { "cc", false, 3 },
+  { "clock", false, 1 },
+  { "sysex32", false, 32 },
+  { "sysex1k", false, 1024 }
+};
+
+struct Stage {
+  const char *name;
+  std::vector<double> latencies; // microseconds
+};
+
+struct Result {
+  std::string api;
+  std::string type;
+  unsigned int sent;
+  unsigned int lost;
+  Stage stages[3];
+};
+
+static double percentile( const std::vector<double> &sorted, double q )
+{
+  if ( sorted.empty() ) return 0.0;
+  size_t i = (size_t) std::ceil( q * sorted.size() );
+  if ( i > 0 ) i--;
+  if ( i >= sorted.size() ) i = sorted.size() - 1;
+  return sorted[i];
+}
+
+static void measure( int api, const MessageType &type, unsigned int count, unsigned int intervalMicros, Result &result )
+{
+  RtMidiOut *midiout = static_cast<RtMidiOut *>( getMidiOut() );
+  const unsigned long long timeout = 500000000ULL; // 0.5 s
+  std::vector<unsigned char> message;
+
+  result.api = apiName( api );
+  result.type = type.name;
+  result.sent = 0;
+  result.lost = 0;
+  result.stages[0].name = "send";
+  result.stages[1].name = "callback";
+  result.stages[2].name = "dequeue";
+  for ( int s=0; s<3; s++ ) result.stages[s].latencies.clear();
+
+  for ( unsigned int i=0; i<count; i++ ) {
+    unsigned char tag = 1 + i % 127;
+    if ( type.size == 1 ) message.assign( 1, 0xF8 );
+    else if ( type.size == 3 ) {
+      message.resize( 3 );
+      message[0] = 0xB0;
+      message[1] = tag;
+      message[2] = 64;
+    }
+    else {
+      message.assign( type.size, 0x55 );
+      message[0] = 0xF0;
+      message[type.size - 1] = 0xF7;
+    }
+    unsigned int expected = ( type.size == 3 ) ? tag : type.size;
+
+    callbackTime.store( 0 );
+    unsigned long long t0 = now();
+    if ( type.facade ) noteOn( tag, 100 );
+    else midiout->sendMessage( &message );
+    unsigned long long tSend = now();
+    result.sent++;
+
+    unsigned long long tCallback = 0, tDequeue = 0;
+    while ( now() - t0 < timeout ) {
+      unsigned long long t = callbackTime.load();
+      if ( t && callbackTag.load() == expected ) {
+        tCallback = t;
+        break;
+      }
+    }
+    if ( tCallback && type.facade ) {
+      while ( now() - t0 < timeout ) {
+        MidiNoteMessage note = getNextMessageStruct();
+        if ( note.code != 0 ) {
+          tDequeue = now();
+          if ( note.id != tag ) tCallback = 0; // a late one
+          break;
+        }
+      }
+    }
+
+    if ( !tCallback || ( type.facade && !tDequeue ) ) result.lost++;
+    else {
+      result.stages[0].latencies.push_back( ( tSend - t0 ) / 1000.0 );
+      result.stages[1].latencies.push_back( ( tCallback - t0 ) / 1000.0 );
+      if ( type.facade ) result.stages[2].latencies.push_back( ( tDequeue - t0 ) / 1000.0 );
+    }
+
+    if ( intervalMicros ) std::this_thread::sleep_for( std::chrono::microseconds( intervalMicros ) );
+  }
+}
+
+static void report( const Result &result, std::ofstream *csv )
+{
+  for ( int s=0; s<3; s++ ) {
+    std::vector<double> sorted = result.stages[s].latencies;
+    if ( sorted.empty() ) continue;
+    std::sort( sorted.begin(), sorted.end() );
+    double mean = 0.0, variance = 0.0;
+    for ( size_t i=0; i<sorted.size(); i++ ) mean += sorted[i];
+    mean /= sorted.size();
+    for ( size_t i=0; i<sorted.size(); i++ ) variance += ( sorted[i] - mean ) * ( sorted[i] - mean );
+    double jitter = std::sqrt( variance / sorted.size() );
+
+    std::printf( "%-9s %-8s %-9s %7u %5u %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                 result.api.c_str(), result.type.c_str(), result.stages[s].name, result.sent, result.lost,
+                 sorted.front(), percentile( sorted, 0.5 ), percentile( sorted, 0.99 ),
+                 percentile( sorted, 0.999 ), sorted.back(), jitter );
+    if ( csv )
+      *csv << result.api << ',' << result.type << ',' << result.stages[s].name << ','
+           << result.sent << ',' << result.lost << ',' << sorted.front() << ','
+           << percentile( sorted, 0.5 ) << ',' << percentile( sorted, 0.99 ) << ','
+           << percentile( sorted, 0.999 ) << ',' << sorted.back() << ',' << jitter << '\n';
+  }
+}
+
+static void usage( void )
+{
+  std::printf( "\nusage: midilatency [-a api] [-n count] [-t interval] [-i inport -o outport] [-c file.csv]\n" );
+  std::printf( "    api: alsa, alsaraw, jack, loopback, coremidi, winmm or all (default, the compiled ones)\n" );
+  std::printf( "    count: messages per type (default 2000)\n" );
+  std::printf( "    interval: pause between messages in microseconds (default 1000)\n" );
+  std::printf( "    inport, outport: ports to use instead of a virtual port (needed for alsaraw)\n" );
+  std::printf( "    file.csv: also write the results there\n\n" );
+  exit( 0 );
+}
+
+int main( int argc, char *argv[] )
+{
+  std::string apiArg = "all";
+  unsigned int count = 2000, interval = 1000;
+  int inPort = -1, outPort = -1;
+  const char *csvName = 0;
+
+  for ( int i=1; i<argc; i++ ) {
+    if ( i + 1 >= argc ) usage();
+    if ( !std::strcmp( argv[i], "-a" ) ) apiArg = argv[++i];
+    else if ( !std::strcmp( argv[i], "-n" ) ) count = std::atoi( argv[++i] );
+    else if ( !std::strcmp( argv[i], "-t" ) ) interval = std::atoi( argv[++i] );
+    else if ( !std::strcmp( argv[i], "-i" ) ) inPort = std::atoi( argv[++i] );
+    else if ( !std::strcmp( argv[i], "-o" ) ) outPort = std::atoi( argv[++i] );
+    else if ( !std::strcmp( argv[i], "-c" ) ) csvName = argv[++i];
+    else usage();
+  }
+
+  int apis[16];
+  int nApis = getCompiledApis( apis, 16 );
+  if ( nApis > 16 ) nApis = 16;
+
+  std::ofstream csvFile;
+  std::ofstream *csv = 0;
+  if ( csvName ) {
+    csvFile.open( csvName );
+    if ( !csvFile ) {
+      std::printf( "cannot write %s\n", csvName );
+      return 1;
+    }
+    csvFile << "api,type,stage,sent,lost,min_us,p50_us,p99_us,p999_us,max_us,jitter_us\n";
+    csv = &csvFile;
+  }
+
+  setupEnv();
+  std::printf( "%-9s %-8s %-9s %7s %5s %9s %9s %9s %9s %9s %9s\n", "api", "type", "stage", "sent", "lost",
+               "min_us", "p50_us", "p99_us", "p99.9_us", "max_us", "jitter_us" );
+  for ( int a=0; a<nApis; a++ ) {
+    if ( apiArg != "all" && apiArg != apiName( apis[a] ) ) continue;
+    if ( !connect( "midilatency", apis[a], inPort, outPort, 1000, &benchcallback ) ) {
+      disconnect();
+      continue;
+    }
+    for ( unsigned int t=0; t<sizeof(messageTypes) / sizeof(messageTypes[0]); t++ ) {
+      Result result;
+      measure( apis[a], messageTypes[t], count, interval, result );
+      report( result, csv );
+      // Let late messages in before the next type.
+      std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+      while ( getNextMessageStruct().code != 0 ) {}
+    }
+    disconnect();
+  }
+
+  cleanupInputEnv();
+  return 0;
+}
@@ -0,0 +1,309 @@
+//*****************************************//
+//  midithroughput.cpp
+//
+//  Saturation throughput benchmark of the input pipeline.
+//
+//  Replays synthetic mixes from the wrapper output to the wrapper
+//  input, on each backend: the output sends as fast as possible (or at
+//  the given rate) while another thread drains the facade with
+//  fillWithNextNoteMessage(), as an application would.  For each
+//  backend and mix it reports:
+//
+//    sent/s      : events sent per second
+//    recv/s      : events that reached incallback per second
+//    drops       : events lost on the way (loopback queue and facade queue)
+//    allocs/ev   : heap allocations per received event, whole process
+//    cpu_us/ev   : process CPU time per received event
+//
+//  Loopback and virtual ports are wired automatically.  The rawmidi
+//  backend needs a physical loopback cable: give its ports with -i/-o.
+//
+//  Build (Linux):
+//    g++ -std=c++11 -O2 -Isrc benchmarks/midithroughput.cpp src/*.cpp
+//        -o midithroughput -lasound -lpthread
+//
+//*****************************************//
+
+#include "MidiWrapper.h"
+#include "benchutil.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The wrapper input callback, chained after ours to count what reaches it.
+extern "C" void incallback( double deltatime, std::vector< unsigned char > *message, void *userData );
+
+// Swallows what is written to it without storing it, so the discarded
+// warnings are neither allocated nor counted in the measures.
+class NullBuffer : public std::streambuf
+{
+protected:
+  int overflow( int c ) { return traits_type::not_eof( c ); }
+};
+
+// Count the heap allocations of the whole process.
+static std::atomic<unsigned long long> allocations( 0 );
+
+void *operator new( size_t size )
+{
+  allocations.fetch_add( 1, std::memory_order_relaxed );
+  void *p = std::malloc( size ? size : 1 );
+  if ( !p ) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete( void *p ) throw()
+{
+  std::free( p );
+}
+
+void *operator new[]( size_t size )
+{
+  return operator new( size );
+}
+
+void operator delete[]( void *p ) throw()
+{
+  operator delete( p );
+}
+
+static std::atomic<unsigned long long> received( 0 );
+static std::atomic<unsigned long long> drained( 0 );
+static std::atomic<bool> draining( false );
+
+static void benchcallback( double deltatime, std::vector< unsigned char > *message, void *userData )
+{
+  received.fetch_add( 1, std::memory_order_relaxed );
+  incallback( deltatime, message, userData );
+}
+
+// The messages of a mix, sent in a loop.
+struct Mix {
+  const char *name;
+  std::vector< std::vector<unsigned char> > messages;
+  unsigned int notes; // note on/off messages per loop, read back from the facade
+};
+
+static std::vector<unsigned char> message3( unsigned char status, unsigned char data1, unsigned char data2 )
+{
+  std::vector<unsigned char> message( 3 );
+  message[0] = status;
+  message[1] = data1;
+  message[2] = data2;
+  return message;
+}
+
+static std::vector<Mix> makeMixes( void )
+{
+  std::vector<Mix> mixes;
+  Mix mix;
+
+  // Dense notes: chords on and off, on channel 1 (the one the facade tracks).
+  mix.name = "notes";
+  mix.messages.clear();
+  for ( unsigned char note=36; note<96; note++ ) {
+    mix.messages.push_back( message3( 0x90, note, 100 ) );
+    mix.messages.push_back( message3( 0x80, note, 0 ) );
+  }
+  mix.notes = mix.messages.size();
+  mixes.push_back( mix );
+
+  // 1 kHz CC sweeps: modulation wheel up and down on 16 channels.
+  mix.name = "cc";
+  mix.messages.clear();
+  for ( unsigned int value=0; value<256; value++ )
+    mix.messages.push_back( message3( 0xB0 | ( value % 16 ), 1, value < 128 ? value : 255 - value ) );
+  mix.notes = 0;
+  mixes.push_back( mix );
+
+  // 24 PPQN clock, with transport.
+  mix.name = "clock";
+  mix.messages.clear();
+  mix.messages.push_back( std::vector<unsigned char>( 1, 0xFA ) );
+  for ( unsigned int tick=0; tick<96; tick++ ) mix.messages.push_back( std::vector<unsigned char>( 1, 0xF8 ) );
+  mix.messages.push_back( std::vector<unsigned char>( 1, 0xFC ) );
+  mix.notes = 0;
+  mixes.push_back( mix );
+
+  // Large sysex: 4 KB dumps.
+  mix.name = "sysex4k";
+  mix.messages.assign( 1, std::vector<unsigned char>( 4096, 0x11 ) );
+  mix.messages[0][0] = 0xF0;
+  mix.messages[0][4095] = 0xF7;
+  mix.notes = 0;
+  mixes.push_back( mix );
+
+  // Everything at once, roughly as a live rig: one clock tick, a few
+  // notes and controllers, and a sysex now and then.
+  mix.name = "mixed";
+  mix.messages.clear();
+  mix.notes = 0;
+  for ( unsigned int i=0; i<64; i++ ) {
+    mix.messages.push_back( std::vector<unsigned char>( 1, 0xF8 ) );
+    mix.messages.push_back( message3( 0x90, 48 + i % 24, 90 ) );
+    mix.messages.push_back( message3( 0xB0, 1, i * 2 ) );
+    mix.messages.push_back( message3( 0xB1, 7, 127 - i ) );
+    mix.messages.push_back( message3( 0x80, 48 + i % 24, 0 ) );
+    mix.notes += 2;
+  }
+  mix.messages.push_back( std::vector<unsigned char>( 256, 0x22 ) );
+  mix.messages.back()[0] = 0xF0;
+  mix.messages.back()[255] = 0xF7;
+  mixes.push_back( mix );
+
+  return mixes;
+}
+
+// Drain the facade like an application would.
+static void drain( void )
+{
+  MidiNoteMessage message;
+  while ( draining.load() ) {
+    message.code = 0;
+    fillWithNextNoteMessage( message );
+    if ( message.code != 0 ) drained.fetch_add( 1, std::memory_order_relaxed );
+    else std::this_thread::yield();
+  }
+  do {
+    message.code = 0;
+    fillWithNextNoteMessage( message );
+    if ( message.code != 0 ) drained.fetch_add( 1, std::memory_order_relaxed );
+  } while ( message.code != 0 );
+}
+
+// Send the mix for the given duration and report what got through.
+static void measure( int api, const Mix &mix, double duration, unsigned int rate, std::ofstream *csv )
+{
+  RtMidiOut *midiout = static_cast<RtMidiOut *>( getMidiOut() );
+  received.store( 0 );
+  drained.store( 0 );
+  draining.store( true );
+  std::thread drainer( drain );
+
+  unsigned long long sent = 0;
+  unsigned long long allocationsStart = allocations.load();
+  std::clock_t cpuStart = std::clock();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point end = start + std::chrono::microseconds( (long long) ( duration * 1000000 ) );
+  std::chrono::steady_clock::time_point t = start;
+  while ( t < end ) {
+    for ( unsigned int i=0; i<mix.messages.size(); i++ ) {
+      midiout->sendMessage( const_cast<std::vector<unsigned char> *>( &mix.messages[i] ) );
+      sent++;
+      if ( rate ) {
+        std::chrono::steady_clock::time_point due = start + std::chrono::nanoseconds( sent * 1000000000ULL / rate );
+        while ( std::chrono::steady_clock::now() < due ) {}
+      }
+    }
+    t = std::chrono::steady_clock::now();
+  }
+  double elapsed = std::chrono::duration<double>( t - start ).count();
+
+  // Let the delivery thread catch up before counting.
+  unsigned long long last;
+  do {
+    last = received.load();
+    std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+  } while ( received.load() != last );
+  draining.store( false );
+  drainer.join();
+  std::clock_t cpuEnd = std::clock();
+  unsigned long long allocationsEnd = allocations.load();
+
+  unsigned long long recv = received.load();
+  unsigned long long events = recv ? recv : 1;
+  double allocsPerEvent = (double) ( allocationsEnd - allocationsStart ) / events;
+  double cpuPerEvent = ( cpuEnd - cpuStart ) * 1000000.0 / CLOCKS_PER_SEC / events;
+  unsigned long long notesSent = sent / mix.messages.size() * mix.notes;
+  unsigned long long drops = ( sent - recv ) + ( notesSent > drained.load() ? notesSent - drained.load() : 0 );
+
+  std::printf( "%-9s %-8s %12.0f %12.0f %10llu %10llu %10.2f %10.3f\n", apiName( api ), mix.name, sent / elapsed, recv / elapsed,
+               drops, drained.load(), allocsPerEvent, cpuPerEvent );
+  if ( csv )
+    *csv << apiName( api ) << ',' << mix.name << ',' << rate << ',' << sent / elapsed << ',' << recv / elapsed << ',' << sent << ','
+        << recv << ',' << drops << ',' << drained.load() << ',' << allocsPerEvent << ',' << cpuPerEvent << '\n';
+}
+
+static void usage( void )
+{
+  std::printf( "\nusage: midithroughput [-a api] [-d seconds] [-r events/s] [-m mix] [-i inport -o outport] [-c file.csv]\n" );
+  std::printf( "    api: alsa, alsaraw, jack, loopback, coremidi, winmm or all (default, the compiled ones)\n" );
+  std::printf( "    seconds: duration of each mix (default 2)\n" );
+  std::printf( "    events/s: send rate, 0 for as fast as possible (default)\n" );
+  std::printf( "    mix: notes, cc, clock, sysex4k, mixed or all (default)\n" );
+  std::printf( "    inport, outport: ports to use instead of a virtual port (needed for alsaraw)\n" );
+  std::printf( "    file.csv: also write the results there\n\n" );
+  exit( 0 );
+}
+
+int main( int argc, char *argv[] )
+{
+  std::string apiArg = "all";
+  double duration = 2.0;
+  unsigned int rate = 0;
+  std::string mixArg = "all";
+  int inPort = -1, outPort = -1;
+  const char *csvName = 0;
+
+  for ( int i=1; i<argc; i++ ) {
+    if ( i + 1 >= argc ) usage();
+    if ( !std::strcmp( argv[i], "-a" ) ) apiArg = argv[++i];
+    else if ( !std::strcmp( argv[i], "-d" ) ) duration = std::atof( argv[++i] );
+    else if ( !std::strcmp( argv[i], "-r" ) ) rate = std::atoi( argv[++i] );
+    else if ( !std::strcmp( argv[i], "-m" ) ) mixArg = argv[++i];
+    else if ( !std::strcmp( argv[i], "-i" ) ) inPort = std::atoi( argv[++i] );
+    else if ( !std::strcmp( argv[i], "-o" ) ) outPort = std::atoi( argv[++i] );
+    else if ( !std::strcmp( argv[i], "-c" ) ) csvName = argv[++i];
+    else usage();
+  }
+
+  int apis[16];
+  int nApis = getCompiledApis( apis, 16 );
+  if ( nApis > 16 ) nApis = 16;
+
+  std::ofstream csv;
+  if ( csvName ) {
+    csv.open( csvName );
+    if ( !csv ) {
+      std::printf( "cannot write %s\n", csvName );
+      return 1;
+    }
+    csv << "api,mix,rate,sent_per_s,recv_per_s,sent,received,drops,notes_drained,allocs_per_event,cpu_us_per_event\n";
+  }
+
+  setupEnv();
+
+  // The backends report every dropped message on std::cerr, which would
+  // be the bottleneck under saturation.
+  NullBuffer discarded;
+  std::streambuf *cerrBuffer = std::cerr.rdbuf( &discarded );
+
+  std::printf( "%-9s %-8s %12s %12s %10s %10s %10s %10s\n", "api", "mix", "sent/s", "recv/s", "drops", "drained", "allocs/ev", "cpu_us/ev" );
+  std::vector<Mix> mixes = makeMixes();
+  for ( int a=0; a<nApis; a++ ) {
+    if ( apiArg != "all" && apiArg != apiName( apis[a] ) ) continue;
+    if ( !connect( "midithroughput", apis[a], inPort, outPort, 0, &benchcallback ) ) {
+      disconnect();
+      continue;
+    }
+    for ( unsigned int m=0; m<mixes.size(); m++ ) {
+      if ( mixArg != "all" && mixArg != mixes[m].name ) continue;
+      measure( apis[a], mixes[m], duration, rate, csvName ? &csv : 0 );
+    }
+    disconnect();
+  }
+
+  std::cerr.rdbuf( cerrBuffer );
+  cleanupInputEnv();
+  return 0;
+}
@@ -0,0 +1,131 @@
+/**********************************************************************/
+/*! \class MidiBlockWriter
+    \brief Double buffered file writer of the background encoders.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#include "MidiBlockWriter.h"
+
+MidiBlockWriter::MidiBlockWriter(size_t reserve, bool flushEach) : reserve(reserve), flushEach(flushEach), currentBlock(0),
+	pendingBlock(-1), writerExit(false), writeFailed(false) {
+}
+
+MidiBlockWriter::~MidiBlockWriter() {
+	close();
+}
+
+bool MidiBlockWriter::open(const std::string &path) {
+	if (file.is_open()) {
+		return false;
+	}
+	file.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+	blocks[0].reserve(reserve);
+	blocks[1].reserve(reserve);
+	blocks[0].clear();
+	blocks[1].clear();
+	currentBlock = 0;
+	pendingBlock = -1;
+	writerExit = false;
+	writeFailed = false;
+	writer = std::thread(&MidiBlockWriter::writeLoop, this);
+	return true;
+}
+
+void MidiBlockWriter::handOff() {
+	if (blocks[currentBlock].empty()) {
+		return;
+	}
+	std::unique_lock<std::mutex> lock(writerMutex);
+	while (pendingBlock >= 0) {
+		writerWakeup.wait(lock);
+	}
+	pendingBlock = currentBlock;
+	currentBlock = 1 - currentBlock;
+	blocks[currentBlock].clear();
+	lock.unlock();
+	writerWakeup.notify_all();
+}
+
+bool MidiBlockWriter::finish() {
+	if (writer.joinable()) {
+		handOff();
+		{
+			std::lock_guard<std::mutex> lock(writerMutex);
+			writerExit = true;
+		}
+		writerWakeup.notify_one();
+		writer.join();
+	}
+	return !writeFailed && file.good();
+}
+
+bool MidiBlockWriter::patch(unsigned long long offset, const void *data, size_t size) {
+	file.seekp((std::streamoff)offset);
+	file.write((const char *)data, size);
+	return file.good();
+}
+
+bool MidiBlockWriter::close() {
+	if (!file.is_open()) {
+		return false;
+	}
+	bool ok = finish();
+	file.close();
+	return ok && !file.fail();
+}
+
+void MidiBlockWriter::writeLoop() {
+	std::unique_lock<std::mutex> lock(writerMutex);
+	for (;;) {
+		while (pendingBlock < 0 && !writerExit) {
+			writerWakeup.wait(lock);
+		}
+		if (pendingBlock < 0) {
+			break;
+		}
+		int block = pendingBlock;
+		lock.unlock();
+		file.write((const char *)&blocks[block][0], blocks[block].size());
+		if (flushEach) {
+			file.flush();
+		}
+		lock.lock();
+		if (!file.good()) {
+			writeFailed = true;
+		}
+		pendingBlock = -1;
+		writerWakeup.notify_all();
+	}
+}
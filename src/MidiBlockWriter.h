@@ -0,0 +1,113 @@
+/**********************************************************************/
+/*! \class MidiBlockWriter
+    \brief Double buffered file writer of the background encoders.
+
+    An encoding thread fills one block while a writer thread writes
+    the other one to the file, so the encoder never waits on the disk
+    unless it fills a block faster than the previous one is written.
+    Used by MidiRecorder and MidiCaptureLog.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDIBLOCKWRITER_H
+#define MIDIBLOCKWRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//steady clock now, in seconds, for the timing of the background encoders
+inline double midiSteadySeconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class MidiBlockWriter {
+public:
+	/**
+	* reserve: capacity of each block
+	* flushEach: flushes the file after each block, so what is written survives a crash
+	*/
+	MidiBlockWriter(size_t reserve, bool flushEach);
+	~MidiBlockWriter();
+
+	/**
+	* creates the file and starts the writer thread
+	* returns false if already open or the file cannot be created
+	*/
+	bool open(const std::string &path);
+
+	//encoding thread: the block being filled
+	std::vector<unsigned char> &block() {
+		return blocks[currentBlock];
+	}
+
+	//encoding thread: hands the current block to the writer (waiting for it to finish the other one) and switches to the other block
+	void handOff();
+
+	/**
+	* writes the current block and stops the writer thread, the file stays open for patch()
+	* returns false if something could not be written
+	*/
+	bool finish();
+
+	//once finished: overwrites size bytes at offset (from the start of the file), returns false on failure
+	bool patch(unsigned long long offset, const void *data, size_t size);
+
+	//finishes and closes the file, returns false if something could not be written
+	bool close();
+
+private:
+	size_t reserve;
+	bool flushEach;
+	std::vector<unsigned char> blocks[2];
+	int currentBlock;
+
+	std::thread writer;
+	std::mutex writerMutex;
+	std::condition_variable writerWakeup;
+	int pendingBlock; //-1 if none
+	bool writerExit;
+	bool writeFailed;
+	std::ofstream file;
+
+	void writeLoop();
+
+	MidiBlockWriter(const MidiBlockWriter &);
+	MidiBlockWriter &operator=(const MidiBlockWriter &);
+};
+
+#endif //MIDIBLOCKWRITER_H
@@ -0,0 +1,456 @@
+/**********************************************************************/
+/*! \class MidiCaptureLog
+    \brief Compact append-only capture log of the input, for very long sessions.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#include "MidiCaptureLog.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+//status byte of the messages stored as they are (0xF4 is undefined in MIDI)
+static const unsigned char CAPTURE_RAW_STATUS = 0xF4;
+
+//hash table of the compressor: 4 byte sequences to their last position
+static const unsigned int CAPTURE_HASH_BITS = 12;
+static const unsigned int CAPTURE_MIN_MATCH = 4;
+
+static void putVarint(std::vector<unsigned char> &out, unsigned long long value) {
+	while (value >= 0x80) {
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+static bool getVarint(const unsigned char *&p, const unsigned char *end, unsigned long long &value) {
+	value = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7) {
+		unsigned char byte = *p++;
+		value |= (unsigned long long)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//bytes of a channel message with the given status
+static size_t channelMessageSize(unsigned char status) {
+	return ((status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0) ? 2 : 3;
+}
+
+//greedy LZ77 with a single candidate per hash, appends the result to out
+static void compress(const unsigned char *in, size_t size, std::vector<unsigned char> &out) {
+	std::vector<int> table(1 << CAPTURE_HASH_BITS, -1);
+	size_t literal = 0;
+	size_t i = 0;
+	while (i + CAPTURE_MIN_MATCH <= size) {
+		unsigned int sequence;
+		memcpy(&sequence, in + i, sizeof(sequence));
+		unsigned int hash = (sequence * 2654435761u) >> (32 - CAPTURE_HASH_BITS);
+		int candidate = table[hash];
+		table[hash] = (int)i;
+		if (candidate < 0 || memcmp(in + candidate, in + i, CAPTURE_MIN_MATCH) != 0) {
+			i++;
+			continue;
+		}
+		size_t length = CAPTURE_MIN_MATCH;
+		while (i + length < size && in[candidate + length] == in[i + length]) {
+			length++;
+		}
+		putVarint(out, i - literal);
+		out.insert(out.end(), in + literal, in + i);
+		putVarint(out, length - CAPTURE_MIN_MATCH);
+		putVarint(out, i - candidate);
+		i += length;
+		literal = i;
+	}
+	putVarint(out, size - literal);
+	out.insert(out.end(), in + literal, in + size);
+}
+
+//returns false if the data is corrupted or does not decompress to rawSize bytes
+static bool decompress(const unsigned char *p, const unsigned char *end, size_t rawSize, std::vector<unsigned char> &out) {
+	out.clear();
+	out.reserve(rawSize);
+	while (p < end) {
+		unsigned long long literals;
+		if (!getVarint(p, end, literals) || literals > (unsigned long long)(end - p) || out.size() + literals > rawSize) {
+			return false;
+		}
+		out.insert(out.end(), p, p + literals);
+		p += literals;
+		if (p == end) {
+			break;
+		}
+		unsigned long long length;
+		unsigned long long distance;
+		if (!getVarint(p, end, length) || !getVarint(p, end, distance) || distance == 0 || distance > out.size() ||
+			out.size() + length + CAPTURE_MIN_MATCH > rawSize) {
+			return false;
+		}
+		//byte by byte: the match may overlap what it produces
+		size_t from = out.size() - (size_t)distance;
+		for (size_t i = 0; i < length + CAPTURE_MIN_MATCH; i++) {
+			out.push_back(out[from + i]);
+		}
+	}
+	return out.size() == rawSize;
+}
+
+MidiCaptureLog::MidiCaptureLog() : ring(RING_SIZE), active(false), generation(0), events(0), drops(0), bytes(0),
+	stopping(false), firstTime(-1.0), lastTime(0), segmentOpened(0.0), runningStatus(0), output(0, true), fileSize(0) {
+	memset(&segmentHeader, 0, sizeof(segmentHeader));
+}
+
+MidiCaptureLog::~MidiCaptureLog() {
+	stop();
+}
+
+bool MidiCaptureLog::start(const std::string &path) {
+	if (active.load() || encoder.joinable()) {
+		return false;
+	}
+	if (!output.open(path)) {
+		return false;
+	}
+	MidiCaptureHeader header;
+	memcpy(header.magic, MIDI_CAPTURE_MAGIC, 4);
+	header.version = MIDI_CAPTURE_VERSION;
+	header.startTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	output.block().insert(output.block().end(), (const unsigned char *)&header, (const unsigned char *)&header + sizeof(header));
+
+	firstTime = -1.0;
+	lastTime = 0;
+	segment.reserve(SEGMENT_SIZE + 1024);
+	segment.clear();
+	index.clear();
+	fileSize = sizeof(header);
+	events.store(0);
+	drops.store(0);
+	bytes.store(sizeof(header));
+	stopping.store(false);
+	//whatever a late producer left from the previous capture is skipped by its generation
+	generation.fetch_add(1);
+	encoder = std::thread(&MidiCaptureLog::encodeLoop, this);
+	active.store(true, std::memory_order_release);
+	return true;
+}
+
+bool MidiCaptureLog::stop() {
+	if (!encoder.joinable()) {
+		return false;
+	}
+	active.store(false);
+	stopping.store(true);
+	encoder.join();
+	return output.close();
+}
+
+void MidiCaptureLog::encodeLoop() {
+	while (!stopping.load()) {
+		drain();
+		//a quiet input does not keep a segment in memory for long
+		if (!segment.empty() && midiSteadySeconds() - segmentOpened > SEGMENT_SECONDS) {
+			flushSegment();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	drain();
+	flushSegment();
+
+	//time index and trailer
+	std::vector<unsigned char> &block = output.block();
+	MidiCaptureTrailer trailer;
+	trailer.indexOffset = fileSize;
+	trailer.count = (unsigned int)index.size();
+	memcpy(trailer.magic, MIDI_CAPTURE_INDEX_MAGIC, 4);
+	if (!index.empty()) {
+		block.insert(block.end(), (const unsigned char *)&index[0], (const unsigned char *)&index[0] + index.size() * sizeof(MidiCaptureIndexEntry));
+	}
+	block.insert(block.end(), (const unsigned char *)&trailer, (const unsigned char *)&trailer + sizeof(trailer));
+	output.handOff();
+}
+
+void MidiCaptureLog::drain() {
+	unsigned int current = generation.load();
+	ring.drain([this, current](const unsigned char *message, size_t size, double time, unsigned int generation) {
+		if (generation == current) {
+			encode(message, size, time);
+		}
+	});
+}
+
+void MidiCaptureLog::encode(const unsigned char *message, size_t size, double time) {
+	if (firstTime < 0.0) {
+		firstTime = time;
+	}
+	unsigned long long microseconds = (unsigned long long)std::floor((time - firstTime) * 1000000.0 + 0.5);
+	if (microseconds < lastTime) {
+		microseconds = lastTime;
+	}
+	if (segment.empty()) {
+		//each segment stands alone: its first time is in its header, the running status starts over
+		segmentHeader.firstTime = microseconds;
+		segmentHeader.events = 0;
+		runningStatus = 0;
+		lastTime = microseconds;
+		segmentOpened = midiSteadySeconds();
+	}
+	putVarint(segment, microseconds - lastTime);
+	lastTime = microseconds;
+
+	unsigned char status = message[0];
+	if (status >= 0x80 && status < 0xF0 && size == channelMessageSize(status)) {
+		if (status != runningStatus) {
+			segment.push_back(status);
+			runningStatus = status;
+		}
+		segment.insert(segment.end(), message + 1, message + size);
+	}
+	else if (status >= 0xF0 && status != CAPTURE_RAW_STATUS) {
+		segment.push_back(status);
+		putVarint(segment, size - 1);
+		segment.insert(segment.end(), message + 1, message + size);
+	}
+	else {
+		segment.push_back(CAPTURE_RAW_STATUS);
+		putVarint(segment, size);
+		segment.insert(segment.end(), message, message + size);
+	}
+	segmentHeader.lastTime = microseconds;
+	segmentHeader.events++;
+	events.fetch_add(1, std::memory_order_relaxed);
+	if (segment.size() >= SEGMENT_SIZE) {
+		flushSegment();
+	}
+}
+
+//compresses the current segment into the current block and hands it to the writer
+void MidiCaptureLog::flushSegment() {
+	if (segment.empty()) {
+		return;
+	}
+	std::vector<unsigned char> &block = output.block();
+	size_t start = block.size();
+	block.resize(start + sizeof(MidiCaptureSegment));
+	compress(&segment[0], segment.size(), block);
+	size_t compressedSize = block.size() - start - sizeof(MidiCaptureSegment);
+	if (compressedSize >= segment.size()) {
+		//nothing to gain, stored as it is
+		block.resize(start + sizeof(MidiCaptureSegment));
+		block.insert(block.end(), segment.begin(), segment.end());
+		compressedSize = segment.size();
+	}
+	memcpy(segmentHeader.magic, MIDI_CAPTURE_SEGMENT_MAGIC, 4);
+	segmentHeader.compressedSize = (unsigned int)compressedSize;
+	segmentHeader.rawSize = (unsigned int)segment.size();
+	memcpy(&block[start], &segmentHeader, sizeof(segmentHeader));
+
+	MidiCaptureIndexEntry entry = { segmentHeader.firstTime, segmentHeader.lastTime, fileSize };
+	index.push_back(entry);
+	fileSize += block.size() - start;
+	bytes.store(fileSize, std::memory_order_relaxed);
+	segment.clear();
+	output.handOff();
+}
+
+MidiCaptureReader::MidiCaptureReader() : nextSegment(0), position(0), time(0), runningStatus(0) {
+	memset(&header, 0, sizeof(header));
+}
+
+bool MidiCaptureReader::open(const std::string &path) {
+	close();
+	file.open(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.read((char *)&header, sizeof(header)) || memcmp(header.magic, MIDI_CAPTURE_MAGIC, 4) != 0 ||
+		header.version != MIDI_CAPTURE_VERSION) {
+		close();
+		return false;
+	}
+	file.seekg(0, std::ios::end);
+	unsigned long long size = (unsigned long long)file.tellg();
+
+	//the index of a log stopped cleanly
+	MidiCaptureTrailer trailer;
+	if (size >= sizeof(header) + sizeof(trailer)) {
+		file.seekg(size - sizeof(trailer));
+		if (file.read((char *)&trailer, sizeof(trailer)) && memcmp(trailer.magic, MIDI_CAPTURE_INDEX_MAGIC, 4) == 0 &&
+			trailer.indexOffset + (unsigned long long)trailer.count * sizeof(MidiCaptureIndexEntry) + sizeof(trailer) == size) {
+			index.resize(trailer.count);
+			file.seekg(trailer.indexOffset);
+			if (trailer.count == 0 || file.read((char *)&index[0], trailer.count * sizeof(MidiCaptureIndexEntry))) {
+				return true;
+			}
+			index.clear();
+		}
+		file.clear();
+	}
+
+	//cut short: walks the segment headers, up to the last complete segment
+	unsigned long long offset = sizeof(header);
+	MidiCaptureSegment segment;
+	while (offset + sizeof(segment) <= size) {
+		file.seekg(offset);
+		if (!file.read((char *)&segment, sizeof(segment)) || memcmp(segment.magic, MIDI_CAPTURE_SEGMENT_MAGIC, 4) != 0 ||
+			offset + sizeof(segment) + segment.compressedSize > size) {
+			break;
+		}
+		MidiCaptureIndexEntry entry = { segment.firstTime, segment.lastTime, offset };
+		index.push_back(entry);
+		offset += sizeof(segment) + segment.compressedSize;
+	}
+	file.clear();
+	return true;
+}
+
+void MidiCaptureReader::close() {
+	if (file.is_open()) {
+		file.close();
+	}
+	file.clear();
+	index.clear();
+	payload.clear();
+	nextSegment = 0;
+	position = 0;
+	time = 0;
+	runningStatus = 0;
+}
+
+bool MidiCaptureReader::loadSegment(size_t segment) {
+	MidiCaptureSegment header;
+	file.seekg(index[segment].offset);
+	if (!file.read((char *)&header, sizeof(header)) || memcmp(header.magic, MIDI_CAPTURE_SEGMENT_MAGIC, 4) != 0) {
+		return false;
+	}
+	compressed.resize(header.compressedSize);
+	if (header.compressedSize > 0 && !file.read((char *)&compressed[0], header.compressedSize)) {
+		return false;
+	}
+	if (header.compressedSize == header.rawSize) {
+		payload.swap(compressed);
+	}
+	else if (header.compressedSize == 0 ||
+		!decompress(&compressed[0], &compressed[0] + compressed.size(), header.rawSize, payload)) {
+		return false;
+	}
+	position = 0;
+	time = header.firstTime;
+	runningStatus = 0;
+	return true;
+}
+
+bool MidiCaptureReader::next(double &seconds, std::vector<unsigned char> &message) {
+	while (position >= payload.size()) {
+		if (nextSegment >= index.size() || !loadSegment(nextSegment++)) {
+			payload.clear();
+			position = 0;
+			nextSegment = index.size();
+			return false;
+		}
+	}
+	const unsigned char *p = &payload[0] + position;
+	const unsigned char *end = &payload[0] + payload.size();
+	unsigned long long delta;
+	unsigned long long size;
+	if (!getVarint(p, end, delta) || p >= end) {
+		position = payload.size();
+		return false;
+	}
+	unsigned char status = *p;
+	if (status < 0xF0) {
+		//channel message, with or without its status
+		if (status & 0x80) {
+			runningStatus = status;
+			p++;
+		}
+		size = channelMessageSize(runningStatus) - 1;
+		if (runningStatus == 0 || (unsigned long long)(end - p) < size) {
+			position = payload.size();
+			return false;
+		}
+		message.assign(1, runningStatus);
+	}
+	else {
+		p++;
+		if (!getVarint(p, end, size) || (unsigned long long)(end - p) < size) {
+			position = payload.size();
+			return false;
+		}
+		message.clear();
+		if (status != CAPTURE_RAW_STATUS) {
+			message.push_back(status);
+		}
+	}
+	message.insert(message.end(), p, p + size);
+	position = (p + size) - &payload[0];
+	time += delta;
+	seconds = time / 1000000.0;
+	return true;
+}
+
+void MidiCaptureReader::seek(double seconds) {
+	unsigned long long target = seconds > 0.0 ? (unsigned long long)std::floor(seconds * 1000000.0 + 0.5) : 0;
+	//first segment that ends at or after the wanted time
+	std::vector<MidiCaptureIndexEntry>::const_iterator segment = std::lower_bound(index.begin(), index.end(), target,
+		[](const MidiCaptureIndexEntry &entry, unsigned long long target) { return entry.lastTime < target; });
+	payload.clear();
+	position = 0;
+	nextSegment = segment - index.begin();
+	if (segment == index.end() || !loadSegment(nextSegment++)) {
+		nextSegment = index.size();
+		return;
+	}
+	//skips the messages before, reading each one again from where it started
+	std::vector<unsigned char> message;
+	for (;;) {
+		size_t previousPosition = position;
+		unsigned long long previousTime = time;
+		unsigned char previousStatus = runningStatus;
+		double messageTime;
+		if (!next(messageTime, message)) {
+			return;
+		}
+		if (time >= target) {
+			position = previousPosition;
+			time = previousTime;
+			runningStatus = previousStatus;
+			return;
+		}
+	}
+}
+
+double MidiCaptureReader::duration() const {
+	return index.empty() ? 0.0 : index.back().lastTime / 1000000.0;
+}
@@ -0,0 +1,230 @@
+/**********************************************************************/
+/*! \class MidiCaptureLog
+    \brief Compact append-only capture log of the input, for very long sessions.
+
+    The input thread hands the messages over through a MidiMessageRing.
+    A background thread encodes them into segments: microsecond delta
+    times as varints, running status for channel messages.  A full
+    segment (or one older than CAPTURE_SEGMENT_SECONDS) is compressed
+    and handed to a writer thread.  Every segment starts with its own
+    header and resets the running status, so a log cut short by a crash
+    is still readable up to its last complete segment.  Stopping
+    appends a time index of the segments.
+
+    MidiCaptureReader streams a log back one segment at a time and
+    seeks through the index (or the segment headers when there is no
+    index).
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDICAPTURELOG_H
+#define MIDICAPTURELOG_H
+
+#include "MidiBlockWriter.h"
+#include "MidiMessageRing.h"
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+* layout of a capture log, all the values are little endian:
+* MidiCaptureHeader, the segments (MidiCaptureSegment and its payload), then when the log
+* was stopped cleanly the index (a MidiCaptureIndexEntry per segment) and MidiCaptureTrailer.
+*
+* Segment payload, once decompressed: for each message its delta time in microseconds from the
+* previous one (from firstTime for the first one) as a varint (7 bits per byte, least significant
+* first, high bit set on all but the last byte), then
+* - channel messages: the status byte unless it is the same as the previous one, and the data bytes
+* - anything else: the status byte, the size of the rest as a varint, the rest
+* Malformed channel messages are stored as CAPTURE_RAW_STATUS, their size as a varint and their bytes.
+*
+* Compressed payloads (compressedSize < rawSize) are sequences of: number of literal bytes (varint),
+* the literal bytes, then unless the payload ends there the match length minus 4 (varint) and the
+* distance back to copy it from (varint).
+*/
+#define MIDI_CAPTURE_MAGIC "RTMC"
+#define MIDI_CAPTURE_SEGMENT_MAGIC "SEGM"
+#define MIDI_CAPTURE_INDEX_MAGIC "RTMI"
+#define MIDI_CAPTURE_VERSION 1
+
+struct MidiCaptureHeader {
+	char magic[4];
+	unsigned int version;
+	long long startTime; //wall clock at the start of the capture, microseconds since 1970
+};
+
+struct MidiCaptureSegment {
+	char magic[4];
+	unsigned int compressedSize; //of the payload in the file, rawSize if stored uncompressed
+	unsigned int rawSize;
+	unsigned int events;
+	unsigned long long firstTime; //of its first and last messages, microseconds from the first message of the log
+	unsigned long long lastTime;
+};
+
+struct MidiCaptureIndexEntry {
+	unsigned long long firstTime;
+	unsigned long long lastTime;
+	unsigned long long offset; //of the segment header, from the start of the file
+};
+
+struct MidiCaptureTrailer {
+	unsigned long long indexOffset;
+	unsigned int count;
+	char magic[4];
+};
+
+class MidiCaptureLog {
+public:
+	//size of the input ring, and the most a segment holds before being compressed
+	static const unsigned int RING_SIZE = 256 * 1024;
+	static const unsigned int SEGMENT_SIZE = 64 * 1024;
+	static const unsigned int SEGMENT_SECONDS = 10;
+
+	MidiCaptureLog();
+	~MidiCaptureLog();
+
+	/**
+	* creates the log and starts the background threads
+	* returns false if already capturing or the file cannot be created
+	*/
+	bool start(const std::string &path);
+
+	/**
+	* writes what is left and the index, closes the log
+	* returns false if not capturing or the file could not be written
+	*/
+	bool stop();
+
+	bool isCapturing() const {
+		return active.load(std::memory_order_relaxed);
+	}
+
+	//input thread: queues the given complete message received at time (seconds, any origin)
+	void capture(const unsigned char *message, size_t size, double time) {
+		if (active.load(std::memory_order_acquire) && size > 0) {
+			if (!ring.push(message, size, time, generation.load(std::memory_order_relaxed))) {
+				drops.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//messages written, messages lost because the ring was full and bytes written, for the current (or last) capture
+	unsigned long long captured() const {
+		return events.load(std::memory_order_relaxed);
+	}
+	unsigned long long dropped() const {
+		return drops.load(std::memory_order_relaxed);
+	}
+	unsigned long long written() const {
+		return bytes.load(std::memory_order_relaxed);
+	}
+
+private:
+	MidiMessageRing ring;
+	std::atomic<bool> active;
+	std::atomic<unsigned int> generation;
+	std::atomic<unsigned long long> events;
+	std::atomic<unsigned long long> drops;
+	std::atomic<unsigned long long> bytes;
+
+	//encoding thread state
+	std::thread encoder;
+	std::atomic<bool> stopping;
+	double firstTime; //time of the first message, -1 until received
+	unsigned long long lastTime; //of the last message encoded, microseconds
+	double segmentOpened; //steady clock time of the first message of the current segment, seconds
+	std::vector<unsigned char> segment; //raw payload of the current segment
+	MidiCaptureSegment segmentHeader;
+	unsigned char runningStatus;
+	MidiBlockWriter output; //compressed segments with their header
+	std::vector<MidiCaptureIndexEntry> index;
+	unsigned long long fileSize;
+
+	void encodeLoop();
+	void drain();
+	void encode(const unsigned char *message, size_t size, double time);
+	void flushSegment();
+
+	MidiCaptureLog(const MidiCaptureLog &);
+	MidiCaptureLog &operator=(const MidiCaptureLog &);
+};
+
+class MidiCaptureReader {
+public:
+	MidiCaptureReader();
+
+	/**
+	* opens a capture log, complete or cut short
+	* returns false if it cannot be read or is not a capture log
+	*/
+	bool open(const std::string &path);
+	void close();
+
+	/**
+	* reads the next message and its time in seconds from the first message of the log
+	* returns false at the end of the log
+	*/
+	bool next(double &time, std::vector<unsigned char> &message);
+
+	//moves to the first message at or after the given time, in seconds
+	void seek(double seconds);
+
+	//wall clock at the start of the capture, microseconds since 1970
+	long long startTime() const {
+		return header.startTime;
+	}
+
+	//time of the last message, in seconds
+	double duration() const;
+
+private:
+	std::ifstream file;
+	MidiCaptureHeader header;
+	std::vector<MidiCaptureIndexEntry> index;
+	size_t nextSegment; //in the index
+	std::vector<unsigned char> payload; //of the current segment, decompressed
+	std::vector<unsigned char> compressed;
+	size_t position; //in payload
+	unsigned long long time; //of the last message read, microseconds
+	unsigned char runningStatus;
+
+	bool loadSegment(size_t segment);
+
+	MidiCaptureReader(const MidiCaptureReader &);
+	MidiCaptureReader &operator=(const MidiCaptureReader &);
+};
+
+#endif //MIDICAPTURELOG_H
@@ -0,0 +1,258 @@
+/**********************************************************************/
+/*! \class MidiChordTracker
+    \brief Chord of the held notes, kept up to date as the notes change.
+
+    The input thread reports note ons and offs.  The tracker keeps the
+    held notes as a 128 bit set per channel, their union and a count of
+    held notes per pitch class, so the 12 bit pitch-class set is updated
+    in constant time.
+    When the set (or the bass) changes, the chord is looked up in
+    precomputed 4096 entry tables: first as a chord rooted on the bass,
+    else as the first known chord with that set, its inversion given by
+    where the bass falls in the chord tones.  The result is published
+    as a single packed atomic word, so readers never wait nor recompute.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDICHORD_H
+#define MIDICHORD_H
+
+#include "MidiSeqlock.h"
+#include <atomic>
+
+class MidiChordTracker {
+public:
+	//chord qualities, NONE for sets that are not a known chord
+	enum Quality {
+		NONE = 0,
+		MAJOR, MINOR, DIMINISHED, AUGMENTED, SUS2, SUS4, POWER,
+		DOMINANT7, MAJOR7, MINOR7, HALF_DIMINISHED7, DIMINISHED7, MINOR_MAJOR7, AUGMENTED7, DOMINANT7_SUS4,
+		MAJOR6, MINOR6, ADD9, DOMINANT9, MAJOR9, MINOR9,
+		QUALITIES
+	};
+
+	struct Chord {
+		int quality; //Quality
+		int root; //pitch class 0 (C) to 11, -1 without a chord
+		int inversion; //0 root position, 1 third in the bass, 2 fifth... (index of the bass in the chord tones)
+		int bass; //pitch class of the lowest held note, -1 without notes
+		unsigned int pitchClasses; //bit n set if pitch class n is held
+	};
+
+	MidiChordTracker() : published(0), changeCount(0), pitchClasses(0), bass(-1) {
+		clearNotes();
+		tables(); //built here rather than on the input thread
+	}
+
+	//input thread only: a note on (velocity > 0) or a note off on the given channel
+	//a note is held while any channel holds it
+	void note(unsigned char channel, unsigned char note, bool on) {
+		if (resetRequest.take()) {
+			clearNotes();
+			pitchClasses = 0;
+			bass = -1;
+		}
+		note &= 0x7F;
+		unsigned long long bit = 1ULL << (note & 63);
+		unsigned long long &channelWord = channelHeld[channel & 0x0F][note >> 6];
+		if (on == ((channelWord & bit) != 0)) {
+			return;
+		}
+		channelWord ^= bit;
+		holders[note] += on ? 1 : -1;
+		if (holders[note] != (on ? 1 : 0)) {
+			//still held on another channel, or already was
+			return;
+		}
+		held[note >> 6] ^= bit;
+		unsigned int pitchClass = note % 12;
+		classCount[pitchClass] += on ? 1 : -1;
+		unsigned int set = classCount[pitchClass] > 0 ? pitchClasses | (1u << pitchClass) : pitchClasses & ~(1u << pitchClass);
+		int lowest = lowestNote();
+		int newBass = lowest < 0 ? -1 : lowest % 12;
+		if (set != pitchClasses || newBass != bass) {
+			pitchClasses = set;
+			bass = newBass;
+			publish();
+		}
+	}
+
+	//forgets the held notes, applied by the input thread on its next note
+	void reset() {
+		resetRequest.request();
+		published.store(0);
+		changeCount.fetch_add(1);
+	}
+
+	//any thread: the chord published by the last note change
+	Chord current() const {
+		unsigned int packed = published.load(std::memory_order_acquire);
+		Chord chord;
+		chord.pitchClasses = packed & 0xFFF;
+		chord.quality = (packed >> 12) & 0x1F;
+		chord.root = chord.quality != NONE ? (int)((packed >> 17) & 0xF) : -1;
+		chord.inversion = chord.quality != NONE ? (int)((packed >> 21) & 0x7) : 0;
+		chord.bass = chord.pitchClasses != 0 ? (int)((packed >> 24) & 0xF) : -1;
+		return chord;
+	}
+
+	//number of chord changes so far, to tell whether current() changed since it was last read
+	unsigned int changes() const {
+		return changeCount.load(std::memory_order_acquire);
+	}
+
+private:
+	//tables built once, shared by every tracker
+	struct Tables {
+		unsigned char rooted[4096]; //quality of the set as a chord rooted on pitch class 0
+		unsigned char quality[4096]; //first known chord with the set, any root
+		unsigned char root[4096];
+		unsigned char inversion[QUALITIES][12]; //index of an interval (from the root) in the chord tones, 7 if not one
+
+		Tables() {
+			//chord tones in stacking order: root, third, fifth, seventh, ninth
+			static const struct { unsigned char quality; unsigned char count; unsigned char tones[5]; } chords[] = {
+				{ MAJOR, 3, { 0, 4, 7 } }, { MINOR, 3, { 0, 3, 7 } }, { DIMINISHED, 3, { 0, 3, 6 } }, { AUGMENTED, 3, { 0, 4, 8 } },
+				{ SUS2, 3, { 0, 2, 7 } }, { SUS4, 3, { 0, 5, 7 } }, { POWER, 2, { 0, 7 } },
+				{ DOMINANT7, 4, { 0, 4, 7, 10 } }, { MAJOR7, 4, { 0, 4, 7, 11 } }, { MINOR7, 4, { 0, 3, 7, 10 } },
+				{ HALF_DIMINISHED7, 4, { 0, 3, 6, 10 } }, { DIMINISHED7, 4, { 0, 3, 6, 9 } }, { MINOR_MAJOR7, 4, { 0, 3, 7, 11 } },
+				{ AUGMENTED7, 4, { 0, 4, 8, 10 } }, { DOMINANT7_SUS4, 4, { 0, 5, 7, 10 } },
+				{ MAJOR6, 4, { 0, 4, 7, 9 } }, { MINOR6, 4, { 0, 3, 7, 9 } },
+				{ ADD9, 4, { 0, 4, 7, 2 } }, { DOMINANT9, 5, { 0, 4, 7, 10, 2 } }, { MAJOR9, 5, { 0, 4, 7, 11, 2 } }, { MINOR9, 5, { 0, 3, 7, 10, 2 } }
+			};
+			for (unsigned int i = 0; i < 4096; i++) {
+				rooted[i] = quality[i] = NONE;
+				root[i] = 0;
+			}
+			for (unsigned int q = 0; q < QUALITIES; q++) {
+				for (unsigned int i = 0; i < 12; i++) {
+					inversion[q][i] = 7;
+				}
+			}
+			//in priority order: the first chord listed wins when two share a set (C6 and Am7)
+			for (unsigned int c = 0; c < sizeof(chords) / sizeof(chords[0]); c++) {
+				unsigned int mask = 0;
+				for (unsigned int t = 0; t < chords[c].count; t++) {
+					mask |= 1u << chords[c].tones[t];
+					inversion[chords[c].quality][chords[c].tones[t]] = (unsigned char)t;
+				}
+				if (rooted[mask] == NONE) {
+					rooted[mask] = chords[c].quality;
+				}
+				for (unsigned int r = 0; r < 12; r++) {
+					unsigned int set = rotate(mask, r);
+					if (quality[set] == NONE) {
+						quality[set] = chords[c].quality;
+						root[set] = (unsigned char)r;
+					}
+				}
+			}
+		}
+	};
+
+	static const Tables &tables() {
+		static const Tables instance;
+		return instance;
+	}
+
+	//the set moved up by the given number of semitones
+	static unsigned int rotate(unsigned int set, unsigned int semitones) {
+		semitones %= 12;
+		return ((set << semitones) | (set >> (12 - semitones))) & 0xFFF;
+	}
+
+	std::atomic<unsigned int> published; //packed Chord, see publish
+	std::atomic<unsigned int> changeCount;
+	MidiResetRequest resetRequest;
+
+	//input thread state
+	unsigned long long channelHeld[16][2];
+	unsigned char holders[128]; //channels holding each note
+	unsigned long long held[2]; //notes held on any channel
+	int classCount[12];
+	unsigned int pitchClasses;
+	int bass;
+
+	void clearNotes() {
+		for (int c = 0; c < 16; c++) {
+			channelHeld[c][0] = channelHeld[c][1] = 0;
+		}
+		for (int n = 0; n < 128; n++) {
+			holders[n] = 0;
+		}
+		held[0] = held[1] = 0;
+		for (int i = 0; i < 12; i++) {
+			classCount[i] = 0;
+		}
+	}
+
+	int lowestNote() const {
+		for (int w = 0; w < 2; w++) {
+			unsigned long long word = held[w];
+			if (word != 0) {
+				int n = 0;
+				while (!(word & 1)) {
+					word >>= 1;
+					n++;
+				}
+				return w * 64 + n;
+			}
+		}
+		return -1;
+	}
+
+	//bits 0-11 pitch classes, 12-16 quality, 17-20 root, 21-23 inversion, 24-27 bass
+	void publish() {
+		const Tables &t = tables();
+		unsigned int quality = NONE;
+		unsigned int root = 0;
+		unsigned int inversion = 0;
+		if (bass >= 0) {
+			//a chord rooted on the bass comes first: C E G A over C is C6, over A it is Am7
+			quality = t.rooted[rotate(pitchClasses, 12 - bass)];
+			root = bass;
+			if (quality == NONE) {
+				quality = t.quality[pitchClasses];
+				root = t.root[pitchClasses];
+				inversion = quality != NONE ? t.inversion[quality][(bass + 12 - root) % 12] : 0;
+			}
+		}
+		unsigned int packed = pitchClasses | (quality << 12) | (root << 17) | ((inversion & 7) << 21) | ((bass >= 0 ? bass : 0) << 24);
+		published.store(packed, std::memory_order_release);
+		changeCount.fetch_add(1, std::memory_order_release);
+	}
+
+	MidiChordTracker(const MidiChordTracker &);
+	MidiChordTracker &operator=(const MidiChordTracker &);
+};
+
+#endif //MIDICHORD_H
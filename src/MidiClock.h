@@ -0,0 +1,246 @@
+/**********************************************************************/
+/*! \class MidiClockTracker
+    \brief Tempo, beat phase and transport state of an incoming MIDI clock.
+
+    Fed by the input thread with the realtime messages (0xF8 clock,
+    0xFA start, 0xFB continue, 0xFC stop) and the song position pointer
+    (0xF2).  The tick period is filtered by a second order delay locked
+    loop, so the tempo follows gradual changes without the jitter of the
+    transport, and jumps are taken at once.  Any thread can read the
+    state at any time in constant time: the input thread publishes it
+    through a sequence lock and never waits.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDICLOCK_H
+#define MIDICLOCK_H
+
+#include "MidiSeqlock.h"
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+
+class MidiClockTracker {
+public:
+	//MIDI clock resolution, ticks per quarter note
+	static const int PPQN = 24;
+
+	MidiClockTracker() : period(0.0), songTicks(0), running(false), tickWallTime(0.0), ticks(0),
+		loopTime(0.0), loopPeriod(0.0), previousTime(-1.0), publishPeriod(0.0), publishWallTime(0.0), pendingTicks(0), pendingRunning(false) {
+	}
+
+	//true for the messages the tracker consumes
+	static bool handles(unsigned char status) {
+		return status == 0xF8 || status == 0xFA || status == 0xFB || status == 0xFC || status == 0xF2;
+	}
+
+	/**
+	* input thread only: processes a message handled by the tracker
+	* time: backend timestamp of the message (seconds, any origin), wallTime: steady clock (seconds) when it was received
+	*/
+	void process(const unsigned char *message, size_t size, double time, double wallTime) {
+		if (resetRequest.take()) {
+			loopPeriod = 0.0;
+			previousTime = -1.0;
+			pendingTicks = 0;
+			pendingRunning = false;
+			publishPeriod = 0.0;
+			publishWallTime = 0.0;
+			publish();
+		}
+		if (size == 0) {
+			return;
+		}
+		switch (message[0]) {
+		case 0xF8:
+			tick(time);
+			if (pendingRunning) {
+				pendingTicks++;
+			}
+			publishWallTime = wallTime;
+			publish();
+			break;
+		case 0xFA:
+			//the next tick is the first one of the song
+			pendingTicks = -1;
+			pendingRunning = true;
+			publish();
+			break;
+		case 0xFB:
+			pendingRunning = true;
+			publish();
+			break;
+		case 0xFC:
+			pendingRunning = false;
+			publish();
+			break;
+		case 0xF2:
+			//song position in sixteenth notes (6 ticks), only meaningful while stopped
+			if (size >= 3) {
+				pendingTicks = (long long)((message[1] & 0x7F) | ((message[2] & 0x7F) << 7)) * 6 - 1;
+				publish();
+			}
+			break;
+		}
+	}
+
+	//forgets the tempo and the song position, applied by the input thread with the next message
+	void reset() {
+		resetRequest.request();
+	}
+
+	//tempo in beats per minute, 0 until two ticks were received or if the clock stopped for over a second
+	double bpm(double wallTime) const {
+		State s;
+		read(s);
+		if (s.period <= 0.0 || wallTime - s.tickWallTime > 1.0) {
+			return 0.0;
+		}
+		return 60.0 / (s.period * PPQN);
+	}
+
+	/**
+	* song position in beats (quarter notes) since the start, extrapolated from the last tick
+	* wallTime: the steady clock now, in seconds
+	*/
+	double beats(double wallTime) const {
+		State s;
+		read(s);
+		double position = s.songTicks < 0 ? 0.0 : (double)s.songTicks;
+		if (s.running && s.songTicks >= 0 && s.period > 0.0) {
+			//never go past the next tick, it has not been received yet
+			double fraction = (wallTime - s.tickWallTime) / s.period;
+			position += fraction < 0.0 ? 0.0 : (fraction > 0.999 ? 0.999 : fraction);
+		}
+		return position / PPQN;
+	}
+
+	//position inside the current beat [0,1)
+	double beatPhase(double wallTime) const {
+		double b = beats(wallTime);
+		return b - std::floor(b);
+	}
+
+	bool isRunning() const {
+		State s;
+		read(s);
+		return s.running;
+	}
+
+	//clock ticks received since the tracker was created
+	unsigned long long tickCount() const {
+		return ticks.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct State {
+		double period;
+		long long songTicks;
+		bool running;
+		double tickWallTime;
+	};
+
+	//published state, written by the input thread under the seqlock
+	MidiSeqlock seqlock;
+	std::atomic<double> period; //filtered tick period in seconds, 0 if unknown
+	std::atomic<long long> songTicks; //ticks since the start, -1 before the first one
+	std::atomic<bool> running;
+	std::atomic<double> tickWallTime; //steady clock time of the last tick
+	std::atomic<unsigned long long> ticks;
+	MidiResetRequest resetRequest;
+
+	//input thread state
+	double loopTime; //predicted time of the next tick
+	double loopPeriod; //filtered period, 0 until locked
+	double previousTime; //time of the previous tick, -1 if none
+	double publishPeriod;
+	double publishWallTime; //steady clock time of the last tick
+	long long pendingTicks;
+	bool pendingRunning;
+
+	//delay locked loop update with a tick received at the given time
+	void tick(double time) {
+		ticks.fetch_add(1, std::memory_order_relaxed);
+		if (previousTime < 0.0) {
+			previousTime = time;
+			return;
+		}
+		double interval = time - previousTime;
+		previousTime = time;
+		if (interval <= 0.0) {
+			return;
+		}
+		if (loopPeriod <= 0.0) {
+			//first interval: lock on it
+			loopPeriod = interval;
+			loopTime = time + interval;
+		}
+		else {
+			double error = time - loopTime;
+			if (std::fabs(error) > loopPeriod) {
+				//more than a tick off (tempo jump, lost ticks): start again from the last interval
+				loopPeriod = interval;
+				loopTime = time + interval;
+			}
+			else {
+				//critically damped loop, about one beat (24 ticks) to settle
+				const double omega = 0.05;
+				loopTime += loopPeriod + 1.41421356 * omega * error;
+				loopPeriod += omega * omega * error;
+			}
+		}
+		publishPeriod = loopPeriod;
+	}
+
+	void publish() {
+		seqlock.beginWrite();
+		period.store(publishPeriod, std::memory_order_relaxed);
+		songTicks.store(pendingTicks, std::memory_order_relaxed);
+		running.store(pendingRunning, std::memory_order_relaxed);
+		tickWallTime.store(publishWallTime, std::memory_order_relaxed);
+		seqlock.endWrite();
+	}
+
+	void read(State &state) const {
+		seqlock.read([&]() {
+			state.period = period.load(std::memory_order_relaxed);
+			state.songTicks = songTicks.load(std::memory_order_relaxed);
+			state.running = running.load(std::memory_order_relaxed);
+			state.tickWallTime = tickWallTime.load(std::memory_order_relaxed);
+		});
+	}
+
+	MidiClockTracker(const MidiClockTracker &);
+	MidiClockTracker &operator=(const MidiClockTracker &);
+};
+
+#endif //MIDICLOCK_H
@@ -0,0 +1,155 @@
+/**********************************************************************/
+/*! \class MidiInputFilter
+    \brief Input filter compiled into lookup tables.
+
+    The filter settings (message types, channels, note range and
+    controllers) are compiled into a 256 bit status bitmap, holding the
+    type and channel, plus a 128 bit mask of the first data byte per
+    channel message type, holding the note range or the controllers.
+    Checking a message costs one or two table lookups.  The tables are
+    atomics: the input thread checks messages while any other thread
+    compiles new settings, a message racing with an update may see a
+    mix of both.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDIFILTER_H
+#define MIDIFILTER_H
+
+#include <atomic>
+#include <cstddef>
+
+class MidiInputFilter {
+public:
+	//message types, combined in the types argument of compile
+	enum Type {
+		NOTE_OFF = 0x0001,
+		NOTE_ON = 0x0002,
+		POLY_AFTERTOUCH = 0x0004,
+		CONTROL_CHANGE = 0x0008,
+		PROGRAM_CHANGE = 0x0010,
+		CHANNEL_AFTERTOUCH = 0x0020,
+		PITCH_BEND = 0x0040,
+		SYSEX = 0x0080, //0xF0 and 0xF7
+		SYSTEM_COMMON = 0x0100, //0xF1 to 0xF6
+		CLOCK = 0x0200, //0xF8 to 0xFC
+		ACTIVE_SENSING = 0x0400, //0xFE
+		SYSTEM_RESET = 0x0800, //0xFF
+		ALL_TYPES = 0x0FFF
+	};
+
+	MidiInputFilter() {
+		passAll();
+	}
+
+	//lets every message through
+	void passAll() {
+		unsigned char controllers[16];
+		for (int i = 0; i < 16; i++) {
+			controllers[i] = 0xFF;
+		}
+		compile(ALL_TYPES, 0xFFFF, 0, 127, controllers);
+	}
+
+	/**
+	* builds the tables from the given settings
+	* types: combination of Type, channels: bit n for channel n+1
+	* noteLow, noteHigh: inclusive range of the notes (note on/off and poly aftertouch)
+	* controllers: 128 bit set, bit (n & 7) of byte n / 8 for controller n
+	*/
+	void compile(unsigned int types, unsigned int channels, unsigned char noteLow, unsigned char noteHigh, const unsigned char controllers[16]) {
+		unsigned int status[8] = { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0, 0, 0, 0 }; //not status bytes, let through
+		for (unsigned int type = 0; type < 7; type++) {
+			if (!(types & (1u << type))) {
+				continue;
+			}
+			for (unsigned int channel = 0; channel < 16; channel++) {
+				if (channels & (1u << channel)) {
+					unsigned int s = 0x80 + (type << 4) + channel;
+					status[s >> 5] |= 1u << (s & 31);
+				}
+			}
+		}
+		static const struct { unsigned char first, last; unsigned int type; } system[] = {
+			{ 0xF0, 0xF0, SYSEX }, { 0xF7, 0xF7, SYSEX }, { 0xF1, 0xF6, SYSTEM_COMMON },
+			{ 0xF8, 0xFD, CLOCK }, { 0xFE, 0xFE, ACTIVE_SENSING }, { 0xFF, 0xFF, SYSTEM_RESET }
+		};
+		for (unsigned int i = 0; i < sizeof(system) / sizeof(system[0]); i++) {
+			for (unsigned int s = system[i].first; s <= system[i].last; s++) {
+				if (types & system[i].type) {
+					status[s >> 5] |= 1u << (s & 31);
+				}
+			}
+		}
+		unsigned int notes[4] = { 0, 0, 0, 0 };
+		for (unsigned int n = noteLow; n <= noteHigh && n < 128; n++) {
+			notes[n >> 5] |= 1u << (n & 31);
+		}
+		for (unsigned int type = 0; type < 8; type++) {
+			for (unsigned int w = 0; w < 4; w++) {
+				unsigned int mask = 0xFFFFFFFF;
+				if (type == 0 || type == 1 || type == 2) {
+					mask = notes[w];
+				}
+				else if (type == 3) {
+					mask = controllers[w * 4] | (controllers[w * 4 + 1] << 8) | (controllers[w * 4 + 2] << 16) | ((unsigned int)controllers[w * 4 + 3] << 24);
+				}
+				data[type][w].store(mask, std::memory_order_relaxed);
+			}
+		}
+		for (unsigned int w = 0; w < 8; w++) {
+			statusMask[w].store(status[w], std::memory_order_relaxed);
+		}
+	}
+
+	//true if the given (complete) message passes the filter
+	bool accepts(const unsigned char *message, size_t size) const {
+		unsigned int status = message[0];
+		if (!(statusMask[status >> 5].load(std::memory_order_relaxed) & (1u << (status & 31)))) {
+			return false;
+		}
+		if (status >= 0x80 && status < 0xF0 && size > 1) {
+			unsigned int d = message[1] & 0x7F;
+			return (data[(status >> 4) & 7][d >> 5].load(std::memory_order_relaxed) & (1u << (d & 31))) != 0;
+		}
+		return true;
+	}
+
+private:
+	std::atomic<unsigned int> statusMask[8]; //bit per status byte
+	std::atomic<unsigned int> data[8][4]; //bit per first data byte value, per channel message type
+
+	MidiInputFilter(const MidiInputFilter &);
+	MidiInputFilter &operator=(const MidiInputFilter &);
+};
+
+#endif //MIDIFILTER_H
@@ -0,0 +1,261 @@
+/**********************************************************************/
+/*! \class MidiLooper
+    \brief Live looper of the input channel messages, with overdub.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#include "MidiLooper.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+//longest wait of the timing thread, how late the recorded events are merged at worst
+static const double LOOPER_MERGE_PERIOD = 0.005;
+
+static double steadyNow() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MidiLooper::MidiLooper() : mode(IDLE), origin(0.0), loopLength(0.0), pending(PENDING_EVENTS), eventCount(0), droppedEvents(0),
+	cursor(0), passStart(0.0), message(3), output(NULL), outputMutex(NULL), stopping(false) {
+	loop.reserve(MAX_EVENTS);
+}
+
+MidiLooper::~MidiLooper() {
+	join();
+}
+
+double MidiLooper::loopTime(double wallTime) const {
+	double time = wallTime - origin.load(std::memory_order_relaxed);
+	double length = loopLength.load(std::memory_order_relaxed);
+	if (time < 0.0) {
+		return 0.0;
+	}
+	return length > 0.0 ? std::fmod(time, length) : time;
+}
+
+void MidiLooper::record(RtMidiOut *output, std::mutex *outputMutex) {
+	join();
+	this->output = output;
+	this->outputMutex = outputMutex;
+	loop.clear();
+	pending.clear();
+	pending.resetDrops();
+	eventCount.store(0);
+	droppedEvents.store(0);
+	loopLength.store(0.0);
+	origin.store(steadyNow());
+	mode.store(RECORDING, std::memory_order_release);
+	start();
+}
+
+bool MidiLooper::play(RtMidiOut *output, std::mutex *outputMutex) {
+	int current = mode.load();
+	if (current == RECORDING) {
+		double length = steadyNow() - origin.load();
+		if (length <= 0.0) {
+			return false;
+		}
+		//the timing thread picks the length up and starts the second pass now
+		loopLength.store(length);
+		mode.store(PLAYING, std::memory_order_release);
+		return true;
+	}
+	if (current != IDLE) {
+		return true;
+	}
+	if (loopLength.load() <= 0.0 || output == NULL) {
+		return false;
+	}
+	this->output = output;
+	this->outputMutex = outputMutex;
+	origin.store(steadyNow());
+	mode.store(PLAYING, std::memory_order_release);
+	start();
+	return true;
+}
+
+void MidiLooper::overdub(bool enabled) {
+	int expected = enabled ? PLAYING : OVERDUBBING;
+	mode.compare_exchange_strong(expected, enabled ? OVERDUBBING : PLAYING);
+}
+
+void MidiLooper::stop() {
+	join();
+}
+
+void MidiLooper::clear() {
+	join();
+	loop.clear();
+	pending.clear();
+	eventCount.store(0);
+	loopLength.store(0.0);
+}
+
+void MidiLooper::start() {
+	stopping = false;
+	cursor = 0;
+	passStart = origin.load();
+	for (int channel = 0; channel < 16; channel++) {
+		held[channel][0] = held[channel][1] = 0;
+	}
+	timer = std::thread(&MidiLooper::run, this);
+}
+
+//stops the timing thread, what it still had to merge is merged, the held notes are released
+void MidiLooper::join() {
+	mode.store(IDLE);
+	if (!timer.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(timerMutex);
+		stopping = true;
+	}
+	timerWakeup.notify_all();
+	timer.join();
+	merge(-1.0);
+	releaseHeld();
+}
+
+//moves the pending input events into the loop, keeping it sorted
+//position: of the playback in the current pass, negative when not playing
+void MidiLooper::merge(double position) {
+	Event event;
+	double length = loopLength.load();
+	while (pending.pop(event)) {
+		if (loop.size() >= MAX_EVENTS || (length > 0.0 && event.time >= length)) {
+			droppedEvents.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		std::vector<Event>::iterator at = std::upper_bound(loop.begin(), loop.end(), event.time,
+			[](double time, const Event &e) { return time < e.time; });
+		//recorded in the past of the pass: it was heard live, it plays from the next pass
+		if (position >= 0.0 && event.time <= position && (size_t)(at - loop.begin()) <= cursor) {
+			cursor++;
+		}
+		loop.insert(at, event);
+	}
+	eventCount.store((unsigned int)loop.size(), std::memory_order_relaxed);
+}
+
+void MidiLooper::send(const Event &event) {
+	unsigned char channel = event.data[0] & 0x0F;
+	unsigned char type = event.data[0] & 0xF0;
+	unsigned char note = event.data[1] & 0x7F;
+	unsigned long long bit = 1ULL << (note & 63);
+	if (type == 0x90 && event.data[2] > 0) {
+		held[channel][note >> 6] |= bit;
+	}
+	else if (type == 0x80 || type == 0x90) {
+		//a note off recorded for a note the loop did not start (or already released at the wrap)
+		if (!(held[channel][note >> 6] & bit)) {
+			return;
+		}
+		held[channel][note >> 6] &= ~bit;
+	}
+	message.assign(event.data, event.data + event.size);
+	send(message);
+}
+
+//sends the message to the output, holding the output mutex if shared
+void MidiLooper::send(std::vector<unsigned char> &message) {
+	std::unique_lock<std::mutex> lock;
+	if (outputMutex != NULL) {
+		lock = std::unique_lock<std::mutex>(*outputMutex);
+	}
+	try {
+		output->sendMessage(&message);
+	}
+	catch (...) {
+	}
+}
+
+//note offs for the notes the loop left held
+void MidiLooper::releaseHeld() {
+	if (output == NULL) {
+		return;
+	}
+	message.resize(3);
+	for (unsigned char channel = 0; channel < 16; channel++) {
+		for (unsigned char note = 0; note < 128; note++) {
+			if (held[channel][note >> 6] & (1ULL << (note & 63))) {
+				message[0] = 0x80 | channel;
+				message[1] = note;
+				message[2] = 0;
+				send(message);
+			}
+		}
+		held[channel][0] = held[channel][1] = 0;
+	}
+}
+
+void MidiLooper::run() {
+	bool started = loopLength.load() > 0.0; //false while the first pass is recorded
+	for (;;) {
+		double now = steadyNow();
+		double length = loopLength.load();
+		if (length > 0.0 && !started) {
+			//the first pass just ended: all of it is in the future of the loop, which plays from its start
+			merge(-1.0);
+			started = true;
+			passStart = origin.load() + length;
+			cursor = 0;
+		}
+		if (started && now >= passStart + length) {
+			//wrap: nothing may stay held across the loop boundary
+			releaseHeld();
+			passStart += length * std::floor((now - passStart) / length);
+			cursor = 0;
+		}
+		merge(started ? now - passStart : -1.0);
+
+		double wait = now + LOOPER_MERGE_PERIOD;
+		if (started) {
+			while (cursor < loop.size() && passStart + loop[cursor].time <= now) {
+				send(loop[cursor++]);
+			}
+			double due = cursor < loop.size() ? passStart + loop[cursor].time : passStart + length;
+			wait = std::min(wait, due);
+		}
+		std::unique_lock<std::mutex> lock(timerMutex);
+		if (stopping) {
+			break;
+		}
+		std::chrono::steady_clock::time_point until = std::chrono::steady_clock::time_point(
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(wait)));
+		timerWakeup.wait_until(lock, until, [this] { return stopping; });
+		if (stopping) {
+			break;
+		}
+	}
+}
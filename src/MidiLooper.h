@@ -0,0 +1,177 @@
+/**********************************************************************/
+/*! \class MidiLooper
+    \brief Live looper of the input channel messages, with overdub.
+
+    The first pass records a phrase and sets the loop length when
+    playback starts.  The loop is then played through an RtMidiOut by a
+    timing thread, and overdubs add to it while it plays.  The input
+    thread only stamps each message with its time in the loop and
+    pushes it into a MidiRingBuffer: no lock, no allocation.  The
+    timing thread merges what was pushed into the loop buffer (sorted by
+    loop time, allocated once) between two events, and sends note offs
+    for the notes it left held when the loop wraps or stops.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDILOOPER_H
+#define MIDILOOPER_H
+
+#include "MidiRingBuffer.h"
+#include "RtMidi.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class MidiLooper {
+public:
+	enum Mode {
+		IDLE = 0, //nothing recorded, or stopped
+		RECORDING, //first pass, the length is not known yet
+		PLAYING,
+		OVERDUBBING //playing and recording on top
+	};
+
+	//events the loop holds at most, and the input messages waiting to be merged
+	static const unsigned int MAX_EVENTS = 16384;
+	static const unsigned int PENDING_EVENTS = 4096;
+
+	MidiLooper();
+	~MidiLooper();
+
+	/**
+	* drops the current loop and starts recording a new one, now
+	* the loop will play to the given output; anything else sending to it meanwhile must hold outputMutex,
+	* that the looper holds for each of its sends (no other sender if NULL)
+	*/
+	void record(RtMidiOut *output, std::mutex *outputMutex = NULL);
+
+	/**
+	* ends the first pass (its length becomes the loop length) and plays the loop from there,
+	* or plays the stopped loop again from its start to the given output
+	* returns false if there is nothing to play
+	*/
+	bool play(RtMidiOut *output, std::mutex *outputMutex = NULL);
+
+	//records on top of the playing loop while enabled
+	void overdub(bool enabled);
+
+	//stops the playback (note offs for the notes held by the loop), keeps the loop
+	void stop();
+
+	//stops and drops the loop
+	void clear();
+
+	/**
+	* input thread: adds the given channel message to the loop when recording or overdubbing
+	* wallTime: steady clock (seconds) when it was received
+	*/
+	void input(const unsigned char *message, size_t size, double wallTime) {
+		int current = mode.load(std::memory_order_acquire);
+		if ((current != RECORDING && current != OVERDUBBING) || size < 2 || size > 3 || message[0] < 0x80 || message[0] >= 0xF0) {
+			return;
+		}
+		Event event;
+		event.time = loopTime(wallTime);
+		event.size = (unsigned char)size;
+		event.data[0] = message[0];
+		event.data[1] = message[1];
+		event.data[2] = size > 2 ? message[2] : 0;
+		pending.push(event);
+	}
+
+	Mode state() const {
+		return (Mode)mode.load();
+	}
+
+	//seconds, 0 while the first pass is recorded
+	double length() const {
+		return loopLength.load();
+	}
+
+	//seconds from the start of the current pass
+	double position(double wallTime) const {
+		return loopTime(wallTime);
+	}
+
+	//events in the loop, and events lost because the loop or the pending queue was full
+	unsigned int events() const {
+		return eventCount.load(std::memory_order_relaxed);
+	}
+	unsigned long long dropped() const {
+		return pending.drops() + droppedEvents.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Event {
+		double time; //seconds from the start of the loop
+		unsigned char size;
+		unsigned char data[3];
+	};
+
+	std::atomic<int> mode;
+	std::atomic<double> origin; //steady clock time of the start of the first pass
+	std::atomic<double> loopLength; //0 until known
+	MidiRingBuffer<Event> pending; //from the input thread to the timing thread
+	std::atomic<unsigned int> eventCount;
+	std::atomic<unsigned long long> droppedEvents;
+
+	//owned by the timing thread while it runs
+	std::vector<Event> loop; //sorted by time, MAX_EVENTS reserved
+	size_t cursor; //next event to play
+	double passStart; //steady clock time of the start of the current pass
+	unsigned long long held[16][2]; //notes sent on and not off yet, per channel
+	std::vector<unsigned char> message; //being sent
+	RtMidiOut *output;
+	std::mutex *outputMutex; //held around each send, if any
+
+	std::thread timer;
+	std::mutex timerMutex;
+	std::condition_variable timerWakeup;
+	bool stopping;
+
+	double loopTime(double wallTime) const;
+	void start();
+	void join();
+	void merge(double position);
+	void send(const Event &event);
+	void send(std::vector<unsigned char> &message);
+	void releaseHeld();
+	void run();
+
+	MidiLooper(const MidiLooper &);
+	MidiLooper &operator=(const MidiLooper &);
+};
+
+#endif //MIDILOOPER_H
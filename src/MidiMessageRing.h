@@ -0,0 +1,131 @@
+/**********************************************************************/
+/*! \class MidiMessageRing
+    \brief A lock-free single producer / single consumer ring of variable size messages.
+
+    Each message is stored as a small header (time, generation, size)
+    followed by its bytes, wrapping around the end of the ring.  The
+    producer (an input thread) never allocates, locks nor blocks: a
+    message that does not fit is refused.  The consumer drains what was
+    queued so far from a background thread.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDIMESSAGERING_H
+#define MIDIMESSAGERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+class MidiMessageRing {
+public:
+	explicit MidiMessageRing(unsigned int size) : ring(size), head(0), tail(0) {
+	}
+
+	/**
+	* producer side: queues a complete message received at time (seconds)
+	* generation: tag given back to the consumer, to skip what a late producer queued for an older session
+	* returns false if the ring is full
+	*/
+	bool push(const unsigned char *message, size_t size, double time, unsigned int generation) {
+		Header header;
+		header.time = time;
+		header.generation = generation;
+		header.size = (unsigned int)size;
+		size_t total = sizeof(Header) + size;
+		unsigned long long h = head.load(std::memory_order_relaxed);
+		if (h + total - tail.load(std::memory_order_acquire) > ring.size()) {
+			return false;
+		}
+		//copy in (up to) two parts around the end of the ring
+		write(h, &header, sizeof(Header));
+		write(h + sizeof(Header), message, size);
+		head.store(h + total, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	* consumer side: calls handler(message, size, time, generation) for every message queued so far
+	* the message is only valid during the call
+	*/
+	template <typename Handler>
+	void drain(Handler handler) {
+		unsigned char message[1024];
+		std::vector<unsigned char> large;
+		unsigned long long t = tail.load(std::memory_order_relaxed);
+		unsigned long long h = head.load(std::memory_order_acquire);
+		while (t < h) {
+			Header header;
+			read(t, &header, sizeof(Header));
+			unsigned char *data = message;
+			if (header.size > sizeof(message)) {
+				large.resize(header.size);
+				data = &large[0];
+			}
+			read(t + sizeof(Header), data, header.size);
+			t += sizeof(Header) + header.size;
+			handler(data, (size_t)header.size, header.time, header.generation);
+		}
+		tail.store(t, std::memory_order_release);
+	}
+
+private:
+	struct Header {
+		double time;
+		unsigned int generation;
+		unsigned int size;
+	};
+
+	std::vector<unsigned char> ring;
+	std::atomic<unsigned long long> head; //bytes written so far, only written by the producer
+	std::atomic<unsigned long long> tail; //bytes read so far, only written by the consumer
+
+	void write(unsigned long long position, const void *source, size_t size) {
+		size_t offset = (size_t)(position % ring.size());
+		size_t first = size < ring.size() - offset ? size : ring.size() - offset;
+		memcpy(&ring[offset], source, first);
+		memcpy(&ring[0], (const unsigned char *)source + first, size - first);
+	}
+
+	void read(unsigned long long position, void *dest, size_t size) {
+		size_t offset = (size_t)(position % ring.size());
+		size_t first = size < ring.size() - offset ? size : ring.size() - offset;
+		memcpy(dest, &ring[offset], first);
+		memcpy((unsigned char *)dest + first, &ring[0], size - first);
+	}
+
+	MidiMessageRing(const MidiMessageRing &);
+	MidiMessageRing &operator=(const MidiMessageRing &);
+};
+
+#endif //MIDIMESSAGERING_H
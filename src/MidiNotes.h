@@ -0,0 +1,201 @@
+/**********************************************************************/
+/*! \class MidiNoteTracker
+    \brief Pairs note ons and note offs into completed notes with their duration.
+
+    The input thread keeps an open note table per (channel, note).  A
+    note off (or a note on of velocity 0) closes the matching open note
+    and pushes a completed note (start, duration, velocity, release
+    velocity) into a MidiRingBuffer that the caller drains in bulk.  A
+    note on for a note already open closes it first, with a release
+    velocity of 0.  The open notes are published through a sequence
+    lock, so any thread can take a consistent snapshot of them without
+    ever making the input thread wait.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDINOTES_H
+#define MIDINOTES_H
+
+#include "MidiRingBuffer.h"
+#include "MidiSeqlock.h"
+#include <atomic>
+#include <cstddef>
+
+class MidiNoteTracker {
+public:
+	struct CompletedNote {
+		unsigned char channel; //0 to 15
+		unsigned char note;
+		unsigned char velocity;
+		unsigned char releaseVelocity;
+		double start; //input time, seconds
+		double duration;
+	};
+
+	struct OpenNote {
+		unsigned char channel;
+		unsigned char note;
+		unsigned char velocity;
+		double start;
+	};
+
+	//completed notes waiting to be drained
+	static const unsigned int QUEUE_SIZE = 4096;
+
+	MidiNoteTracker() : completed(QUEUE_SIZE), lastTime(0.0) {
+		clear();
+	}
+
+	/**
+	* input thread only: processes any complete message, time is its input time (seconds)
+	*/
+	void process(const unsigned char *message, size_t size, double time) {
+		if (resetRequest.take()) {
+			seqlock.beginWrite();
+			clear();
+			seqlock.endWrite();
+		}
+		unsigned char type = message[0] & 0xF0;
+		if (size < 3 || (type != 0x80 && type != 0x90)) {
+			return;
+		}
+		unsigned char channel = message[0] & 0x0F;
+		unsigned char note = message[1] & 0x7F;
+		bool on = type == 0x90 && message[2] > 0;
+		unsigned long long bit = 1ULL << (note & 63);
+		bool isOpen = (open[channel][note >> 6].load(std::memory_order_relaxed) & bit) != 0;
+		if (!on && !isOpen) {
+			return;
+		}
+
+		seqlock.beginWrite();
+		lastTime.store(time, std::memory_order_relaxed);
+		if (isOpen) {
+			//a note on over an open note closes it, without release velocity
+			CompletedNote done;
+			done.channel = channel;
+			done.note = note;
+			done.velocity = velocity[channel][note].load(std::memory_order_relaxed);
+			done.releaseVelocity = on ? 0 : (type == 0x80 ? message[2] : 0);
+			done.start = start[channel][note].load(std::memory_order_relaxed);
+			done.duration = time > done.start ? time - done.start : 0.0;
+			completed.push(done);
+		}
+		unsigned long long word = open[channel][note >> 6].load(std::memory_order_relaxed);
+		if (on) {
+			start[channel][note].store(time, std::memory_order_relaxed);
+			velocity[channel][note].store(message[2], std::memory_order_relaxed);
+			open[channel][note >> 6].store(word | bit, std::memory_order_relaxed);
+		}
+		else {
+			open[channel][note >> 6].store(word & ~bit, std::memory_order_relaxed);
+		}
+		seqlock.endWrite();
+	}
+
+	//forgets the open notes, applied by the input thread on its next message
+	void reset() {
+		resetRequest.request();
+		completed.clear();
+	}
+
+	/**
+	* consumer thread: pops up to max completed notes, oldest first
+	* returns how many were copied
+	*/
+	unsigned int drain(CompletedNote *notes, unsigned int max) {
+		unsigned int count = 0;
+		while (count < max && completed.pop(notes[count])) {
+			count++;
+		}
+		return count;
+	}
+
+	//completed notes refused because the queue was full
+	unsigned long long dropped() const {
+		return completed.drops();
+	}
+
+	/**
+	* any thread: copies up to max of the notes open at a single point in time, and the input time of that point
+	* returns the number of open notes, that can be more than max
+	*/
+	unsigned int snapshot(OpenNote *notes, unsigned int max, double &time) const {
+		unsigned int count = 0;
+		seqlock.read([&]() {
+			count = 0;
+			for (unsigned char channel = 0; channel < 16; channel++) {
+				for (int w = 0; w < 2; w++) {
+					unsigned long long word = open[channel][w].load(std::memory_order_relaxed);
+					for (unsigned char n = 0; word != 0; n++, word >>= 1) {
+						if (!(word & 1)) {
+							continue;
+						}
+						if (count < max) {
+							unsigned char note = (unsigned char)(w * 64 + n);
+							notes[count].channel = channel;
+							notes[count].note = note;
+							notes[count].velocity = velocity[channel][note].load(std::memory_order_relaxed);
+							notes[count].start = start[channel][note].load(std::memory_order_relaxed);
+						}
+						count++;
+					}
+				}
+			}
+			time = lastTime.load(std::memory_order_relaxed);
+		});
+		return count;
+	}
+
+private:
+	MidiRingBuffer<CompletedNote> completed;
+
+	//open note table, written by the input thread under the seqlock
+	MidiSeqlock seqlock;
+	std::atomic<unsigned long long> open[16][2]; //bit per open note
+	std::atomic<double> start[16][128];
+	std::atomic<unsigned char> velocity[16][128];
+	std::atomic<double> lastTime; //of the last note change
+	MidiResetRequest resetRequest;
+
+	void clear() {
+		for (int channel = 0; channel < 16; channel++) {
+			open[channel][0].store(0, std::memory_order_relaxed);
+			open[channel][1].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	MidiNoteTracker(const MidiNoteTracker &);
+	MidiNoteTracker &operator=(const MidiNoteTracker &);
+};
+
+#endif //MIDINOTES_H
@@ -0,0 +1,845 @@
+/**********************************************************************/
+/*! \class MidiPlayer
+    \brief Memory-mapped Standard MIDI File player.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#include "MidiPlayer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/// MidiMappedFile
+
+MidiMappedFile::MidiMappedFile() : bytes(NULL), length(0),
+#if defined(_WIN32)
+	file(INVALID_HANDLE_VALUE), mapping(NULL)
+#else
+	fd(-1)
+#endif
+{
+}
+
+MidiMappedFile::~MidiMappedFile() {
+	close();
+}
+
+bool MidiMappedFile::open(const std::string &path) {
+	close();
+#if defined(_WIN32)
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		close();
+		return false;
+	}
+	bytes = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	length = (size_t)fileSize.QuadPart;
+#else
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+	void *view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	bytes = view == MAP_FAILED ? NULL : (const unsigned char *)view;
+	length = (size_t)info.st_size;
+#endif
+	if (bytes == NULL) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MidiMappedFile::close() {
+#if defined(_WIN32)
+	if (bytes != NULL) {
+		UnmapViewOfFile(bytes);
+	}
+	if (mapping != NULL) {
+		CloseHandle(mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+	}
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (bytes != NULL) {
+		munmap((void *)bytes, length);
+	}
+	if (fd >= 0) {
+		::close(fd);
+	}
+	fd = -1;
+#endif
+	bytes = NULL;
+	length = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+/// MidiPlayer
+
+static unsigned int readBigEndian(const unsigned char *p, int n) {
+	unsigned int value = 0;
+	for (int i = 0; i < n; i++) {
+		value = (value << 8) | p[i];
+	}
+	return value;
+}
+
+//reads a variable length quantity, false if it runs past the end
+static bool readVariableLength(const unsigned char *&p, const unsigned char *end, unsigned int &value) {
+	value = 0;
+	for (int i = 0; i < 4; i++) {
+		if (p >= end) {
+			return false;
+		}
+		unsigned char b = *p++;
+		value = (value << 7) | (b & 0x7F);
+		if (!(b & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//size and modification time of the given file, false if it cannot be read
+static bool fileStamp(const std::string &path, unsigned long long &size, long long &time) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) {
+		return false;
+	}
+	size = (unsigned long long)info.st_size;
+	time = (long long)info.st_mtime;
+	return true;
+}
+
+MidiPlayer::MidiPlayer() : division(0), flat(NULL), lastTick(0), time(0.0), secondsPerTick(0.0), smpte(false), flatEvent(NULL),
+	pending(false), startTime(0.0), output(NULL), outputMutex(NULL), checkpointsDone(false), stopping(false), playing(false), positionSeconds(0.0) {
+}
+
+MidiPlayer::~MidiPlayer() {
+	close();
+}
+
+bool MidiPlayer::open(const std::string &path) {
+	close();
+	if (!file.open(path)) {
+		return false;
+	}
+	if (openFlat()) {
+		return true;
+	}
+	const unsigned char *p = file.data();
+	const unsigned char *end = p + file.size();
+	if (file.size() < 14 || readBigEndian(p, 4) != 0x4D546864 || readBigEndian(p + 4, 4) < 6) { //MThd
+		close();
+		return false;
+	}
+	unsigned int count = readBigEndian(p + 10, 2);
+	division = readBigEndian(p + 12, 2);
+	p += 8 + readBigEndian(p + 4, 4);
+	//only the chunk headers are read, the tracks are decoded while playing
+	while (trackStarts.size() < count && end - p >= 8) {
+		unsigned int size = readBigEndian(p + 4, 4);
+		const unsigned char *data = p + 8;
+		const unsigned char *next = (size_t)(end - data) < size ? end : data + size;
+		if (readBigEndian(p, 4) == 0x4D54726B) { //MTrk, other chunks are skipped
+			trackStarts.push_back(data);
+			trackEnds.push_back(next);
+		}
+		p = next;
+	}
+	if (trackStarts.empty() || division == 0) {
+		close();
+		return false;
+	}
+	tracks.resize(trackStarts.size());
+	heap.reserve(trackStarts.size());
+	return true;
+}
+
+//checks the header of a flat file, only the header is read
+bool MidiPlayer::openFlat() {
+	if (file.size() < sizeof(MidiFlatHeader)) {
+		return false;
+	}
+	const MidiFlatHeader *header = (const MidiFlatHeader *)file.data();
+	if (memcmp(header->magic, MIDI_FLAT_MAGIC, 4) != 0 || header->version != MIDI_FLAT_VERSION ||
+		header->eventsOffset > file.size() || header->eventsSize > file.size() - header->eventsOffset ||
+		header->indexOffset > file.size() || header->indexCount > (file.size() - header->indexOffset) / sizeof(MidiFlatBlock) ||
+		header->statesOffset > file.size() || header->statesSize > file.size() - header->statesOffset) {
+		return false;
+	}
+	flat = header;
+	return true;
+}
+
+void MidiPlayer::close() {
+	stop();
+	trackStarts.clear();
+	trackEnds.clear();
+	tracks.clear();
+	heap.clear();
+	checkpoints.clear();
+	checkpointsDone = false;
+	flat = NULL;
+	file.close();
+}
+
+bool MidiPlayer::play(RtMidiOut *output, double from, std::mutex *outputMutex) {
+	stop();
+	if (output == NULL || (trackStarts.empty() && flat == NULL)) {
+		return false;
+	}
+	this->output = output;
+	this->outputMutex = outputMutex;
+	if (from > 0.0) {
+		seek(from);
+	}
+	else {
+		from = 0.0;
+		rewind();
+	}
+	startTime = from;
+	positionSeconds.store(from);
+	stopping = false;
+	playing.store(true);
+	timer = std::thread(&MidiPlayer::run, this);
+	return true;
+}
+
+void MidiPlayer::stop() {
+	if (!timer.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(timerMutex);
+		stopping = true;
+	}
+	timerWakeup.notify_all();
+	timer.join();
+	if (!playing.load()) {
+		return;
+	}
+	//all notes off, the playback was stopped in the middle of the song
+	std::vector<unsigned char> message(3);
+	for (unsigned char channel = 0; channel < 16; channel++) {
+		message[0] = 0xB0 | channel;
+		message[1] = 123;
+		message[2] = 0;
+		send(message);
+	}
+	playing.store(false);
+}
+
+bool MidiPlayer::convert(const std::string &source, const std::string &destination) {
+	MidiPlayer player;
+	MidiFlatHeader header;
+	memset(&header, 0, sizeof(header));
+	if (!fileStamp(source, header.sourceSize, header.sourceTime) || !player.open(source) || player.flat != NULL) {
+		return false;
+	}
+	std::ofstream out(destination.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out) {
+		return false;
+	}
+	memcpy(header.magic, MIDI_FLAT_MAGIC, 4);
+	header.version = MIDI_FLAT_VERSION;
+	header.eventsOffset = sizeof(MidiFlatHeader);
+	out.write((const char *)&header, sizeof(header));
+
+	std::vector<MidiFlatBlock> index;
+	std::vector<unsigned char> states;
+	ChannelState state;
+	state.clear();
+	player.rewind();
+	while (player.next()) {
+		if (player.message.size() > 0xFFFF) {
+			continue;
+		}
+		unsigned long long time = (unsigned long long)(player.time * 1000000000.0 + 0.5);
+		if (header.eventCount % MIDI_FLAT_BLOCK_EVENTS == 0) {
+			MidiFlatBlock block = { time, header.eventsSize, states.size(), 0 };
+			state.messages(states);
+			block.stateSize = states.size() - block.state;
+			index.push_back(block);
+		}
+		state.apply(player.message);
+		unsigned short size = (unsigned short)player.message.size();
+		out.write((const char *)&time, sizeof(time));
+		out.write((const char *)&size, sizeof(size));
+		out.write((const char *)&player.message[0], size);
+		header.eventsSize += sizeof(time) + sizeof(size) + size;
+		header.eventCount++;
+		header.duration = time;
+	}
+	header.indexOffset = header.eventsOffset + header.eventsSize;
+	header.indexCount = index.size();
+	if (!index.empty()) {
+		out.write((const char *)&index[0], index.size() * sizeof(MidiFlatBlock));
+	}
+	header.statesOffset = header.indexOffset + index.size() * sizeof(MidiFlatBlock);
+	header.statesSize = states.size();
+	if (!states.empty()) {
+		out.write((const char *)&states[0], states.size());
+	}
+	out.seekp(0);
+	out.write((const char *)&header, sizeof(header));
+	out.close();
+	return !out.fail();
+}
+
+bool MidiPlayer::isCurrent(const std::string &flat, const std::string &source) {
+	MidiFlatHeader header;
+	unsigned long long size;
+	long long time;
+	std::ifstream in(flat.c_str(), std::ios::in | std::ios::binary);
+	if (!in.read((char *)&header, sizeof(header)) || !fileStamp(source, size, time)) {
+		return false;
+	}
+	return memcmp(header.magic, MIDI_FLAT_MAGIC, 4) == 0 && header.version == MIDI_FLAT_VERSION &&
+		header.sourceSize == size && header.sourceTime == time;
+}
+
+//heap order: earliest tick first, then the lowest track (as a type 1 file expects)
+bool MidiPlayer::later(unsigned int a, unsigned int b) const {
+	if (tracks[a].tick != tracks[b].tick) {
+		return tracks[a].tick > tracks[b].tick;
+	}
+	return a > b;
+}
+
+//decodes the next event of the track, false at its end (end of track event, end of chunk or corrupted data)
+bool MidiPlayer::decode(Track &track) {
+	unsigned int delta;
+	if (!readVariableLength(track.data, track.end, delta) || track.data >= track.end) {
+		return false;
+	}
+	track.tick += delta;
+	unsigned char status = *track.data;
+	if (status == 0xFF) {
+		unsigned int size;
+		track.data++;
+		if (track.data >= track.end) {
+			return false;
+		}
+		track.metaType = *track.data++;
+		if (!readVariableLength(track.data, track.end, size) || (size_t)(track.end - track.data) < size || track.metaType == 0x2F) {
+			return false;
+		}
+		track.message[0] = 0xFF;
+		track.size = 1;
+		track.payload = track.data;
+		track.payloadSize = size;
+		track.data += size;
+		return true;
+	}
+	if (status == 0xF0 || status == 0xF7) {
+		unsigned int size;
+		track.data++;
+		if (!readVariableLength(track.data, track.end, size) || (size_t)(track.end - track.data) < size) {
+			return false;
+		}
+		track.message[0] = status;
+		track.size = 1;
+		track.payload = track.data;
+		track.payloadSize = size;
+		track.data += size;
+		track.runningStatus = 0;
+		return true;
+	}
+	if (status & 0x80) {
+		track.runningStatus = status;
+		track.data++;
+	}
+	else if (track.runningStatus == 0) {
+		return false;
+	}
+	status = track.runningStatus;
+	unsigned int dataBytes = ((status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0) ? 1 : 2;
+	if ((size_t)(track.end - track.data) < dataBytes) {
+		return false;
+	}
+	track.message[0] = status;
+	track.message[1] = track.data[0];
+	track.message[2] = dataBytes > 1 ? track.data[1] : 0;
+	track.size = 1 + dataBytes;
+	track.data += dataBytes;
+	return true;
+}
+
+//goes back to the start of the song
+void MidiPlayer::rewind() {
+	time = 0.0;
+	pending = false;
+	if (flat != NULL) {
+		flatEvent = file.data() + flat->eventsOffset;
+		return;
+	}
+	//seconds per tick: from the tempo (500000 microseconds per quarter note by default) or fixed with SMPTE divisions
+	smpte = (division & 0x8000) != 0;
+	if (smpte) {
+		int fps = -(signed char)(division >> 8);
+		secondsPerTick = 1.0 / ((fps == 29 ? 29.97 : fps) * (division & 0xFF));
+	}
+	else {
+		secondsPerTick = 0.5 / division;
+	}
+	lastTick = 0;
+	heap.clear();
+	for (unsigned int i = 0; i < tracks.size(); i++) {
+		Track &track = tracks[i];
+		track.data = trackStarts[i];
+		track.end = trackEnds[i];
+		track.tick = 0;
+		track.runningStatus = 0;
+		if (decode(track)) {
+			heap.push_back(i);
+			std::push_heap(heap.begin(), heap.end(), [this](unsigned int a, unsigned int b) { return later(a, b); });
+		}
+	}
+}
+
+//moves to the next event to send: fills message and time, false at the end of the song
+bool MidiPlayer::next() {
+	if (pending) {
+		pending = false;
+		return true;
+	}
+	if (flat != NULL) {
+		//flat files: nothing to decode
+		const unsigned char *end = file.data() + flat->eventsOffset + flat->eventsSize;
+		unsigned long long eventTime;
+		unsigned short size;
+		if (end - flatEvent < (ptrdiff_t)(sizeof(eventTime) + sizeof(size))) {
+			return false;
+		}
+		memcpy(&eventTime, flatEvent, sizeof(eventTime));
+		memcpy(&size, flatEvent + sizeof(eventTime), sizeof(size));
+		flatEvent += sizeof(eventTime) + sizeof(size);
+		if (end - flatEvent < size) {
+			return false;
+		}
+		message.assign(flatEvent, flatEvent + size);
+		flatEvent += size;
+		time = eventTime / 1000000000.0;
+		return true;
+	}
+
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), [this](unsigned int a, unsigned int b) { return later(a, b); });
+		Track &track = tracks[heap.back()];
+		time += (track.tick - lastTick) * secondsPerTick;
+		lastTick = track.tick;
+
+		bool send = true;
+		if (track.message[0] == 0xFF) {
+			if (track.metaType == 0x51 && track.payloadSize == 3 && !smpte) {
+				secondsPerTick = readBigEndian(track.payload, 3) / (1000000.0 * division);
+			}
+			send = false;
+		}
+		else if (track.message[0] == 0xF0 || track.message[0] == 0xF7) {
+			//F0 <length> <data>: the F0 was not counted, an F7 escape sends the data as it is
+			message.clear();
+			if (track.message[0] == 0xF0) {
+				message.push_back(0xF0);
+			}
+			message.insert(message.end(), track.payload, track.payload + track.payloadSize);
+			send = !message.empty();
+		}
+		else {
+			message.assign(track.message, track.message + track.size);
+		}
+
+		if (decode(track)) {
+			std::push_heap(heap.begin(), heap.end(), [this](unsigned int a, unsigned int b) { return later(a, b); });
+		}
+		else {
+			heap.pop_back();
+		}
+		if (send) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void MidiPlayer::ChannelState::clear() {
+	memset(program, 0xFF, sizeof(program));
+	memset(controllers, 0xFF, sizeof(controllers));
+	memset(pitchBend, 0xFF, sizeof(pitchBend));
+	memset(pressure, 0xFF, sizeof(pressure));
+	memset(parameterCount, 0, sizeof(parameterCount));
+	nonRegistered = 0;
+	resets = 0;
+}
+
+void MidiPlayer::ChannelState::apply(const std::vector<unsigned char> &message) {
+	if (message.size() < 2) {
+		return;
+	}
+	unsigned char channel = message[0] & 0x0F;
+	switch (message[0] & 0xF0) {
+	case 0xB0:
+		if (message.size() < 3) {
+			break;
+		}
+		if (message[1] == 121) {
+			//reset all controllers: what it resets does not need to be sent again, the reset will be
+			static const unsigned char resetControllers[] = { 1, 11, 64, 65, 66, 67, 98, 99, 100, 101 };
+			for (unsigned int i = 0; i < sizeof(resetControllers); i++) {
+				controllers[channel][resetControllers[i]] = 0xFF;
+			}
+			pitchBend[channel] = 0xFFFF;
+			pressure[channel] = 0xFF;
+			nonRegistered &= ~(1 << channel);
+			resets |= 1 << channel;
+		}
+		else if (message[1] == 6 || message[1] == 38) {
+			dataEntry(channel, message[1], message[2]);
+		}
+		else if (message[1] < 120) {
+			controllers[channel][message[1]] = message[2];
+			if (message[1] == 98 || message[1] == 99) {
+				nonRegistered |= 1 << channel;
+			}
+			else if (message[1] == 100 || message[1] == 101) {
+				nonRegistered &= ~(1 << channel);
+			}
+		}
+		break;
+	case 0xC0:
+		program[channel] = message[1];
+		break;
+	case 0xD0:
+		pressure[channel] = message[1];
+		break;
+	case 0xE0:
+		if (message.size() >= 3) {
+			pitchBend[channel] = message[1] | (message[2] << 7);
+		}
+		break;
+	}
+}
+
+//keeps the data entry value of the parameter the channel has selected, nothing if it is the null one
+void MidiPlayer::ChannelState::dataEntry(unsigned char channel, unsigned char controller, unsigned char value) {
+	bool registered = !(nonRegistered & (1 << channel));
+	unsigned char msb = controllers[channel][registered ? 101 : 99];
+	unsigned char lsb = controllers[channel][registered ? 100 : 98];
+	if (msb == 0xFF && lsb == 0xFF) {
+		return;
+	}
+	unsigned short number = ((msb & 0x7F) << 7) | (lsb & 0x7F);
+	if (registered && number == 0x3FFF) {
+		return;
+	}
+	if (!registered) {
+		number |= 0x4000;
+	}
+	unsigned int count = parameterCount[channel];
+	Parameter *list = parameters[channel];
+	unsigned int i = 0;
+	while (i < count && list[i].number != number) {
+		i++;
+	}
+	if (i == count) {
+		if (count == MAX_PARAMETERS) {
+			memmove(list, list + 1, (MAX_PARAMETERS - 1) * sizeof(Parameter));
+			i = count - 1;
+		}
+		else {
+			parameterCount[channel]++;
+		}
+		list[i].number = number;
+		list[i].msb = 0;
+		list[i].lsb = 0xFF;
+	}
+	if (controller == 6) {
+		list[i].msb = value;
+	}
+	else {
+		list[i].lsb = value;
+	}
+}
+
+void MidiPlayer::ChannelState::messages(std::vector<unsigned char> &bytes) const {
+	for (unsigned char channel = 0; channel < 16; channel++) {
+		unsigned char control = 0xB0 | channel;
+		if (resets & (1 << channel)) {
+			bytes.push_back(control);
+			bytes.push_back(121);
+			bytes.push_back(0);
+		}
+		for (unsigned char controller = 0; controller < 2; controller++) {
+			if (controllers[channel][controller * 32] != 0xFF) {
+				bytes.push_back(control);
+				bytes.push_back(controller * 32);
+				bytes.push_back(controllers[channel][controller * 32]);
+			}
+		}
+		for (unsigned char controller = 1; controller < 120; controller++) {
+			if (controller != 32 && controller != 6 && controller != 38 && (controller < 96 || controller > 101) &&
+				controllers[channel][controller] != 0xFF) {
+				bytes.push_back(control);
+				bytes.push_back(controller);
+				bytes.push_back(controllers[channel][controller]);
+			}
+		}
+		//each parameter selected right before its value, then the song's last selection
+		for (unsigned int i = 0; i < parameterCount[channel]; i++) {
+			const Parameter &parameter = parameters[channel][i];
+			bool registered = !(parameter.number & 0x4000);
+			bytes.push_back(control);
+			bytes.push_back(registered ? 101 : 99);
+			bytes.push_back((parameter.number >> 7) & 0x7F);
+			bytes.push_back(control);
+			bytes.push_back(registered ? 100 : 98);
+			bytes.push_back(parameter.number & 0x7F);
+			bytes.push_back(control);
+			bytes.push_back(6);
+			bytes.push_back(parameter.msb);
+			if (parameter.lsb != 0xFF) {
+				bytes.push_back(control);
+				bytes.push_back(38);
+				bytes.push_back(parameter.lsb);
+			}
+		}
+		//the kind of parameter selected last goes last, the numbers the song did not
+		//set are sent as null (127) once the parameters above changed them
+		static const unsigned char registeredLast[] = { 99, 98, 101, 100 };
+		static const unsigned char nonRegisteredLast[] = { 101, 100, 99, 98 };
+		const unsigned char *select = (nonRegistered & (1 << channel)) ? nonRegisteredLast : registeredLast;
+		for (unsigned int c = 0; c < 4; c++) {
+			unsigned char value = controllers[channel][select[c]];
+			if (value != 0xFF || parameterCount[channel] > 0) {
+				bytes.push_back(control);
+				bytes.push_back(select[c]);
+				bytes.push_back(value != 0xFF ? value : 127);
+			}
+		}
+		if (pitchBend[channel] != 0xFFFF) {
+			bytes.push_back(0xE0 | channel);
+			bytes.push_back(pitchBend[channel] & 0x7F);
+			bytes.push_back(pitchBend[channel] >> 7);
+		}
+		if (program[channel] != 0xFF) {
+			bytes.push_back(0xC0 | channel);
+			bytes.push_back(program[channel]);
+		}
+		if (pressure[channel] != 0xFF) {
+			bytes.push_back(0xD0 | channel);
+			bytes.push_back(pressure[channel]);
+		}
+	}
+}
+
+void MidiPlayer::ChannelState::load(const unsigned char *bytes, size_t size) {
+	clear();
+	std::vector<unsigned char> message;
+	const unsigned char *end = bytes + size;
+	while (bytes < end) {
+		size_t length = ((*bytes & 0xF0) == 0xC0 || (*bytes & 0xF0) == 0xD0) ? 2 : 3;
+		if ((size_t)(end - bytes) < length) {
+			break;
+		}
+		message.assign(bytes, bytes + length);
+		apply(message);
+		bytes += length;
+	}
+}
+
+//saves the playback cursor of a standard MIDI file and the given channel state as the next checkpoint
+void MidiPlayer::saveCheckpoint(const ChannelState &state) {
+	checkpoints.push_back(Checkpoint());
+	Checkpoint &checkpoint = checkpoints.back();
+	checkpoint.tracks = tracks;
+	checkpoint.heap = heap;
+	checkpoint.lastTick = lastTick;
+	checkpoint.time = time;
+	checkpoint.secondsPerTick = secondsPerTick;
+	checkpoint.state = state;
+}
+
+//moves the cursor of a flat file to the last block whose events before are all earlier than the wanted time
+//and fills the channel state before it, false if the index is corrupted
+bool MidiPlayer::seekFlat(double seconds, ChannelState &state) {
+	const unsigned char *index = file.data() + flat->indexOffset;
+	unsigned long long wanted = seconds * 1000000000.0 > 0.0 ? (unsigned long long)(seconds * 1000000000.0) : 0;
+	if (flat->indexCount == 0) {
+		return false;
+	}
+	MidiFlatBlock block;
+	//first block starting at or after the wanted time, the one before it is the block to chase from
+	unsigned long long low = 1, high = flat->indexCount;
+	while (low < high) {
+		unsigned long long middle = low + (high - low) / 2;
+		memcpy(&block, index + middle * sizeof(MidiFlatBlock), sizeof(block));
+		if (block.time < wanted) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	memcpy(&block, index + (low - 1) * sizeof(MidiFlatBlock), sizeof(block));
+	if (block.offset > flat->eventsSize || block.state > flat->statesSize || block.stateSize > flat->statesSize - block.state) {
+		return false;
+	}
+	flatEvent = file.data() + flat->eventsOffset + block.offset;
+	state.load(file.data() + flat->statesOffset + block.state, (size_t)block.stateSize);
+	return true;
+}
+
+//moves the cursor to the first event at or after the given time and sends the channel state at that time
+void MidiPlayer::seek(double seconds) {
+	ChannelState state;
+	rewind();
+	if (flat != NULL) {
+		if (!seekFlat(seconds, state)) {
+			rewind();
+			state.clear();
+		}
+		while (next()) {
+			if (time >= seconds) {
+				pending = true;
+				break;
+			}
+			state.apply(message);
+		}
+		sendState(state);
+		return;
+	}
+
+	if (checkpoints.empty()) {
+		state.clear();
+		saveCheckpoint(state);
+	}
+	//last checkpoint whose events before are all earlier than the wanted time, the first one has none
+	std::vector<Checkpoint>::const_iterator checkpoint = std::lower_bound(checkpoints.begin() + 1, checkpoints.end(), seconds,
+		[](const Checkpoint &c, double seconds) { return c.time < seconds; }) - 1;
+	tracks = checkpoint->tracks;
+	heap = checkpoint->heap;
+	lastTick = checkpoint->lastTick;
+	time = checkpoint->time;
+	secondsPerTick = checkpoint->secondsPerTick;
+	state = checkpoint->state;
+	//chasing from the furthest checkpoint walks new ground: keep checkpoints along the way
+	bool extend = !checkpointsDone && checkpoint + 1 == checkpoints.end();
+	unsigned long long events = (unsigned long long)(checkpoint - checkpoints.begin()) * MIDI_SEEK_CHECKPOINT_EVENTS;
+	for (;; events++) {
+		if (extend && events == checkpoints.size() * MIDI_SEEK_CHECKPOINT_EVENTS) {
+			saveCheckpoint(state);
+		}
+		if (!next()) {
+			checkpointsDone = checkpointsDone || extend;
+			break;
+		}
+		if (time >= seconds) {
+			pending = true;
+			break;
+		}
+		state.apply(message);
+	}
+	sendState(state);
+}
+
+//sends the state the song had set
+void MidiPlayer::sendState(const ChannelState &state) {
+	std::vector<unsigned char> bytes;
+	state.messages(bytes);
+	std::vector<unsigned char> message;
+	for (size_t i = 0; i < bytes.size(); i += message.size()) {
+		size_t length = ((bytes[i] & 0xF0) == 0xC0 || (bytes[i] & 0xF0) == 0xD0) ? 2 : 3;
+		message.assign(bytes.begin() + i, bytes.begin() + i + length);
+		send(message);
+	}
+}
+
+//sends the message to the output, holding the output mutex if shared
+void MidiPlayer::send(std::vector<unsigned char> &message) {
+	std::unique_lock<std::mutex> lock;
+	if (outputMutex != NULL) {
+		lock = std::unique_lock<std::mutex>(*outputMutex);
+	}
+	try {
+		output->sendMessage(&message);
+	}
+	catch (...) {
+	}
+}
+
+void MidiPlayer::run() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (next()) {
+		std::chrono::steady_clock::time_point due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time - startTime));
+		{
+			std::unique_lock<std::mutex> lock(timerMutex);
+			while (!stopping && std::chrono::steady_clock::now() < due) {
+				timerWakeup.wait_until(lock, due);
+			}
+			if (stopping) {
+				break;
+			}
+		}
+		send(message);
+		positionSeconds.store(time, std::memory_order_relaxed);
+	}
+	playing.store(false);
+}
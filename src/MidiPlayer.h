@@ -0,0 +1,283 @@
+/**********************************************************************/
+/*! \class MidiPlayer
+    \brief Memory-mapped Standard MIDI File player.
+
+    Opening a file maps it and only walks the chunk headers, so it takes
+    the same time whatever the size of the file.  Each track keeps a
+    cursor in the mapping and decodes its next event only when the
+    previous one was played.  The tracks are merged in time order by a
+    binary heap keyed on their next event, and a timing thread sends
+    the events through an RtMidiOut when they are due.  Tempo changes
+    are followed, SMPTE time divisions are supported.
+
+    Files can also be converted once to a flat format (see
+    MidiFlatHeader) that is played with no decoding at all: the events
+    are already merged, with absolute times in nanoseconds.
+
+    Playback can start anywhere in the song.  A seek restores the last
+    checkpoint before the wanted time: the playback cursor and the
+    program, controller, pitch bend and pressure state of the 16
+    channels at that point.  It then chases the few events left up to
+    the wanted time and sends only the state that the song had set.
+    Flat files store a checkpoint in each entry of their block index,
+    so a seek binary searches the mapped index.  Standard MIDI files
+    get a checkpoint every MIDI_SEEK_CHECKPOINT_EVENTS events, kept as
+    seeks walk the song: a seek only walks past the furthest one
+    already kept up to the wanted time.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDIPLAYER_H
+#define MIDIPLAYER_H
+
+#include "RtMidi.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//read-only memory mapping of a whole file
+class MidiMappedFile {
+public:
+	MidiMappedFile();
+	~MidiMappedFile();
+
+	bool open(const std::string &path);
+	void close();
+
+	const unsigned char *data() const {
+		return bytes;
+	}
+	size_t size() const {
+		return length;
+	}
+
+private:
+	const unsigned char *bytes;
+	size_t length;
+#if defined(_WIN32)
+	void *file; //HANDLE
+	void *mapping; //HANDLE
+#else
+	int fd;
+#endif
+
+	MidiMappedFile(const MidiMappedFile &);
+	MidiMappedFile &operator=(const MidiMappedFile &);
+};
+
+/**
+* header of the flat playback format, followed by the events, the block index and the block states
+* all the values are little endian. An event is packed as its time (8 bytes, nanoseconds from
+* the start), its size (2 bytes) and its bytes (a complete message, sysex included).
+* The block index holds a MidiFlatBlock every MIDI_FLAT_BLOCK_EVENTS events. The state of a block
+* is the channel state before its first event, as the channel messages that set it.
+*/
+#define MIDI_FLAT_MAGIC "RTMF"
+#define MIDI_FLAT_VERSION 3
+#define MIDI_FLAT_BLOCK_EVENTS 256
+
+struct MidiFlatHeader {
+	char magic[4];
+	unsigned int version;
+	unsigned long long sourceSize; //size and modification time of the standard MIDI file it comes from
+	long long sourceTime;
+	unsigned long long eventCount;
+	unsigned long long duration; //time of the last event, nanoseconds
+	unsigned long long eventsOffset; //from the start of the file
+	unsigned long long eventsSize;
+	unsigned long long indexOffset;
+	unsigned long long indexCount;
+	unsigned long long statesOffset;
+	unsigned long long statesSize;
+};
+
+struct MidiFlatBlock {
+	unsigned long long time; //of the first event of the block
+	unsigned long long offset; //of the first event of the block, from eventsOffset
+	unsigned long long state; //of the channel state before the block, from statesOffset
+	unsigned long long stateSize;
+};
+
+//events between two seek checkpoints of a standard MIDI file, the most a seek has to chase
+#define MIDI_SEEK_CHECKPOINT_EVENTS 512
+
+class MidiPlayer {
+public:
+	MidiPlayer();
+	~MidiPlayer();
+
+	/**
+	* maps the given standard MIDI file (and finds its tracks) or flat file, stops the current playback
+	* returns false if it is neither of them
+	*/
+	bool open(const std::string &path);
+	void close();
+
+	/**
+	* plays the open file through the given output, from a timing thread
+	* from: time to start at, in seconds. The channel state of the song at that time is sent first
+	* the backends are not thread safe: anything else sending to the output meanwhile must hold outputMutex,
+	* that the player holds for each of its sends (no other sender if NULL)
+	* returns false if there is no file open
+	*/
+	bool play(RtMidiOut *output, double from = 0.0, std::mutex *outputMutex = NULL);
+
+	//stops the playback, sends all notes off on the 16 channels if it was not finished
+	void stop();
+
+	bool isPlaying() const {
+		return playing.load();
+	}
+
+	//time of the last event played, in seconds from the start
+	double position() const {
+		return positionSeconds.load(std::memory_order_relaxed);
+	}
+
+	/**
+	* converts a standard MIDI file to the flat format
+	* returns false if the source cannot be read or the destination written
+	*/
+	static bool convert(const std::string &source, const std::string &destination);
+
+	/**
+	* checks cheaply that the given flat file has the current version and was converted
+	* from the given standard MIDI file as it is now (same size and modification time)
+	*/
+	static bool isCurrent(const std::string &flat, const std::string &source);
+
+private:
+	//cursor in a track chunk and its next event, decoded lazily
+	struct Track {
+		const unsigned char *data; //next byte to decode
+		const unsigned char *end;
+		unsigned long long tick; //absolute time of the decoded event
+		unsigned char runningStatus;
+		//the decoded event: a channel message (message[0..size-1]), sysex or meta (status 0xFF, type, payload)
+		unsigned char message[3];
+		unsigned int size;
+		unsigned char metaType;
+		const unsigned char *payload;
+		unsigned int payloadSize;
+	};
+
+	//registered or non registered parameter set through data entry
+	struct Parameter {
+		unsigned short number; //14 bits, bit 14 set for a non registered one
+		unsigned char msb; //data entry (6) value
+		unsigned char lsb; //data entry fine (38) value, 0xFF: not set
+	};
+
+	//parameters chased per channel, the oldest is forgotten past it
+	static const unsigned int MAX_PARAMETERS = 8;
+
+	//channel state set by the song so far, what a seek has to send
+	struct ChannelState {
+		unsigned char program[16]; //0xFF: not set
+		unsigned char controllers[16][120]; //0xFF: not set, channel mode messages (120-127) are not chased
+		//data entry (6, 38) is kept per selected parameter, increments (96, 97) are not chased
+		Parameter parameters[16][MAX_PARAMETERS];
+		unsigned char parameterCount[16];
+		unsigned short nonRegistered; //channels whose last parameter selection was non registered (98, 99)
+		unsigned short pitchBend[16]; //0xFFFF: not set
+		unsigned char pressure[16]; //0xFF: not set
+		unsigned short resets; //channels that got a reset all controllers
+
+		void clear();
+		void apply(const std::vector<unsigned char> &message);
+		void dataEntry(unsigned char channel, unsigned char controller, unsigned char value);
+		//appends the messages that set the state, bank select before program change and parameter numbers before data entry
+		void messages(std::vector<unsigned char> &bytes) const;
+		//the state set by the given messages
+		void load(const unsigned char *bytes, size_t size);
+	};
+
+	//playback cursor and channel state before an event of a standard MIDI file
+	struct Checkpoint {
+		std::vector<Track> tracks;
+		std::vector<unsigned int> heap;
+		unsigned long long lastTick;
+		double time; //of the last event before the checkpoint
+		double secondsPerTick;
+		ChannelState state;
+	};
+
+	MidiMappedFile file;
+	unsigned int division; //time division of the header
+	std::vector<const unsigned char *> trackStarts; //first byte of each track chunk
+	std::vector<const unsigned char *> trackEnds;
+	const MidiFlatHeader *flat; //NULL for standard MIDI files
+
+	//playback state, owned by the timing thread
+	std::vector<Track> tracks;
+	std::vector<unsigned int> heap; //tracks with an event left, earliest on top
+	unsigned long long lastTick;
+	double time; //of the current event, seconds
+	double secondsPerTick;
+	bool smpte;
+	const unsigned char *flatEvent; //next flat event
+	std::vector<unsigned char> message; //the current event
+	bool pending; //the current event was read ahead by a seek and is still to send
+	double startTime; //of the playback, seconds
+	RtMidiOut *output;
+	std::mutex *outputMutex; //held around each send, if any
+	std::vector<Checkpoint> checkpoints; //the first ones, up to the furthest seek so far
+	bool checkpointsDone; //up to the end of the song
+
+	std::thread timer;
+	std::mutex timerMutex;
+	std::condition_variable timerWakeup;
+	bool stopping;
+	std::atomic<bool> playing;
+	std::atomic<double> positionSeconds;
+
+	bool openFlat();
+	void send(std::vector<unsigned char> &message);
+	bool decode(Track &track);
+	bool later(unsigned int a, unsigned int b) const;
+	void rewind();
+	bool next();
+	void saveCheckpoint(const ChannelState &state);
+	bool seekFlat(double seconds, ChannelState &state);
+	void seek(double seconds);
+	void sendState(const ChannelState &state);
+	void run();
+
+	MidiPlayer(const MidiPlayer &);
+	MidiPlayer &operator=(const MidiPlayer &);
+};
+
+#endif //MIDIPLAYER_H
@@ -0,0 +1,187 @@
+/**********************************************************************/
+/*! \class MidiRecorder
+    \brief Background Standard MIDI File recorder.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#include "MidiRecorder.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+//960 ticks per quarter note at 500000 microseconds per quarter note (120 BPM)
+static const unsigned int RECORDER_DIVISION = 960;
+static const double RECORDER_TICKS_PER_SECOND = RECORDER_DIVISION * 2.0;
+
+//header chunk (format, 1 or 2 tracks, division) and the conductor track of type 1 files
+static void writeHeader(std::vector<unsigned char> &block, int format) {
+	unsigned char header[14] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, (unsigned char)format, 0, (unsigned char)(format == 1 ? 2 : 1),
+		(unsigned char)(RECORDER_DIVISION >> 8), (unsigned char)(RECORDER_DIVISION & 0xFF) };
+	block.insert(block.end(), header, header + sizeof(header));
+	if (format == 1) {
+		//tempo 500000, end of track
+		unsigned char conductor[] = { 'M', 'T', 'r', 'k', 0, 0, 0, 11, 0, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20, 0, 0xFF, 0x2F, 0x00 };
+		block.insert(block.end(), conductor, conductor + sizeof(conductor));
+	}
+}
+
+MidiRecorder::MidiRecorder() : ring(RING_SIZE), active(false), generation(0), events(0), drops(0),
+	stopping(false), format(0), firstTime(-1.0), lastTick(0), runningStatus(0), trackSize(0), trackLengthOffset(0),
+	output(BLOCK_SIZE, false) {
+}
+
+MidiRecorder::~MidiRecorder() {
+	stop();
+}
+
+bool MidiRecorder::start(const std::string &path, int format) {
+	if (active.load() || encoder.joinable() || (format != 0 && format != 1)) {
+		return false;
+	}
+	if (!output.open(path)) {
+		return false;
+	}
+	this->format = format;
+	std::vector<unsigned char> &block = output.block();
+	writeHeader(block, format);
+	unsigned char track[8] = { 'M', 'T', 'r', 'k', 0, 0, 0, 0 };
+	trackLengthOffset = block.size() + 4;
+	block.insert(block.end(), track, track + sizeof(track));
+
+	firstTime = -1.0;
+	lastTick = 0;
+	runningStatus = 0;
+	trackSize = 0;
+	events.store(0);
+	drops.store(0);
+	stopping.store(false);
+	//whatever a late producer left from the previous recording is skipped by its generation
+	generation.fetch_add(1);
+	encoder = std::thread(&MidiRecorder::encodeLoop, this);
+	active.store(true, std::memory_order_release);
+	return true;
+}
+
+bool MidiRecorder::stop() {
+	if (!encoder.joinable()) {
+		return false;
+	}
+	active.store(false);
+	stopping.store(true);
+	encoder.join();
+
+	//patch the performance track length
+	bool ok = output.finish();
+	if (ok) {
+		unsigned char length[4] = { (unsigned char)(trackSize >> 24), (unsigned char)(trackSize >> 16),
+			(unsigned char)(trackSize >> 8), (unsigned char)trackSize };
+		ok = output.patch(trackLengthOffset, length, sizeof(length));
+	}
+	return output.close() && ok;
+}
+
+void MidiRecorder::encodeLoop() {
+	while (!stopping.load()) {
+		drain();
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	drain();
+	//end of track
+	putVariableLength(0);
+	put(0xFF);
+	put(0x2F);
+	put(0x00);
+	output.handOff();
+}
+
+void MidiRecorder::drain() {
+	unsigned int current = generation.load();
+	ring.drain([this, current](const unsigned char *message, size_t size, double time, unsigned int generation) {
+		if (generation == current) {
+			encode(message, size, time);
+		}
+	});
+}
+
+void MidiRecorder::encode(const unsigned char *message, size_t size, double time) {
+	if (firstTime < 0.0) {
+		firstTime = time;
+	}
+	unsigned long long tick = (unsigned long long)std::floor((time - firstTime) * RECORDER_TICKS_PER_SECOND + 0.5);
+	if (tick < lastTick) {
+		tick = lastTick;
+	}
+	putVariableLength(tick - lastTick);
+	lastTick = tick;
+
+	unsigned char status = message[0];
+	if (status == 0xF0 || status == 0xF7) {
+		//sysex event: F0 <length> <bytes after F0>, a lone continuation goes as an F7 escape
+		put(status);
+		putVariableLength(size - 1);
+		for (size_t i = 1; i < size; i++) {
+			put(message[i]);
+		}
+		runningStatus = 0;
+	}
+	else {
+		if (status != runningStatus) {
+			put(status);
+			runningStatus = status;
+		}
+		for (size_t i = 1; i < size; i++) {
+			put(message[i]);
+		}
+	}
+	events.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MidiRecorder::put(unsigned char byte) {
+	std::vector<unsigned char> &block = output.block();
+	block.push_back(byte);
+	trackSize++;
+	if (block.size() >= BLOCK_SIZE) {
+		output.handOff();
+	}
+}
+
+void MidiRecorder::putVariableLength(unsigned long long value) {
+	unsigned char bytes[10];
+	int n = 0;
+	bytes[n++] = value & 0x7F;
+	while ((value >>= 7) > 0) {
+		bytes[n++] = 0x80 | (value & 0x7F);
+	}
+	while (n > 0) {
+		put(bytes[--n]);
+	}
+}
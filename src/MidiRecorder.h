@@ -0,0 +1,134 @@
+/**********************************************************************/
+/*! \class MidiRecorder
+    \brief Background Standard MIDI File recorder.
+
+    The input thread hands the messages to the recorder through a
+    lock-free byte ring (no allocation, no lock, no I/O).  A background
+    thread encodes them as SMF events, with running status and variable
+    length delta times, into one of two blocks, and hands the full block
+    to a writer thread while it fills the other one.  Stopping writes
+    the end of the track and patches the chunk lengths.
+
+    Type 0 files hold a single track.  Type 1 files hold a conductor
+    track (tempo) followed by the performance track.  The time base is
+    960 ticks per quarter note at 120 BPM (0.52 ms per tick), and the
+    file starts with the first message received after start().
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDIRECORDER_H
+#define MIDIRECORDER_H
+
+#include "MidiBlockWriter.h"
+#include "MidiMessageRing.h"
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+
+class MidiRecorder {
+public:
+	//size of the input ring and of each encoding block
+	static const unsigned int RING_SIZE = 256 * 1024;
+	static const unsigned int BLOCK_SIZE = 64 * 1024;
+
+	MidiRecorder();
+	~MidiRecorder();
+
+	/**
+	* creates the file and starts the background threads
+	* format: SMF type, 0 or 1
+	* returns false if already recording or the file cannot be created
+	*/
+	bool start(const std::string &path, int format);
+
+	/**
+	* encodes what is left, finishes the file and closes it
+	* returns false if not recording or the file could not be written
+	*/
+	bool stop();
+
+	bool isRecording() const {
+		return active.load(std::memory_order_relaxed);
+	}
+
+	/**
+	* input thread: queues the given complete message received at time (seconds, any origin)
+	* messages that cannot be stored in a file (system common and realtime) are ignored
+	*/
+	void record(const unsigned char *message, size_t size, double time) {
+		if (active.load(std::memory_order_acquire) && size > 0 && (message[0] < 0xF1 || message[0] == 0xF7)) {
+			if (!ring.push(message, size, time, generation.load(std::memory_order_relaxed))) {
+				drops.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//messages written to the file and messages lost because the ring was full, for the current (or last) recording
+	unsigned long long recorded() const {
+		return events.load(std::memory_order_relaxed);
+	}
+	unsigned long long dropped() const {
+		return drops.load(std::memory_order_relaxed);
+	}
+
+private:
+	//input ring, written by the input thread, read by the encoding thread
+	MidiMessageRing ring;
+
+	std::atomic<bool> active;
+	std::atomic<unsigned int> generation;
+	std::atomic<unsigned long long> events;
+	std::atomic<unsigned long long> drops;
+
+	//encoding thread state
+	std::thread encoder;
+	std::atomic<bool> stopping;
+	int format;
+	double firstTime; //time of the first message, -1 until received
+	unsigned long long lastTick;
+	unsigned char runningStatus;
+	unsigned long long trackSize; //bytes of the performance track so far
+	unsigned long long trackLengthOffset; //where its length has to be patched
+	MidiBlockWriter output;
+
+	void encodeLoop();
+	void drain();
+	void encode(const unsigned char *message, size_t size, double time);
+	void put(unsigned char byte);
+	void putVariableLength(unsigned long long value);
+
+	MidiRecorder(const MidiRecorder &);
+	MidiRecorder &operator=(const MidiRecorder &);
+};
+
+#endif //MIDIRECORDER_H
@@ -0,0 +1,133 @@
+/**********************************************************************/
+/*! \class MidiRingBuffer
+    \brief A fixed size single producer / single consumer lock-free queue.
+
+    Used by the wrapper to hand data from the MIDI backend threads to the
+    caller's thread without taking locks or allocating on the producer side.
+	One thread may push while another one pops; anything else needs
+	external synchronization.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDIRINGBUFFER_H
+#define MIDIRINGBUFFER_H
+
+#include <atomic>
+#include <vector>
+
+template <typename T>
+class MidiRingBuffer {
+public:
+	//capacity is rounded up to the next power of two
+	explicit MidiRingBuffer(unsigned int capacity = 1024) : head(0), tail(0), dropped(0) {
+		resize(capacity);
+	}
+
+	/**
+	* reallocates the ring, dropping its content
+	* NOT thread safe: only call while nobody is pushing or popping
+	*/
+	void resize(unsigned int capacity) {
+		unsigned int size = 2;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		ring.assign(size, T());
+		mask = size - 1;
+		head.store(0);
+		tail.store(0);
+	}
+
+	/**
+	* producer side: copies the item in the ring
+	* returns false (and counts a drop) if the ring is full
+	*/
+	bool push(const T &item) {
+		unsigned int h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) > mask) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		ring[h & mask] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	* consumer side: copies the oldest item in the given one and removes it from the ring
+	* returns false if the ring is empty
+	*/
+	bool pop(T &item) {
+		unsigned int t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = ring[t & mask];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	//consumer side: drops everything queued so far
+	void clear() {
+		tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+	//number of queued items, only exact from the consumer side
+	unsigned int size() const {
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+
+	unsigned int capacity() const {
+		return mask + 1;
+	}
+
+	//number of items refused by push() because the ring was full
+	unsigned long long drops() const {
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+	void resetDrops() {
+		dropped.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	std::vector<T> ring;
+	unsigned int mask;
+	std::atomic<unsigned int> head; //next slot to write, only written by the producer
+	std::atomic<unsigned int> tail; //next slot to read, only written by the consumer
+	std::atomic<unsigned long long> dropped;
+
+	MidiRingBuffer(const MidiRingBuffer &);
+	MidiRingBuffer &operator=(const MidiRingBuffer &);
+};
+
+#endif //MIDIRINGBUFFER_H
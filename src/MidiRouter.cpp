@@ -0,0 +1,258 @@
+/**********************************************************************/
+/*! \class MidiRouter
+    \brief Routing graph run by the input thread: input, transforms, outputs.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#include "MidiRouter.h"
+#include <cstring>
+#include <thread>
+
+MidiRouter::MidiRouter() : config(NULL), epoch(0), sent(0), failed(0), routing(NULL), seen(NULL) {
+}
+
+MidiRouter::~MidiRouter() {
+	clear();
+	for (size_t i = 0; i < retired.size(); i++) {
+		delete retired[i];
+	}
+}
+
+int MidiRouter::addOutput(RtMidiOut *output) {
+	std::lock_guard<std::mutex> lock(controlMutex);
+	outputs.push_back(output);
+	return (int)outputs.size() - 1;
+}
+
+bool MidiRouter::setRoutes(const RouteSettings *settings, unsigned int count) {
+	std::lock_guard<std::mutex> lock(controlMutex);
+	for (unsigned int i = 0; i < count; i++) {
+		if (settings[i].output < 0 || settings[i].output >= (int)outputs.size() || outputs[settings[i].output] == NULL ||
+			settings[i].transformCount > MAX_TRANSFORMS) {
+			return false;
+		}
+	}
+	Config *next = NULL;
+	if (count > 0) {
+		next = new Config(count);
+		for (unsigned int i = 0; i < count; i++) {
+			Route &route = next->routes[i];
+			route.output = outputs[settings[i].output];
+			route.filter.compile(settings[i].types, settings[i].channels, settings[i].noteLow, settings[i].noteHigh, settings[i].controllers);
+			route.transformCount = settings[i].transformCount;
+			for (unsigned int t = 0; t < route.transformCount; t++) {
+				route.transforms[t] = settings[i].transforms[t];
+			}
+			route.buffer.reserve(BUFFER_SIZE);
+			memset(route.held, 0, sizeof(route.held));
+			route.heldCount = 0;
+		}
+	}
+	publish(next);
+	return true;
+}
+
+void MidiRouter::clear() {
+	std::lock_guard<std::mutex> lock(controlMutex);
+	publish(NULL);
+	//the outputs are going: release the held notes here rather than on the next input message
+	std::vector<Config *> releasing;
+	for (size_t i = 0; i < retired.size(); i++) {
+		if (!retired[i]->released.exchange(true)) {
+			releasing.push_back(retired[i]);
+		}
+	}
+	//the input thread may be releasing a set it took first, let it finish before sending to the same outputs
+	waitInputThread();
+	for (size_t i = 0; i < releasing.size(); i++) {
+		release(*releasing[i]);
+	}
+	for (size_t i = 0; i < outputs.size(); i++) {
+		try {
+			outputs[i]->closePort();
+		}
+		catch (...) {
+		}
+		delete outputs[i];
+	}
+	outputs.clear();
+}
+
+//grace period: if the input thread is routing, it may hold what it loaded until it leaves
+void MidiRouter::waitInputThread() {
+	unsigned long long current = epoch.load();
+	if (current & 1) {
+		while (epoch.load() == current) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+//swaps the routes in and frees the old ones once the input thread cannot use them anymore
+void MidiRouter::publish(Config *next) {
+	Config *old = config.exchange(next);
+	if (old == NULL) {
+		return;
+	}
+	waitInputThread();
+	//the input thread releases the notes of the last set it routed with, that one has to stay
+	retired.push_back(old);
+	Config *kept = seen.load(std::memory_order_acquire);
+	size_t count = 0;
+	for (size_t i = 0; i < retired.size(); i++) {
+		if (retired[i] == kept) {
+			retired[count++] = retired[i];
+		}
+		else {
+			delete retired[i];
+		}
+	}
+	retired.resize(count);
+}
+
+void MidiRouter::routeAll(const unsigned char *message, size_t size) {
+	epoch.fetch_add(1);
+	Config *current = config.load();
+	if (current != routing) {
+		//first message with the new set: the old one releases its notes
+		if (routing != NULL && !routing->released.exchange(true)) {
+			release(*routing);
+		}
+		routing = current;
+		seen.store(current, std::memory_order_release);
+	}
+	if (current != NULL) {
+		for (unsigned int i = 0; i < current->count; i++) {
+			Route &route = current->routes[i];
+			if (!route.filter.accepts(message, size)) {
+				continue;
+			}
+			route.buffer.assign(message, message + size);
+			if (!transform(route) || !track(route)) {
+				continue;
+			}
+			send(route);
+		}
+	}
+	epoch.fetch_add(1);
+}
+
+void MidiRouter::send(Route &route) {
+	try {
+		route.output->sendMessage(&route.buffer);
+		sent.fetch_add(1, std::memory_order_relaxed);
+	}
+	catch (...) {
+		failed.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+//sends a note off for each note the routes of the set left sounding
+void MidiRouter::release(Config &set) {
+	for (unsigned int i = 0; i < set.count; i++) {
+		Route &route = set.routes[i];
+		for (unsigned int channel = 0; channel < 16 && route.heldCount > 0; channel++) {
+			for (unsigned int note = 0; note < 128; note++) {
+				if (route.held[channel][note] == 0) {
+					continue;
+				}
+				route.heldCount -= route.held[channel][note];
+				route.held[channel][note] = 0;
+				route.buffer.resize(3);
+				route.buffer[0] = (unsigned char)(0x80 | channel);
+				route.buffer[1] = (unsigned char)note;
+				route.buffer[2] = 0;
+				send(route);
+			}
+		}
+	}
+}
+
+//counts the notes the route starts, false for the note offs of notes it did not start (dropped)
+bool MidiRouter::track(Route &route) {
+	std::vector<unsigned char> &message = route.buffer;
+	unsigned char type = message[0] & 0xF0;
+	if ((type != 0x80 && type != 0x90) || message.size() < 3) {
+		return true;
+	}
+	unsigned char &held = route.held[message[0] & 0x0F][message[1] & 0x7F];
+	if (type == 0x90 && message[2] > 0) {
+		if (held < 0xFF) {
+			held++;
+			route.heldCount++;
+		}
+		return true;
+	}
+	if (held == 0) {
+		return false;
+	}
+	held--;
+	route.heldCount--;
+	return true;
+}
+
+//runs the transforms of the route on its buffer, false if the message is dropped
+bool MidiRouter::transform(Route &route) {
+	std::vector<unsigned char> &message = route.buffer;
+	if (message[0] < 0x80 || message[0] >= 0xF0) {
+		//system messages go through as they are
+		return true;
+	}
+	for (unsigned int i = 0; i < route.transformCount; i++) {
+		const Transform &t = route.transforms[i];
+		unsigned char type = message[0] & 0xF0;
+		switch (t.type) {
+		case TRANSPOSE:
+			if ((type == 0x80 || type == 0x90 || type == 0xA0) && message.size() > 1) {
+				int note = message[1] + t.amount;
+				if (note < 0 || note > 127) {
+					return false;
+				}
+				message[1] = (unsigned char)note;
+			}
+			break;
+		case CHANNEL_MAP:
+			if (t.table[message[0] & 0x0F] > 15) {
+				return false;
+			}
+			message[0] = type | t.table[message[0] & 0x0F];
+			break;
+		case VELOCITY_CURVE:
+			if (type == 0x90 && message.size() > 2 && message[2] > 0) {
+				unsigned char velocity = t.table[message[2] & 0x7F];
+				message[2] = velocity == 0 ? 1 : (velocity > 127 ? 127 : velocity);
+			}
+			break;
+		}
+	}
+	return true;
+}
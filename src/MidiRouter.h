@@ -0,0 +1,178 @@
+/**********************************************************************/
+/*! \class MidiRouter
+    \brief Routing graph run by the input thread: input, transforms, outputs.
+
+    Each route takes the input messages its filter lets through, runs
+    them through its chain of transforms (transpose, channel map,
+    velocity curve) in a buffer allocated beforehand, and sends them to
+    its own output port, all from the input callback.
+
+    The routes are an immutable set swapped in RCU style: the input
+    thread only loads a pointer and bumps an epoch counter around its
+    use, and the thread that changes the routes waits for the input
+    thread to leave the old set before freeing it.  Rerouting never
+    blocks nor allocates on the input thread.  Only one thread may call
+    route().
+
+    Each route counts the notes it started on its output.  It forwards
+    only the note offs of those notes, and the first message routed
+    with a new set first sends note offs for the notes the old set
+    left sounding, so a transform change cannot leave notes hanging.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDIROUTER_H
+#define MIDIROUTER_H
+
+#include "MidiFilter.h"
+#include "RtMidi.h"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+class MidiRouter {
+public:
+	enum TransformType {
+		TRANSPOSE = 1, //amount: semitones, notes moved out of 0-127 are dropped
+		CHANNEL_MAP = 2, //table[n]: new channel of the channel n messages, above 15 drops them
+		VELOCITY_CURVE = 3 //table[v]: new velocity of the note ons of velocity v, never 0
+	};
+
+	static const unsigned int MAX_TRANSFORMS = 8;
+	//preallocated message buffer of each route, bigger sysex make it grow once
+	static const unsigned int BUFFER_SIZE = 4096;
+
+	struct Transform {
+		int type; //TransformType
+		int amount;
+		unsigned char table[128];
+	};
+
+	//what setRoutes builds a route from
+	struct RouteSettings {
+		int output; //id given by addOutput
+		unsigned int types; //filter of the messages taken, see MidiInputFilter::compile
+		unsigned int channels;
+		unsigned char noteLow;
+		unsigned char noteHigh;
+		unsigned char controllers[16];
+		unsigned int transformCount;
+		Transform transforms[MAX_TRANSFORMS];
+	};
+
+	MidiRouter();
+	~MidiRouter();
+
+	/**
+	* takes ownership of the given (open) output port, for the routes to send to
+	* returns its id
+	*/
+	int addOutput(RtMidiOut *output);
+
+	/**
+	* replaces all the routes, count 0 removes them. Returns once the input thread no longer uses the old ones
+	* the notes the old routes left sounding are released by the input thread, with the next message it routes
+	* returns false (and changes nothing) if a route has an unknown output or too many transforms
+	*/
+	bool setRoutes(const RouteSettings *settings, unsigned int count);
+
+	//removes the routes, releases the notes they left sounding and closes all the outputs
+	void clear();
+
+	//input thread: sends the given complete message through the matching routes
+	void route(const unsigned char *message, size_t size) {
+		if (config.load(std::memory_order_relaxed) != NULL || routing != NULL) {
+			routeAll(message, size);
+		}
+	}
+
+	//messages sent by the routes, and the sends that threw
+	unsigned long long routed() const {
+		return sent.load(std::memory_order_relaxed);
+	}
+	unsigned long long errors() const {
+		return failed.load(std::memory_order_relaxed);
+	}
+	void resetCounters() {
+		sent.store(0);
+		failed.store(0);
+	}
+
+private:
+	struct Route {
+		RtMidiOut *output;
+		MidiInputFilter filter;
+		unsigned int transformCount;
+		Transform transforms[MAX_TRANSFORMS];
+		std::vector<unsigned char> buffer; //message being transformed, only used by the input thread
+		unsigned char held[16][128]; //note ons sent and not released yet, per output channel and note
+		unsigned int heldCount;
+	};
+
+	//a set of routes, never changed once published (but for the notes they hold)
+	struct Config {
+		Route *routes;
+		unsigned int count;
+		std::atomic<bool> released; //its held notes were released, by the input thread or clear()
+
+		explicit Config(unsigned int count) : routes(new Route[count]), count(count), released(false) {
+		}
+		~Config() {
+			delete[] routes;
+		}
+	};
+
+	std::atomic<Config *> config;
+	std::atomic<unsigned long long> epoch; //odd while the input thread is in routeAll
+	std::atomic<unsigned long long> sent;
+	std::atomic<unsigned long long> failed;
+	Config *routing; //the set the input thread routed with last, only used by the input thread
+	std::atomic<Config *> seen; //routing, for the threads changing the routes
+
+	std::mutex controlMutex; //serializes the threads changing the routes
+	std::vector<RtMidiOut *> outputs;
+	std::vector<Config *> retired; //replaced sets, freed once the input thread routes with a newer one
+
+	void routeAll(const unsigned char *message, size_t size);
+	static bool transform(Route &route);
+	static bool track(Route &route);
+	void release(Config &set);
+	void send(Route &route);
+	void waitInputThread();
+	void publish(Config *next);
+
+	MidiRouter(const MidiRouter &);
+	MidiRouter &operator=(const MidiRouter &);
+};
+
+#endif //MIDIROUTER_H
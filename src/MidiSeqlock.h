@@ -0,0 +1,107 @@
+/**********************************************************************/
+/*! \class MidiSeqlock
+    \brief Sequence lock and reset request of the input trackers.
+
+    The input thread publishes the state of a tracker (relaxed atomics)
+    between two increments of a sequence, odd while it writes, and any
+    thread copies it again until no write overlapped the copy: the
+    input thread never waits.  A reset asked by another thread is only
+    flagged, the input thread applies it before its next message so
+    that its private state is never touched from outside.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDISEQLOCK_H
+#define MIDISEQLOCK_H
+
+#include <atomic>
+
+class MidiSeqlock {
+public:
+	MidiSeqlock() : sequence(0) {
+	}
+
+	//writer thread: brackets the stores of the published state
+	void beginWrite() {
+		sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	void endWrite() {
+		sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	/**
+	* any thread: calls copy() (relaxed loads of the published state) until it ran without a write
+	* in progress, so what it copied was published at a single point in time
+	*/
+	template <typename Copy>
+	void read(Copy copy) const {
+		unsigned int before, after;
+		do {
+			before = sequence.load(std::memory_order_acquire);
+			copy();
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence.load(std::memory_order_relaxed);
+		} while ((before & 1) || before != after);
+	}
+
+private:
+	std::atomic<unsigned int> sequence;
+
+	MidiSeqlock(const MidiSeqlock &);
+	MidiSeqlock &operator=(const MidiSeqlock &);
+};
+
+class MidiResetRequest {
+public:
+	MidiResetRequest() : requested(false) {
+	}
+
+	//any thread: asks for a reset
+	void request() {
+		requested.store(true, std::memory_order_release);
+	}
+
+	//input thread: true once per request, the load alone when there is none
+	bool take() {
+		return requested.load(std::memory_order_relaxed) && requested.exchange(false, std::memory_order_acquire);
+	}
+
+private:
+	std::atomic<bool> requested;
+
+	MidiResetRequest(const MidiResetRequest &);
+	MidiResetRequest &operator=(const MidiResetRequest &);
+};
+
+#endif //MIDISEQLOCK_H
@@ -0,0 +1,191 @@
+/**********************************************************************/
+/*! \class MidiTrace
+    \brief Per-thread binary trace of the MIDI input path.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#include "MidiTrace.h"
+#include <chrono>
+#include <mutex>
+
+std::atomic<bool> midiTraceEnabled(false);
+
+//relaxed atomics: the dump may read an event while its thread overwrites it
+struct MidiTraceEvent {
+	std::atomic<unsigned long long> time; //steady clock, nanoseconds
+	std::atomic<unsigned int> arg;
+	std::atomic<unsigned int> point;
+};
+
+//written by its owner thread only, read by the dump
+struct MidiTraceRing {
+	MidiTraceEvent events[MIDI_TRACE_RING_SIZE];
+	std::atomic<unsigned long long> head; //events recorded since the ring was allocated
+	std::atomic<unsigned long long> start; //head at the last clear
+	std::atomic<bool> owned; //a thread is recording in it
+};
+
+//rings allocated when the tracing is enabled, never freed: a thread may
+//still be running (and tracing) while the process exits
+static std::atomic<MidiTraceRing *> traceRings[MIDI_TRACE_MAX_THREADS];
+static std::atomic<int> traceRingCount(0);
+static std::mutex traceReserveMutex;
+
+//gives the ring back when its thread exits, so the next thread reuses it
+struct MidiTraceOwner {
+	MidiTraceRing *ring;
+	MidiTraceOwner() : ring(NULL) {}
+	~MidiTraceOwner() {
+		if (ring != NULL) {
+			ring->owned.store(false, std::memory_order_release);
+		}
+	}
+};
+static thread_local MidiTraceOwner traceOwner;
+
+static const char *traceNames[MIDI_TRACE_POINTS] = {
+	"ingress", "decode", "callback", "callback", "enqueue", "dequeue"
+};
+
+static unsigned long long traceTime() {
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void midiTraceReserve() {
+	std::lock_guard<std::mutex> lock(traceReserveMutex);
+	for (int i = traceRingCount.load(); i < MIDI_TRACE_MAX_THREADS; i++) {
+		MidiTraceRing *ring = new MidiTraceRing();
+		ring->head.store(0);
+		ring->start.store(0);
+		ring->owned.store(false);
+		traceRings[i].store(ring, std::memory_order_release);
+		traceRingCount.store(i + 1, std::memory_order_release);
+	}
+}
+
+//claims a free ring for the calling thread, NULL if they are all in use
+//allocation free, the input threads record from here
+static MidiTraceRing *traceRingClaim() {
+	int count = traceRingCount.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		MidiTraceRing *ring = traceRings[i].load(std::memory_order_acquire);
+		bool expected = false;
+		if (!ring->owned.load(std::memory_order_relaxed) &&
+			ring->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+			return ring;
+		}
+	}
+	return NULL;
+}
+
+void midiTraceRecord(MidiTracePoint point, unsigned int arg) {
+	MidiTraceRing *ring = traceOwner.ring;
+	if (ring == NULL) {
+		ring = traceOwner.ring = traceRingClaim();
+		if (ring == NULL) {
+			return;
+		}
+	}
+	unsigned long long h = ring->head.load(std::memory_order_relaxed);
+	MidiTraceEvent &event = ring->events[h % MIDI_TRACE_RING_SIZE];
+	event.time.store(traceTime(), std::memory_order_relaxed);
+	event.arg.store(arg, std::memory_order_relaxed);
+	event.point.store(point, std::memory_order_relaxed);
+	ring->head.store(h + 1, std::memory_order_release);
+}
+
+void midiTraceClear() {
+	int count = traceRingCount.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		MidiTraceRing *ring = traceRings[i].load(std::memory_order_acquire);
+		if (ring != NULL) {
+			ring->start.store(ring->head.load(std::memory_order_acquire));
+		}
+	}
+}
+
+unsigned long long midiTraceDump(std::ostream &out) {
+	unsigned long long written = 0;
+	bool any = false;
+	out << "{\"traceEvents\":[";
+	int count = traceRingCount.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		MidiTraceRing *ring = traceRings[i].load(std::memory_order_acquire);
+		if (ring == NULL) {
+			continue;
+		}
+		out << (any ? ",\n" : "\n");
+		any = true;
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i + 1
+			<< ",\"args\":{\"name\":\"MIDI thread " << i + 1 << "\"}}";
+		unsigned long long head = ring->head.load(std::memory_order_acquire);
+		unsigned long long first = ring->start.load();
+		if (head - first > MIDI_TRACE_RING_SIZE) {
+			first = head - MIDI_TRACE_RING_SIZE;
+		}
+		for (unsigned long long e = first; e < head; e++) {
+			const MidiTraceEvent &slot = ring->events[e % MIDI_TRACE_RING_SIZE];
+			unsigned long long time = slot.time.load(std::memory_order_relaxed);
+			unsigned int arg = slot.arg.load(std::memory_order_relaxed);
+			unsigned int point = slot.point.load(std::memory_order_relaxed);
+			//the writer may be storing event head (at the slot of head - MIDI_TRACE_RING_SIZE)
+			//while it was copied, skip it if it has been lapped meanwhile
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (e + MIDI_TRACE_RING_SIZE <= ring->head.load(std::memory_order_relaxed)) {
+				continue;
+			}
+			if (point >= MIDI_TRACE_POINTS) {
+				continue;
+			}
+			const char *phase = "i";
+			if (point == MIDI_TRACE_CALLBACK_ENTER) {
+				phase = "B";
+			}
+			else if (point == MIDI_TRACE_CALLBACK_EXIT) {
+				phase = "E";
+			}
+			//timestamps are in microseconds, keep the nanoseconds as decimals
+			out << ",\n{\"name\":\"" << traceNames[point] << "\",\"ph\":\"" << phase << "\"";
+			if (phase[0] == 'i') {
+				out << ",\"s\":\"t\"";
+			}
+			out << ",\"pid\":1,\"tid\":" << i + 1 << ",\"ts\":" << time / 1000 << '.';
+			unsigned int ns = (unsigned int)(time % 1000);
+			out << (char)('0' + ns / 100) << (char)('0' + ns / 10 % 10) << (char)('0' + ns % 10);
+			out << ",\"args\":{\"arg\":" << arg << "}}";
+			written++;
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+	return written;
+}
@@ -0,0 +1,88 @@
+/**********************************************************************/
+/*! \class MidiTrace
+    \brief Per-thread binary trace of the MIDI input path.
+
+    Trace points are recorded at the backend ingress, once the message
+    is decoded, around the input callback and when the wrapper queues
+    and dequeues notes.  Each thread writes to its own ring, so a trace
+    point costs a relaxed load when tracing is disabled and a clock read
+    plus a 16 byte store when it is enabled.  The rings can be dumped as
+    Chrome trace JSON (chrome://tracing, Perfetto) for offline analysis.
+
+    RtMidi WWW site: http://music.mcgill.ca/~gary/rtmidi/
+
+    RtMidi: realtime MIDI i/o C++ classes
+    Copyright (c) 2003-2014 Gary P. Scavone
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation files
+    (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge,
+    publish, distribute, sublicense, and/or sell copies of the Software,
+    and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    Any person wishing to distribute modifications to the Software is
+    asked to send the modifications to the original developer so that
+    they can be incorporated into the canonical version.  This is,
+    however, not a binding provision of this license.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**********************************************************************/
+
+#ifndef MIDITRACE_H
+#define MIDITRACE_H
+
+#include <atomic>
+#include <ostream>
+
+//where the event was recorded
+enum MidiTracePoint {
+	MIDI_TRACE_INGRESS = 0, //backend read the event
+	MIDI_TRACE_DECODE, //message decoded, about to be passed to the callback or the backend queue
+	MIDI_TRACE_CALLBACK_ENTER, //input callback entered
+	MIDI_TRACE_CALLBACK_EXIT, //input callback left
+	MIDI_TRACE_ENQUEUE, //message pushed in a wrapper queue
+	MIDI_TRACE_DEQUEUE, //message popped from a wrapper queue by the caller
+	MIDI_TRACE_POINTS
+};
+
+//events kept per thread, the older ones are overwritten
+#define MIDI_TRACE_RING_SIZE 16384
+//threads that can record events at the same time, the ones after are ignored
+//a ring is reused by another thread once its thread exits
+#define MIDI_TRACE_MAX_THREADS 16
+
+extern std::atomic<bool> midiTraceEnabled;
+
+//allocates the rings, to call before enabling the tracing (only the first call allocates)
+void midiTraceReserve();
+
+//records the given point (and argument, usually the status byte) in the ring of the calling thread
+//the first event of a thread claims a free ring, nothing is recorded if there is none
+void midiTraceRecord(MidiTracePoint point, unsigned int arg);
+
+inline void midiTrace(MidiTracePoint point, unsigned int arg = 0) {
+	if (midiTraceEnabled.load(std::memory_order_relaxed)) {
+		midiTraceRecord(point, arg);
+	}
+}
+
+//forgets the events recorded so far by all the threads
+void midiTraceClear();
+
+//writes the events recorded so far as Chrome trace JSON, returns the number of events written
+//events overwritten while dumping are skipped, disable the tracing first for a complete trace
+unsigned long long midiTraceDump(std::ostream &out);
+
+#endif //MIDITRACE_H
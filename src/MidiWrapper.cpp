@@ -38,14 +38,27 @@
 
 
 #include "MidiWrapper.h"
+#include "MidiCaptureLog.h"
+#include "MidiChord.h"
+#include "MidiClock.h"
+#include "MidiFilter.h"
+#include "MidiLooper.h"
+#include "MidiNotes.h"
+#include "MidiPlayer.h"
+#include "MidiRecorder.h"
+#include "MidiRingBuffer.h"
+#include "MidiRouter.h"
+#include "MidiTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
 #include <queue>
 #include <string>
+#include <cstring>
 
 //define EXPORT_API __declspec(dllexport)
 
-//holders
-RtMidiIn  *midiin = NULL;
-RtMidiOut *midiout = NULL;
 //name holders for temporary passing (buffers ...)
 char in_name[1024];
 char out_name[1024];
@@ -53,11 +66,6 @@ char out_name[1024];
 //std::string deviceName = "NONAME";
 //unsigned int portUsed = -1;
 
-//midi notes status (velocity)
-std::vector<int> notesStatusVector;
-
-//midi notes last event received (timestamp in unix time)
-std::vector<double> notesStatusTimestampsVector;
 /*
 //for pedal status .... TODO later
 std::vector<bool> pedalsStatus;
@@ -65,13 +73,25 @@ for(int i=0;i<3;i++){
 	pedalsStatus.push_back(false);
 }
 */
-//midi notes last event received (timestamp in unix time)
-std::queue<MidiNoteMessage> notesMessagesQueue;
-//buffer for all midi messages that arrive
-std::queue < std::vector< unsigned char > > messagesQueue;
 
 unsigned int MAX_QUEUED_MESSAGES = 1000;
 
+//device hot-plug notifications: object they are listened on, events not read yet and user callback
+RtMidi *deviceWatcher = NULL;
+MidiRingBuffer<DeviceEvent> deviceEventsQueue(64);
+std::atomic<DeviceEventCallback> deviceEventCallback(NULL);
+
+//user function the sysex chunks are streamed to (NULL if sysex goes through the input queue)
+std::atomic<SysexChunkCallback> sysexChunkCallback(NULL);
+//user function the asynchronous sysex progress is reported to
+std::atomic<SysexProgressCallback> sysexProgressCallback(NULL);
+
+//live looper of the default input to the default output, see startLoopRecording
+MidiLooper looper;
+
+//reader to play a capture log back, see openCaptureLog
+MidiCaptureReader captureReader;
+
 //midi messages status for note on and note off
 int NOTE_ON_MESSAGE = 144;
 int NOTE_OFF_MESSAGE = 128;
@@ -79,15 +99,202 @@ int NOTE_OFF_MESSAGE = 128;
 
 int MIDI_STATUS_VECTORS_SIZE = 130; //max is 128 but this way I keep the real midi number for the indices and also an extra value just in case
 
+//counters behind getStats, updated without locks by the input and sending threads, read by any
+struct InputCounters {
+	std::atomic<unsigned long long> filtered;
+	std::atomic<unsigned long long> notesQueued;
+	std::atomic<unsigned int> notesQueueHighWater;
+	std::atomic<unsigned long long> messagesDropped;
+	std::atomic<unsigned int> messagesQueueHighWater;
+	std::atomic<unsigned long long> callbackHistogram[MIDI_STATS_HISTOGRAM_SIZE];
+	std::atomic<unsigned long long> callbackMaxNanoseconds;
+
+	void reset() {
+		filtered.store(0);
+		notesQueued.store(0);
+		notesQueueHighWater.store(0);
+		messagesDropped.store(0);
+		messagesQueueHighWater.store(0);
+		for (int i = 0; i < MIDI_STATS_HISTOGRAM_SIZE; i++) {
+			callbackHistogram[i].store(0);
+		}
+		callbackMaxNanoseconds.store(0);
+	}
+};
+
+struct OutputCounters {
+	std::atomic<unsigned long long> sent;
+	std::atomic<unsigned long long> sendErrors;
+	std::atomic<unsigned long long> sendNanoseconds;
+	std::atomic<unsigned long long> sendMaxNanoseconds;
+
+	void reset() {
+		sent.store(0);
+		sendErrors.store(0);
+		sendNanoseconds.store(0);
+		sendMaxNanoseconds.store(0);
+	}
+};
+
+//what the input callback feeds that only the functions without a handle reach
+//its recorder and capture rings are large, so only the default input has one
+struct DefaultInputFeatures {
+	//routes from the input to the route outputs, see setRoutes
+	MidiRouter router;
+	//standard MIDI file recording of the input, see startRecording
+	MidiRecorder recorder;
+	//compact capture log of the input, see startCapture
+	MidiCaptureLog captureLog;
+	//tempo and transport of the incoming MIDI clock, see enableClockTracking
+	MidiClockTracker clockTracker;
+};
+
+//an input instance: the input object, everything its callback feeds and the callback counters
+//the callback gets it as its user data, so the instances share nothing on their input threads
+//the queue and status below are only written by the input thread, other threads request their cleanup
+struct MidiInHandle {
+	RtMidiIn *midiin;
+	//whether incallback is set on midiin, destroying it waits for the call in flight (see cancelCallback)
+	bool callbackSet;
+	//set by cleanupInputHandle, the input thread empties the queue and zeroes the status on its next message
+	std::atomic<bool> cleanupRequested;
+	//midi notes status (velocity)
+	std::vector<int> notesStatusVector;
+	//midi notes last event received (timestamp in unix time)
+	std::vector<double> notesStatusTimestampsVector;
+	//note on and note off messages not read yet, pushed by the input thread and popped by the caller's one
+	MidiRingBuffer<MidiNoteMessage> notesMessagesQueue;
+	//buffer for all midi messages that arrive
+	std::queue < std::vector< unsigned char > > messagesQueue;
+	//messages let through to the input callback processing, see setInputFilter
+	MidiInputFilter inputFilter;
+	//router, recorders and clock tracker, NULL but for the default input
+	DefaultInputFeatures *defaults;
+	//note on / note off pairing, see getCompletedNotes and getOpenNotes
+	MidiNoteTracker noteTracker;
+	//chord of the held notes, and the change count getCurrentChord last returned
+	MidiChordTracker chordTracker;
+	unsigned int chordChangesSeen;
+	//input timeline (sum of the backend delta times) the trackers and recorders are fed with
+	double inputTime;
+	InputCounters counters;
+
+	explicit MidiInHandle(DefaultInputFeatures *defaults = NULL) : midiin(NULL), callbackSet(false), cleanupRequested(false),
+		notesStatusVector(MIDI_STATUS_VECTORS_SIZE, 0), notesStatusTimestampsVector(MIDI_STATUS_VECTORS_SIZE, 0.0),
+		notesMessagesQueue(4096), defaults(defaults), chordChangesSeen(0), inputTime(0.0) {
+		counters.reset();
+	}
+};
+
+//an output instance: the output object, the file player sending through it and the send counters
+struct MidiOutHandle {
+	RtMidiOut *midiout;
+	//held around every send to midiout: the caller's, the file player's and the looper's threads share it
+	std::mutex sendMutex;
+	//standard MIDI file playback to the output, see loadMidiFile
+	MidiPlayer player;
+	OutputCounters counters;
+
+	MidiOutHandle() : midiout(NULL) {
+		counters.reset();
+	}
+};
+
+//instances the functions without a handle work on
+DefaultInputFeatures defaultFeatures;
+MidiInHandle defaultInput(&defaultFeatures);
+MidiOutHandle defaultOutput;
+
+//raises the given counter to value if lower, safe with several writers
+template <typename T>
+void statsMax(std::atomic<T> &counter, T value) {
+	T current = counter.load(std::memory_order_relaxed);
+	while (value > current && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
 extern "C" {
 
 	///////////////////////////////////////////////////////////////////////////////////////////////////////
 	/// Helper functions
+	//nanoseconds elapsed since the given time
+	unsigned long long statsElapsed(const std::chrono::steady_clock::time_point &start) {
+		return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//steady clock now, in seconds
+	double steadySeconds() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//accounts an input callback call of the given duration in the histogram of the given counters
+	void statsCallback(InputCounters &counters, unsigned long long nanoseconds) {
+		static const unsigned long long bounds[MIDI_STATS_HISTOGRAM_SIZE - 1] = MIDI_STATS_HISTOGRAM_BOUNDS;
+		int bucket = 0;
+		while (bucket < MIDI_STATS_HISTOGRAM_SIZE - 1 && nanoseconds >= bounds[bucket] * 1000) {
+			bucket++;
+		}
+		counters.callbackHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+		statsMax(counters.callbackMaxNanoseconds, nanoseconds);
+	}
+
 	//callback that processes the input messages keeping track of the status of the notes and the input queue
-	void incallback( double deltatime, std::vector< unsigned char > *message, void * /*userData*/){
+	//of the input instance given as user data
+	void incallback( double deltatime, std::vector< unsigned char > *message, void *userData){
+		//chained to from outside code too, without an instance there is nothing to feed
+		if (userData == NULL) {
+			return;
+		}
+		std::chrono::steady_clock::time_point callbackStart = std::chrono::steady_clock::now();
+		MidiInHandle &handle = *(MidiInHandle *)userData;
+		midiTrace(MIDI_TRACE_CALLBACK_ENTER, message->empty() ? 0 : message->at(0));
+		handle.inputTime += deltatime;
+
+		if (handle.cleanupRequested.load(std::memory_order_acquire)) {
+			//there is this swap idiom but not clear() function
+			std::queue < std::vector< unsigned char > >().swap(handle.messagesQueue);
+			std::fill(handle.notesStatusVector.begin(), handle.notesStatusVector.end(), 0);
+			std::fill(handle.notesStatusTimestampsVector.begin(), handle.notesStatusTimestampsVector.end(), 0.0);
+			handle.cleanupRequested.store(false, std::memory_order_release);
+		}
+
+		//filtered out messages stop here, before reaching any queue or tracker
+		if (!message->empty() && !handle.inputFilter.accepts(&message->at(0), message->size())) {
+			handle.counters.filtered.fetch_add(1, std::memory_order_relaxed);
+			statsCallback(handle.counters, statsElapsed(callbackStart));
+			midiTrace(MIDI_TRACE_CALLBACK_EXIT);
+			return;
+		}
+
+		DefaultInputFeatures *defaults = handle.defaults;
+		if (!message->empty() && defaults != NULL) {
+			defaults->router.route(&message->at(0), message->size());
+			defaults->recorder.record(&message->at(0), message->size(), handle.inputTime);
+			looper.input(&message->at(0), message->size(), steadySeconds());
+			defaults->captureLog.capture(&message->at(0), message->size(), handle.inputTime);
+		}
+
+		//clock and transport messages only feed the tempo tracker, they are never queued
+		if (!message->empty() && MidiClockTracker::handles(message->at(0))) {
+			if (defaults != NULL) {
+				defaults->clockTracker.process(&message->at(0), message->size(), handle.inputTime, steadySeconds());
+			}
+			statsCallback(handle.counters, statsElapsed(callbackStart));
+			midiTrace(MIDI_TRACE_CALLBACK_EXIT);
+			return;
+		}
+
+		if (!message->empty()) {
+			handle.noteTracker.process(&message->at(0), message->size(), handle.inputTime);
+		}
+		//the chord is of the notes held on every channel, a note on of velocity 0 is a note off
+		if (message->size() >= 3 && ((message->at(0) & 0xF0) == 0x80 || (message->at(0) & 0xF0) == 0x90)) {
+			handle.chordTracker.note(message->at(0) & 0x0F, message->at(1), (message->at(0) & 0xF0) == 0x90 && message->at(2) > 0);
+		}
 	  
-		if(messagesQueue.size() > MAX_QUEUED_MESSAGES){
-			messagesQueue.pop();
+		if(handle.messagesQueue.size() > MAX_QUEUED_MESSAGES){
+			handle.messagesQueue.pop();
+			handle.counters.messagesDropped.fetch_add(1, std::memory_order_relaxed);
 		}
 		//new message for keeping record
 		std::vector< unsigned char > nMessage;
@@ -114,10 +321,14 @@ extern "C" {
 				msg.id = message->at(1);
 				msg.velocity = message->at(2);
 				msg.timestamp = deltatime;
-				notesMessagesQueue.push(msg);
+				if (handle.notesMessagesQueue.push(msg)) {
+					midiTrace(MIDI_TRACE_ENQUEUE, msg.code);
+					handle.counters.notesQueued.fetch_add(1, std::memory_order_relaxed);
+					statsMax(handle.counters.notesQueueHighWater, handle.notesMessagesQueue.size());
+				}
 				//changing the status of the notes vector
-				notesStatusVector[msg.id] = msg.velocity ;
-				notesStatusTimestampsVector[msg.id] = deltatime; //change it for absolute timestamp ... TODO
+				handle.notesStatusVector[msg.id] = msg.velocity ;
+				handle.notesStatusTimestampsVector[msg.id] = deltatime; //change it for absolute timestamp ... TODO
 
 				//std::cout << "stamp = " << deltatime << std::endl;
 			}catch(std::exception e){
@@ -127,8 +338,108 @@ extern "C" {
 		}
 		////////////////////////////////////
 		//all the messages types are stored as they came in here
-		messagesQueue.push(nMessage);
+		handle.messagesQueue.push(nMessage);
+		statsMax(handle.counters.messagesQueueHighWater, (unsigned int)handle.messagesQueue.size());
+		statsCallback(handle.counters, statsElapsed(callbackStart));
+		midiTrace(MIDI_TRACE_CALLBACK_EXIT);
+
+	}
 
+	//RtMidi falls back to the default API when the requested one is not compiled, refuse it instead
+	bool apiCompiled(int api) {
+		if (api == MIDI_API_DEFAULT) {
+			return true;
+		}
+		std::vector<RtMidi::Api> compiled;
+		RtMidi::getCompiledApi(compiled);
+		for (unsigned int i = 0; i < compiled.size(); i++) {
+			if (compiled[i] == api) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//copies the given name to the given space (of the given size) always zero terminating it
+	void copyName(char* dest, size_t size, const std::string &name) {
+		size_t len = name.size() < size - 1 ? name.size() : size - 1;
+		memcpy(dest, name.c_str(), len);
+		dest[len] = '\0';
+	}
+
+	//copies the names of all the ports of the given object in the given array (see enumerateInputPorts)
+	int enumeratePorts(RtMidi *rtmidi, PortInfo* out, int max) {
+		if (rtmidi == NULL) {
+			return 0;
+		}
+		std::vector<std::string> names;
+		try {
+			rtmidi->getPortNames(names);
+		}
+		catch (...) {
+			return 0;
+		}
+		for (int i = 0; out != NULL && i < max && i < (int)names.size(); i++) {
+			out[i].id = i;
+			copyName(out[i].name, sizeof(out[i].name), names[i]);
+		}
+		return (int)names.size();
+	}
+
+	//error callback used while enabling optional backend features, records the backend refusing them
+	bool backendRefused = false;
+	void refusalerror(RtMidiError::Type /*type*/, const std::string & /*errorText*/) {
+		backendRefused = true;
+	}
+
+	//callback that receives the port notifications from the backend and queues them as device events
+	void portcallback(const RtMidiPortEvent &event, void * /*userData*/) {
+		DeviceEvent de;
+		de.added = (event.type == RtMidiPortEvent::PORT_ADDED) ? 1 : 0;
+		de.isInput = event.isInput ? 1 : 0;
+		de.isOutput = event.isOutput ? 1 : 0;
+		copyName(de.name, sizeof(de.name), event.portName);
+		deviceEventsQueue.push(de);
+		DeviceEventCallback callback = deviceEventCallback.load();
+		if (callback != NULL) {
+			callback(&de);
+		}
+	}
+
+	//callback that forwards the sysex chunks from the backend to the user function
+	void sysexcallback(double timeStamp, const unsigned char *data, size_t size, int flags, void * /*userData*/) {
+		SysexChunkCallback callback = sysexChunkCallback.load();
+		if (callback != NULL) {
+			callback(data, (int)size, flags, timeStamp);
+		}
+	}
+
+	//callback that forwards the asynchronous sysex progress from the backend to the user function
+	void sysexprogress(unsigned int id, size_t sent, size_t total, int status, void * /*userData*/) {
+		SysexProgressCallback callback = sysexProgressCallback.load();
+		if (callback != NULL) {
+			callback(id, (int)sent, (int)total, status);
+		}
+	}
+
+	//sends the message to the output of the given instance accounting the call in its stats
+	//returns false if the backend threw
+	bool sendCounted(MidiOutHandle &handle, std::vector<unsigned char> &message) {
+		bool ret = true;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		try {
+			std::lock_guard<std::mutex> lock(handle.sendMutex);
+			handle.midiout->sendMessage(&message);
+		}
+		catch (...) {
+			handle.counters.sendErrors.fetch_add(1, std::memory_order_relaxed);
+			ret = false;
+		}
+		unsigned long long nanoseconds = statsElapsed(start);
+		handle.counters.sent.fetch_add(1, std::memory_order_relaxed);
+		handle.counters.sendNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+		statsMax(handle.counters.sendMaxNanoseconds, nanoseconds);
+		return ret;
 	}
 
 	//midi port opening and selection (from the ones available)
@@ -170,174 +481,534 @@ extern "C" {
 	  return portsAvailable;
 	}
 
-	///////////////////////////////////////////////////////////////////////////////////////////////////////
-	/// MIDI Initialization, Finalization & Status
+	//closes and deletes the input object of the given instance, if any
+	int destroyInputDevice(MidiInHandle &handle) {
+		int ret = 1;
+		try {
+			if (handle.midiin != NULL) {
+				if (handle.midiin->isPortOpen()) { handle.midiin->closePort(); }
+				//waits for the callback in flight, if any, so nothing uses the instance once it returns
+				if (handle.callbackSet) {
+					handle.midiin->cancelCallback();
+					handle.callbackSet = false;
+				}
+				if (deviceWatcher == handle.midiin) { disableDeviceNotifications(); }
+				delete handle.midiin;
+				handle.midiin = NULL;
+			}
+		} catch (...) { ret = 0; }
+		return ret;
+	}
 
-	EXPORT_DLL void setupEnv() {
-		//setup variables, mandatory before anything or the libray will give runtime exceptions
-		for (int i = 0; i<MIDI_STATUS_VECTORS_SIZE; i++) {
-			notesStatusVector.push_back(0);
+	//(re)creates the input object of the given instance
+	int createInputDevice(MidiInHandle &handle, int api, const char* clientName, unsigned int queueSize) {
+		int ret = 1;
+		if (!apiCompiled(api)) {
+			return 0;
 		}
-		for (int i = 0; i<MIDI_STATUS_VECTORS_SIZE; i++) {
-			notesStatusTimestampsVector.push_back(0.0);
+		try {
+			if (handle.midiin != NULL) { ret = destroyInputDevice(handle); }
+			handle.midiin = new RtMidiIn((RtMidi::Api)api,
+				clientName != NULL ? clientName : "RtMidi Input Client",
+				queueSize > 0 ? queueSize : 100);
+		} catch(...){ ret = 0; }
+		return ret;
+	}
+
+	//stops everything sending through the output object of the given instance, then closes and deletes it
+	int destroyOutputDevice(MidiOutHandle &handle) {
+		int ret = 1;
+		try {
+			if (handle.midiout != NULL) {
+				handle.player.stop();
+				if (&handle == &defaultOutput) { looper.stop(); }
+				if (handle.midiout->isPortOpen()) { handle.midiout->closePort(); }
+				if (deviceWatcher == handle.midiout) { disableDeviceNotifications(); }
+				delete handle.midiout;
+				handle.midiout = NULL;
+			}
 		}
+		catch (...) { ret = 0; }
+		return ret;
 	}
 
-	EXPORT_DLL int createInput() {
+	//(re)creates the output object of the given instance
+	int createOutputDevice(MidiOutHandle &handle, int api, const char* clientName) {
 		int ret = 1;
-		try { 
-			if (midiin != NULL) { ret = destroyInput(); }
-			midiin = new RtMidiIn();
-		} catch(...){ ret = 0; }
+		if (!apiCompiled(api)) {
+			return 0;
+		}
+		try {
+			if (handle.midiout != NULL) { ret = destroyOutputDevice(handle); }
+			handle.midiout = new RtMidiOut((RtMidi::Api)api,
+				clientName != NULL ? clientName : "RtMidi Output Client");
+		}
+		catch (...) { ret = 0; }
 		return ret;
 	}
 
+	//pops the next note message of the given input instance, returns false if there is none
+	bool popNoteMessage(MidiInHandle &handle, MidiNoteMessage &message) {
+		if (!handle.notesMessagesQueue.pop(message)) {
+			return false;
+		}
+		midiTrace(MIDI_TRACE_DEQUEUE, message.code);
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////
+	/// MIDI Initialization, Finalization & Status
+
+	EXPORT_DLL void setupEnv() {
+		//nothing left to setup, the input instances size their status when created
+	}
+
+	EXPORT_DLL int createInput() {
+		return createInputEx(MIDI_API_DEFAULT, NULL, 0);
+	}
+
+	EXPORT_DLL int createInputEx(int api, const char* clientName, unsigned int queueSize) {
+		return createInputDevice(defaultInput, api, clientName, queueSize);
+	}
+
+	EXPORT_DLL int getCompiledApis(int* apis, int max) {
+		std::vector<RtMidi::Api> compiled;
+		RtMidi::getCompiledApi(compiled);
+		for (int i = 0; apis != NULL && i < max && i < (int)compiled.size(); i++) {
+			apis[i] = compiled[i];
+		}
+		return (int)compiled.size();
+	}
+
+	EXPORT_DLL int getInputApi() {
+		return defaultInput.midiin != NULL ? defaultInput.midiin->getCurrentApi() : MIDI_API_DEFAULT;
+	}
+
 	EXPORT_DLL void cleanupInputEnv() {
-		//there is this swap idiom but not clear() function
-		notesMessagesQueue.swap(std::queue<MidiNoteMessage>());
-		messagesQueue.swap(std::queue < std::vector< unsigned char > >());
-		//then the new queue gets out of scope and "gc" takes its place
-		notesStatusVector.clear();
-		notesStatusTimestampsVector.clear();
+		cleanupInputHandle(&defaultInput);
 	}
 
 	EXPORT_DLL int destroyInput() {
-		int ret = 1;
-		try {
-			if (midiin != NULL) {
-				if (midiin->isPortOpen()) { midiin->closePort(); }
-				delete midiin;
-				midiin = NULL;
-			}
-		} catch (...) { ret = 0; }
-		return ret;
+		return destroyInputDevice(defaultInput);
 	}
 	
 	EXPORT_DLL int openInputPort(int port) {
-		int ret = 0;
-		if(chooseMidiPort(midiin, port) == true) {
-			midiin->setCallback(&incallback);
-			ret = 1;
-		}
-		return ret;
+		return openInputHandlePort(&defaultInput, port);
 	}
 
 	EXPORT_DLL void closeInputPort() {
-		if (midiin != NULL && midiin->isPortOpen()) {
-			midiin->closePort();
-		}
+		closeInputHandlePort(&defaultInput);
 	}
 
 	EXPORT_DLL int isInputPortOpen() {
-		int ret = 0;
-		if (midiin != NULL) { ret = (midiin->isPortOpen() ? 1 : 0); }
-		return ret;
+		return isInputHandlePortOpen(&defaultInput);
 	}
 
 	EXPORT_DLL unsigned int getInPortCount() {
 		unsigned int ret = 0;
-		if (midiin != NULL) { ret = midiin->getPortCount(); }
+		if (defaultInput.midiin != NULL) { ret = defaultInput.midiin->getPortCount(); }
 		return ret;
 	}
 
 	EXPORT_DLL void getInputPortName(char* name, unsigned int port) {
+		RtMidiIn *midiin = defaultInput.midiin;
 		if (midiin != NULL && port>=0 && midiin->getPortCount() > port) {
 			std::string pname = midiin->getPortName(port);
-			const char* cname = pname.c_str();
-			strcpy_s(name, pname.size() + 1, cname);
+			//the caller's space is assumed big enough, as before
+			copyName(name, pname.size() + 1, pname);
 		}
 		//nothing
 	}
 
 	EXPORT_DLL char * getInputPortNamePtr(unsigned int port) {
+		RtMidiIn *midiin = defaultInput.midiin;
 		if (midiin != NULL && port >= 0 && midiin->getPortCount() > port) {
-			std::string pname = midiin->getPortName(port);
-			const char* cname = pname.c_str();
-			strcpy_s(in_name, pname.size() + 1, cname);
-			
+			copyName(in_name, sizeof(in_name), midiin->getPortName(port));
 		}
 		else {
-			strcpy_s(in_name, 6 + 1, "NONAME");
+			copyName(in_name, sizeof(in_name), "NONAME");
 		}
 		return in_name;
 	}
 
+	EXPORT_DLL int enumerateInputPorts(PortInfo* out, int max) {
+		return enumerateInputHandlePorts(&defaultInput, out, max);
+	}
+
 	EXPORT_DLL int createOutput() {
-		int ret = 1;
-		try {
-			if (midiout != NULL) { ret = destroyOutput(); }
-			midiout = new RtMidiOut();
-		}
-		catch (...) { ret = 0; }
-		return ret;
+		return createOutputEx(MIDI_API_DEFAULT, NULL);
+	}
+
+	EXPORT_DLL int createOutputEx(int api, const char* clientName) {
+		return createOutputDevice(defaultOutput, api, clientName);
+	}
+
+	EXPORT_DLL int getOutputApi() {
+		return defaultOutput.midiout != NULL ? defaultOutput.midiout->getCurrentApi() : MIDI_API_DEFAULT;
 	}
 
 	EXPORT_DLL int destroyOutput() {
-		int ret = 1;
-		try {
-			if (midiout != NULL) {
-				if (midiout->isPortOpen()) { midiout->closePort(); }
-				delete midiout;
-				midiout = NULL;
-			}
-		}
-		catch (...) { ret = 0; }
-		return ret;
+		return destroyOutputDevice(defaultOutput);
 	}
 
 	EXPORT_DLL int isOutputPortOpen() {
-		int ret = 0;
-		if (midiout != NULL) { ret = (midiout->isPortOpen() ? 1 : 0); }
-		return ret;
+		return isOutputHandlePortOpen(&defaultOutput);
 	}
 
 	EXPORT_DLL unsigned int getOutPortCount() {
 		unsigned int ret = 0;
-		if (midiout != NULL) { ret = midiout->getPortCount(); }
+		if (defaultOutput.midiout != NULL) { ret = defaultOutput.midiout->getPortCount(); }
 		return ret;
 	}
 
 	EXPORT_DLL int openOutputPort(int port) {
-		int ret = 0;
-		(chooseMidiPort(midiout, port) == true) ? ret = 1 : ret = 0;
-		return ret;
+		return openOutputHandlePort(&defaultOutput, port);
 	}
 
 	EXPORT_DLL void closeOutputPort() {
-		if (midiout != NULL && midiout->isPortOpen()) {
-			midiout->closePort();
-		}
+		closeOutputHandlePort(&defaultOutput);
 	}
 
 	EXPORT_DLL void getOutputPortName(char* name, unsigned int port) {
+		RtMidiOut *midiout = defaultOutput.midiout;
 		if (midiout != NULL && port >= 0 && midiout->getPortCount() > port) {
 			std::string pname = midiout->getPortName(port);
-			const char* cname = pname.c_str();
-			strcpy_s(name, pname.size() + 1, cname);
+			//the caller's space is assumed big enough, as before
+			copyName(name, pname.size() + 1, pname);
 		}
 		//nothing
 	}
 
 	EXPORT_DLL char * getOutputPortNamePtr(unsigned int port) {
-		if (midiin != NULL && port >= 0 && midiin->getPortCount() > port) {
-			std::string pname = midiout->getPortName(port);
-			const char* cname = pname.c_str();
-			strcpy_s(out_name, pname.size() + 1, cname);
-
+		RtMidiOut *midiout = defaultOutput.midiout;
+		if (midiout != NULL && port >= 0 && midiout->getPortCount() > port) {
+			copyName(out_name, sizeof(out_name), midiout->getPortName(port));
 		}
 		else {
-			strcpy_s(out_name, 6 + 1, "NONAME");
+			copyName(out_name, sizeof(out_name), "NONAME");
 		}
 		return out_name;
 	}
+
+	EXPORT_DLL int enumerateOutputPorts(PortInfo* out, int max) {
+		return enumerateOutputHandlePorts(&defaultOutput, out, max);
+	}
+	///////////////////////////////////////////////////////////////////////////////////////////////////////
+	// MIDI instances (handles)
+
+	EXPORT_DLL MidiInHandle* createInputHandle(int api, const char* clientName, unsigned int queueSize) {
+		MidiInHandle *handle = NULL;
+		try {
+			handle = new MidiInHandle();
+			if (createInputDevice(*handle, api, clientName, queueSize) == 0) {
+				delete handle;
+				handle = NULL;
+			}
+		}
+		catch (...) {
+			delete handle;
+			handle = NULL;
+		}
+		return handle;
+	}
+
+	EXPORT_DLL int destroyInputHandle(MidiInHandle* handle) {
+		if (handle == NULL) {
+			return 0;
+		}
+		int ret = destroyInputDevice(*handle);
+		if (handle != &defaultInput) {
+			delete handle;
+		}
+		return ret;
+	}
+
+	EXPORT_DLL MidiInHandle* getDefaultInputHandle() {
+		return &defaultInput;
+	}
+
+	EXPORT_DLL int openInputHandlePort(MidiInHandle* handle, int port) {
+		int ret = 0;
+		if (handle != NULL && chooseMidiPort(handle->midiin, port) == true) {
+			if (!handle->callbackSet) {
+				handle->midiin->setCallback(&incallback, handle);
+				handle->callbackSet = true;
+			}
+			ret = 1;
+		}
+		return ret;
+	}
+
+	EXPORT_DLL void closeInputHandlePort(MidiInHandle* handle) {
+		if (handle != NULL && handle->midiin != NULL && handle->midiin->isPortOpen()) {
+			handle->midiin->closePort();
+		}
+	}
+
+	EXPORT_DLL int isInputHandlePortOpen(MidiInHandle* handle) {
+		int ret = 0;
+		if (handle != NULL && handle->midiin != NULL) { ret = (handle->midiin->isPortOpen() ? 1 : 0); }
+		return ret;
+	}
+
+	EXPORT_DLL int enumerateInputHandlePorts(MidiInHandle* handle, PortInfo* out, int max) {
+		return handle != NULL ? enumeratePorts(handle->midiin, out, max) : 0;
+	}
+
+	EXPORT_DLL void cleanupInputHandle(MidiInHandle* handle) {
+		if (handle == NULL) {
+			return;
+		}
+		//the notes queue is emptied from the consumer side, the rest is reset by the input thread
+		handle->notesMessagesQueue.clear();
+		handle->chordTracker.reset();
+		handle->noteTracker.reset();
+		handle->cleanupRequested.store(true, std::memory_order_release);
+	}
+
+	EXPORT_DLL int getInputHandleMessage(MidiInHandle* handle, MidiNoteMessage &message) {
+		return (handle != NULL && popNoteMessage(*handle, message)) ? 1 : 0;
+	}
+
+	EXPORT_DLL int getInputHandleCompletedNotes(MidiInHandle* handle, MidiCompletedNote* notes, int max) {
+		if (handle == NULL) {
+			return 0;
+		}
+		MidiNoteTracker::CompletedNote completed[64];
+		int count = 0;
+		while (notes != NULL && count < max) {
+			unsigned int chunk = max - count < 64 ? (unsigned int)(max - count) : 64;
+			unsigned int n = handle->noteTracker.drain(completed, chunk);
+			for (unsigned int i = 0; i < n; i++, count++) {
+				notes[count].channel = completed[i].channel;
+				notes[count].note = completed[i].note;
+				notes[count].velocity = completed[i].velocity;
+				notes[count].releaseVelocity = completed[i].releaseVelocity;
+				notes[count].start = completed[i].start;
+				notes[count].duration = completed[i].duration;
+			}
+			if (n < chunk) {
+				break;
+			}
+		}
+		return count;
+	}
+
+	EXPORT_DLL int getInputHandleOpenNotes(MidiInHandle* handle, MidiOpenNote* notes, int max, double &time) {
+		if (handle == NULL) {
+			return 0;
+		}
+		MidiNoteTracker::OpenNote open[16 * 128];
+		unsigned int count = handle->noteTracker.snapshot(open, 16 * 128, time);
+		for (unsigned int i = 0; notes != NULL && (int)i < max && i < count; i++) {
+			notes[i].channel = open[i].channel;
+			notes[i].note = open[i].note;
+			notes[i].velocity = open[i].velocity;
+			notes[i].start = open[i].start;
+		}
+		return (int)count;
+	}
+
+	EXPORT_DLL int getInputHandleChord(MidiInHandle* handle, MidiChord* chord) {
+		if (handle == NULL || chord == NULL) {
+			return 0;
+		}
+		unsigned int changes = handle->chordTracker.changes();
+		MidiChordTracker::Chord current = handle->chordTracker.current();
+		chord->quality = current.quality;
+		chord->root = current.root;
+		chord->inversion = current.inversion;
+		chord->bass = current.bass;
+		chord->pitchClasses = current.pitchClasses;
+		int changed = changes != handle->chordChangesSeen ? 1 : 0;
+		handle->chordChangesSeen = changes;
+		return changed;
+	}
+
+	EXPORT_DLL void setInputHandleFilter(MidiInHandle* handle, const MidiFilter* filter) {
+		if (handle == NULL) {
+			return;
+		}
+		if (filter == NULL) {
+			handle->inputFilter.passAll();
+			return;
+		}
+		handle->inputFilter.compile((unsigned int)filter->types, filter->channels, filter->noteLow, filter->noteHigh, filter->controllers);
+	}
+
+	EXPORT_DLL int getInputHandleStats(MidiInHandle* handle, MidiStats* stats) {
+		if (handle == NULL || stats == NULL) {
+			return 0;
+		}
+		*stats = MidiStats();
+		if (handle->midiin != NULL) {
+			RtMidiIn::InputStats is;
+			handle->midiin->getInputStats(&is);
+			stats->received = is.received;
+			stats->backendDropped = is.queueDrops;
+			stats->backendOverruns = is.overruns;
+			stats->backendQueueHighWater = is.queueHighWater;
+		}
+		InputCounters &counters = handle->counters;
+		stats->filtered = counters.filtered.load(std::memory_order_relaxed);
+		stats->notesQueued = counters.notesQueued.load(std::memory_order_relaxed);
+		stats->notesDropped = handle->notesMessagesQueue.drops();
+		stats->notesQueueHighWater = counters.notesQueueHighWater.load(std::memory_order_relaxed);
+		stats->completedNotesDropped = handle->noteTracker.dropped();
+		stats->messagesDropped = counters.messagesDropped.load(std::memory_order_relaxed);
+		stats->messagesQueueHighWater = counters.messagesQueueHighWater.load(std::memory_order_relaxed);
+		for (int i = 0; i < MIDI_STATS_HISTOGRAM_SIZE; i++) {
+			stats->callbackHistogram[i] = counters.callbackHistogram[i].load(std::memory_order_relaxed);
+		}
+		stats->callbackMaxNanoseconds = counters.callbackMaxNanoseconds.load(std::memory_order_relaxed);
+		stats->routed = handle->defaults != NULL ? handle->defaults->router.routed() : 0;
+		stats->routeErrors = handle->defaults != NULL ? handle->defaults->router.errors() : 0;
+		return 1;
+	}
+
+	EXPORT_DLL void resetInputHandleStats(MidiInHandle* handle) {
+		if (handle == NULL) {
+			return;
+		}
+		if (handle->midiin != NULL) {
+			handle->midiin->resetInputStats();
+		}
+		handle->notesMessagesQueue.resetDrops();
+		if (handle->defaults != NULL) {
+			handle->defaults->router.resetCounters();
+		}
+		handle->counters.reset();
+	}
+
+	EXPORT_DLL MidiOutHandle* createOutputHandle(int api, const char* clientName) {
+		MidiOutHandle *handle = NULL;
+		try {
+			handle = new MidiOutHandle();
+			if (createOutputDevice(*handle, api, clientName) == 0) {
+				delete handle;
+				handle = NULL;
+			}
+		}
+		catch (...) {
+			delete handle;
+			handle = NULL;
+		}
+		return handle;
+	}
+
+	EXPORT_DLL int destroyOutputHandle(MidiOutHandle* handle) {
+		if (handle == NULL) {
+			return 0;
+		}
+		int ret = destroyOutputDevice(*handle);
+		if (handle != &defaultOutput) {
+			delete handle;
+		}
+		return ret;
+	}
+
+	EXPORT_DLL MidiOutHandle* getDefaultOutputHandle() {
+		return &defaultOutput;
+	}
+
+	EXPORT_DLL int openOutputHandlePort(MidiOutHandle* handle, int port) {
+		return (handle != NULL && chooseMidiPort(handle->midiout, port) == true) ? 1 : 0;
+	}
+
+	EXPORT_DLL void closeOutputHandlePort(MidiOutHandle* handle) {
+		if (handle == NULL) {
+			return;
+		}
+		handle->player.stop();
+		if (handle == &defaultOutput) {
+			looper.stop();
+		}
+		if (handle->midiout != NULL && handle->midiout->isPortOpen()) {
+			handle->midiout->closePort();
+		}
+	}
+
+	EXPORT_DLL int isOutputHandlePortOpen(MidiOutHandle* handle) {
+		int ret = 0;
+		if (handle != NULL && handle->midiout != NULL) { ret = (handle->midiout->isPortOpen() ? 1 : 0); }
+		return ret;
+	}
+
+	EXPORT_DLL int enumerateOutputHandlePorts(MidiOutHandle* handle, PortInfo* out, int max) {
+		return handle != NULL ? enumeratePorts(handle->midiout, out, max) : 0;
+	}
+
+	EXPORT_DLL int sendOutputHandleMessage(MidiOutHandle* handle, const unsigned char* message, int size) {
+		if (handle == NULL || handle->midiout == NULL || message == NULL || size <= 0) {
+			return 0;
+		}
+		std::vector<unsigned char> bytes(message, message + size);
+		return sendCounted(*handle, bytes) ? 1 : 0;
+	}
+
+	EXPORT_DLL int getOutputHandleStats(MidiOutHandle* handle, MidiStats* stats) {
+		if (handle == NULL || stats == NULL) {
+			return 0;
+		}
+		*stats = MidiStats();
+		OutputCounters &counters = handle->counters;
+		stats->sent = counters.sent.load(std::memory_order_relaxed);
+		stats->sendErrors = counters.sendErrors.load(std::memory_order_relaxed);
+		stats->avgSendMicros = stats->sent > 0 ? counters.sendNanoseconds.load(std::memory_order_relaxed) / (1000.0 * stats->sent) : 0.0;
+		stats->sendMaxNanoseconds = counters.sendMaxNanoseconds.load(std::memory_order_relaxed);
+		return 1;
+	}
+
+	EXPORT_DLL void resetOutputHandleStats(MidiOutHandle* handle) {
+		if (handle != NULL) {
+			handle->counters.reset();
+		}
+	}
+	///////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Device notifications
+
+	EXPORT_DLL int enableDeviceNotifications() {
+		int ret = 0;
+		RtMidi *watcher = (defaultInput.midiin != NULL) ? (RtMidi *)defaultInput.midiin : (RtMidi *)defaultOutput.midiout;
+		if (watcher == NULL) {
+			return ret;
+		}
+		disableDeviceNotifications();
+		//the backend only warns when notifications are not available, catch that as a failure
+		watcher->setErrorCallback(&refusalerror);
+		backendRefused = false;
+		try {
+			watcher->setPortCallback(&portcallback);
+			ret = backendRefused ? 0 : 1;
+		}
+		catch (...) { ret = 0; }
+		watcher->setErrorCallback(NULL);
+		if (ret == 1) {
+			deviceWatcher = watcher;
+		}
+		return ret;
+	}
+
+	EXPORT_DLL void disableDeviceNotifications() {
+		if (deviceWatcher != NULL) {
+			deviceWatcher->cancelPortCallback();
+			deviceWatcher = NULL;
+		}
+	}
+
+	EXPORT_DLL int getNextDeviceEvent(DeviceEvent &event) {
+		return deviceEventsQueue.pop(event) ? 1 : 0;
+	}
+
+	EXPORT_DLL void setDeviceEventCallback(DeviceEventCallback callback) {
+		deviceEventCallback.store(callback);
+	}
 	///////////////////////////////////////////////////////////////////////////////////////////////////////
 	// MIDI Input
 
 	EXPORT_DLL MidiNoteMessage getNextMessageStruct() {
-		if (notesMessagesQueue.size() > 0) {
-			MidiNoteMessage nm = notesMessagesQueue.front();
-			//erase it
-			notesMessagesQueue.pop();
+		MidiNoteMessage nm;
+		if (popNoteMessage(defaultInput, nm)) {
 			return nm;
 		}
 		MidiNoteMessage em;
@@ -346,22 +1017,13 @@ extern "C" {
 
 	//get next noteOn or noteOff message
 	void fillWithNextNoteMessage(MidiNoteMessage &message) {
-		//get reference
-		if (notesMessagesQueue.size() > 0) {
-			MidiNoteMessage nm = notesMessagesQueue.front();
-			//erase it
-			notesMessagesQueue.pop();
-
-			message.code = nm.code;
-			message.id = nm.id;
-			message.velocity = nm.velocity;
-			message.timestamp = nm.timestamp;
-		}
+		getInputHandleMessage(&defaultInput, message);
 	}
 
 	EXPORT_DLL long getNextMessageAsLong() {
 		long ret = 0x00000000;
-		if (notesMessagesQueue.size() > 0) {
+		MidiNoteMessage nm;
+		if (popNoteMessage(defaultInput, nm)) {
 			/*
 			//directly from bytes
 			std::vector< unsigned char > bm = messagesQueue.front();
@@ -372,10 +1034,6 @@ extern "C" {
 				}
 			}*/
 			//from MidiNoteMessage
-			MidiNoteMessage nm = notesMessagesQueue.front();
-			//erase it
-			notesMessagesQueue.pop();
-
 			ret = nm.code << 8*7;
 			ret = ret | nm.id << 8*6;
 			ret = ret | nm.velocity << 8*5;
@@ -384,13 +1042,19 @@ extern "C" {
 		return ret;
 	}
 
+	EXPORT_DLL int getCompletedNotes(MidiCompletedNote* notes, int max) {
+		return getInputHandleCompletedNotes(&defaultInput, notes, max);
+	}
+
+	EXPORT_DLL int getOpenNotes(MidiOpenNote* notes, int max, double &time) {
+		return getInputHandleOpenNotes(&defaultInput, notes, max, time);
+	}
+
 	EXPORT_DLL unsigned int getNextMessageAsUInt() {
 		long ret = 0x00000000;
-		if (notesMessagesQueue.size() > 0) {
+		MidiNoteMessage nm;
+		if (popNoteMessage(defaultInput, nm)) {
 			//from MidiNoteMessage
-			MidiNoteMessage nm = notesMessagesQueue.front();
-			//erase it
-			notesMessagesQueue.pop();
 			//Warning with shift might fail with other compilers ... ?? need to previously cast the original before shifting
 			ret = nm.code << 8 *3;
 			ret = ret | nm.id << 8 * 2;
@@ -399,6 +1063,269 @@ extern "C" {
 		}
 		return ret;
 	}
+
+	EXPORT_DLL int setInputSpinPolling(unsigned int maxSpinMicroseconds) {
+		int ret = 0;
+		if (defaultInput.midiin != NULL) {
+			RtMidiIn::PollingStats stats;
+			if (defaultInput.midiin->getPollingStats(&stats)) {
+				defaultInput.midiin->setSpinPolling(maxSpinMicroseconds);
+				ret = 1;
+			}
+		}
+		return ret;
+	}
+
+	EXPORT_DLL int getInputPollingStats(MidiPollingStats &stats) {
+		RtMidiIn::PollingStats ps;
+		if (defaultInput.midiin == NULL || !defaultInput.midiin->getPollingStats(&ps)) {
+			return 0;
+		}
+		stats.spinHits = ps.spinHits;
+		stats.spinMisses = ps.spinMisses;
+		stats.pollWakeups = ps.pollWakeups;
+		stats.spinNanoseconds = ps.spinNanoseconds;
+		stats.avgSpinLatencyMicros = ps.spinLatencyCount > 0 ? ps.spinLatencyNanoseconds / (1000.0 * ps.spinLatencyCount) : 0.0;
+		stats.avgPollLatencyMicros = ps.pollLatencyCount > 0 ? ps.pollLatencyNanoseconds / (1000.0 * ps.pollLatencyCount) : 0.0;
+		stats.maxSpinMicroseconds = ps.maxSpinMicroseconds;
+		stats.currentSpinMicroseconds = ps.currentSpinMicroseconds;
+		return 1;
+	}
+
+	EXPORT_DLL int setInputSysexCallback(SysexChunkCallback callback) {
+		int ret = 0;
+		if (defaultInput.midiin == NULL) {
+			return ret;
+		}
+		if (callback == NULL) {
+			defaultInput.midiin->cancelSysexCallback();
+			sysexChunkCallback.store(NULL);
+			return 1;
+		}
+		sysexChunkCallback.store(callback);
+		//the backend only warns when streaming is not available, catch that as a failure
+		defaultInput.midiin->setErrorCallback(&refusalerror);
+		backendRefused = false;
+		try {
+			defaultInput.midiin->setSysexCallback(&sysexcallback);
+			ret = backendRefused ? 0 : 1;
+		}
+		catch (...) { ret = 0; }
+		defaultInput.midiin->setErrorCallback(NULL);
+		return ret;
+	}
+
+	EXPORT_DLL int getStats(MidiStats* stats) {
+		MidiStats output;
+		if (!getInputHandleStats(&defaultInput, stats) || !getOutputHandleStats(&defaultOutput, &output)) {
+			return 0;
+		}
+		stats->sent = output.sent;
+		stats->sendErrors = output.sendErrors;
+		stats->avgSendMicros = output.avgSendMicros;
+		stats->sendMaxNanoseconds = output.sendMaxNanoseconds;
+		return 1;
+	}
+
+	EXPORT_DLL void resetStats() {
+		resetInputHandleStats(&defaultInput);
+		resetOutputHandleStats(&defaultOutput);
+	}
+
+	EXPORT_DLL void setInputFilter(const MidiFilter* filter) {
+		setInputHandleFilter(&defaultInput, filter);
+	}
+
+	EXPORT_DLL int openRouteOutput(int api, int port) {
+		if (!apiCompiled(api) || port < 0) {
+			return -1;
+		}
+		RtMidiOut *output = NULL;
+		try {
+			output = new RtMidiOut((RtMidi::Api)api, "RtMidi Route Output Client");
+			output->openPort((unsigned int)port);
+			if (!output->isPortOpen()) {
+				delete output;
+				return -1;
+			}
+			return defaultFeatures.router.addOutput(output);
+		}
+		catch (...) {
+			delete output;
+			return -1;
+		}
+	}
+
+	EXPORT_DLL int setRoutes(const MidiRoute* routes, int count) {
+		if (count < 0 || (routes == NULL && count > 0)) {
+			return 0;
+		}
+		int ret = 0;
+		try {
+			std::vector<MidiRouter::RouteSettings> settings(count);
+			for (int i = 0; i < count; i++) {
+				MidiRouter::RouteSettings &route = settings[i];
+				route.output = routes[i].output;
+				route.types = (unsigned int)routes[i].filter.types;
+				route.channels = routes[i].filter.channels;
+				route.noteLow = routes[i].filter.noteLow;
+				route.noteHigh = routes[i].filter.noteHigh;
+				memcpy(route.controllers, routes[i].filter.controllers, sizeof(route.controllers));
+				if (routes[i].transformCount < 0 || routes[i].transformCount > MIDI_ROUTE_MAX_TRANSFORMS) {
+					return 0;
+				}
+				route.transformCount = (unsigned int)routes[i].transformCount;
+				for (int t = 0; t < routes[i].transformCount; t++) {
+					route.transforms[t].type = routes[i].transforms[t].type;
+					route.transforms[t].amount = routes[i].transforms[t].amount;
+					memcpy(route.transforms[t].table, routes[i].transforms[t].table, sizeof(route.transforms[t].table));
+				}
+			}
+			ret = defaultFeatures.router.setRoutes(count > 0 ? &settings[0] : NULL, (unsigned int)count) ? 1 : 0;
+		}
+		catch (...) { ret = 0; }
+		return ret;
+	}
+
+	EXPORT_DLL void closeRouteOutputs() {
+		defaultFeatures.router.clear();
+	}
+
+	EXPORT_DLL int getCurrentChord(MidiChord* chord) {
+		return getInputHandleChord(&defaultInput, chord);
+	}
+
+	EXPORT_DLL int enableClockTracking(int enabled) {
+		if (defaultInput.midiin == NULL) {
+			return 0;
+		}
+		defaultFeatures.clockTracker.reset();
+		defaultInput.midiin->ignoreTypes(true, enabled == 0, true);
+		return 1;
+	}
+
+	EXPORT_DLL double getClockBpm() {
+		return defaultFeatures.clockTracker.bpm(steadySeconds());
+	}
+
+	EXPORT_DLL double getClockBeats() {
+		return defaultFeatures.clockTracker.beats(steadySeconds());
+	}
+
+	EXPORT_DLL double getClockBeatPhase() {
+		return defaultFeatures.clockTracker.beatPhase(steadySeconds());
+	}
+
+	EXPORT_DLL int getClockTransport() {
+		return defaultFeatures.clockTracker.isRunning() ? 1 : 0;
+	}
+
+	EXPORT_DLL int startRecording(const char* path, int format) {
+		int ret = 0;
+		if (path != NULL) {
+			try {
+				ret = defaultFeatures.recorder.start(path, format) ? 1 : 0;
+			}
+			catch (...) { ret = 0; }
+		}
+		return ret;
+	}
+
+	EXPORT_DLL int stopRecording() {
+		return defaultFeatures.recorder.stop() ? 1 : 0;
+	}
+
+	EXPORT_DLL int getRecordingStatus(unsigned long long &events, unsigned long long &dropped) {
+		events = defaultFeatures.recorder.recorded();
+		dropped = defaultFeatures.recorder.dropped();
+		return defaultFeatures.recorder.isRecording() ? 1 : 0;
+	}
+
+	EXPORT_DLL int startCapture(const char* path) {
+		int ret = 0;
+		if (path != NULL) {
+			try {
+				ret = defaultFeatures.captureLog.start(path) ? 1 : 0;
+			}
+			catch (...) { ret = 0; }
+		}
+		return ret;
+	}
+
+	EXPORT_DLL int stopCapture() {
+		return defaultFeatures.captureLog.stop() ? 1 : 0;
+	}
+
+	EXPORT_DLL int getCaptureStatus(unsigned long long &events, unsigned long long &dropped, unsigned long long &bytes) {
+		events = defaultFeatures.captureLog.captured();
+		dropped = defaultFeatures.captureLog.dropped();
+		bytes = defaultFeatures.captureLog.written();
+		return defaultFeatures.captureLog.isCapturing() ? 1 : 0;
+	}
+
+	EXPORT_DLL int openCaptureLog(const char* path) {
+		int ret = 0;
+		if (path != NULL) {
+			try {
+				ret = captureReader.open(path) ? 1 : 0;
+			}
+			catch (...) { ret = 0; }
+		}
+		return ret;
+	}
+
+	EXPORT_DLL void seekCaptureLog(double seconds) {
+		try {
+			captureReader.seek(seconds);
+		}
+		catch (...) {}
+	}
+
+	EXPORT_DLL int readCaptureLog(double &time, unsigned char *message, int size) {
+		std::vector<unsigned char> captured;
+		try {
+			if (!captureReader.next(time, captured)) {
+				return 0;
+			}
+		}
+		catch (...) { return 0; }
+		if (message == NULL || (int)captured.size() > size) {
+			return -(int)captured.size();
+		}
+		memcpy(message, &captured[0], captured.size());
+		return (int)captured.size();
+	}
+
+	EXPORT_DLL void closeCaptureLog() {
+		captureReader.close();
+	}
+
+	EXPORT_DLL void enableTrace(int enabled) {
+		if (enabled != 0) {
+			try {
+				midiTraceReserve();
+			}
+			catch (...) { return; }
+		}
+		midiTraceEnabled.store(enabled != 0);
+	}
+
+	EXPORT_DLL void clearTrace() {
+		midiTraceClear();
+	}
+
+	EXPORT_DLL int dumpTrace(const char* path) {
+		if (path == NULL) {
+			return -1;
+		}
+		std::ofstream file(path);
+		if (!file) {
+			return -1;
+		}
+		unsigned long long written = midiTraceDump(file);
+		file.close();
+		return file.fail() ? -1 : (int)written;
+	}
 	///////////////////////////////////////////////////////////////////////////////////////////////////////
 	// MIDI Output
 
@@ -421,7 +1348,7 @@ extern "C" {
 		}
 		//TODO verify
 		
-		midiout->sendMessage(&message);
+		sendCounted(defaultOutput, message);
 	}
 
 	EXPORT_DLL void noteOn(unsigned char id, unsigned char velocity, int channel) {
@@ -431,7 +1358,7 @@ extern "C" {
 		message.push_back(NOTE_ON_MESSAGE);
 		message.push_back(id);
 		message.push_back(velocity);
-		midiout->sendMessage(&message);
+		sendCounted(defaultOutput, message);
 	}
 
 	EXPORT_DLL void noteOff(unsigned char id, int channel) {
@@ -440,14 +1367,155 @@ extern "C" {
 		message.push_back(NOTE_OFF_MESSAGE);
 		message.push_back(id);
 		message.push_back(0);
-		midiout->sendMessage(&message);
+		sendCounted(defaultOutput, message);
+	}
+
+	EXPORT_DLL unsigned int sendSysexAsync(const unsigned char *data, int size) {
+		unsigned int ret = 0;
+		if (defaultOutput.midiout == NULL || data == NULL || size < 2) {
+			return ret;
+		}
+		std::vector<unsigned char> message(data, data + size);
+		try {
+			ret = defaultOutput.midiout->sendSysexAsync(message, &sysexprogress);
+		}
+		catch (...) { ret = 0; }
+		return ret;
+	}
+
+	EXPORT_DLL void setSysexPacing(unsigned int chunkSize, unsigned int intervalMicroseconds) {
+		if (defaultOutput.midiout != NULL) {
+			try {
+				defaultOutput.midiout->setSysexPacing(chunkSize, intervalMicroseconds);
+			}
+			catch (...) {}
+		}
+	}
+
+	EXPORT_DLL int getSysexProgress(unsigned int id, int &sent, int &total) {
+		size_t s = 0, t = 0;
+		int ret = MIDI_SYSEX_UNKNOWN;
+		if (defaultOutput.midiout != NULL) {
+			ret = defaultOutput.midiout->getSysexStatus(id, &s, &t);
+		}
+		sent = (int)s;
+		total = (int)t;
+		return ret;
+	}
+
+	EXPORT_DLL void cancelSysex(unsigned int id) {
+		if (defaultOutput.midiout != NULL) {
+			defaultOutput.midiout->cancelSysex(id);
+		}
+	}
+
+	EXPORT_DLL void setSysexProgressCallback(SysexProgressCallback callback) {
+		sysexProgressCallback.store(callback);
+	}
+
+	EXPORT_DLL int loadMidiFile(const char* path) {
+		int ret = 0;
+		if (path != NULL) {
+			try {
+				ret = defaultOutput.player.open(path) ? 1 : 0;
+			}
+			catch (...) { ret = 0; }
+		}
+		return ret;
+	}
+
+	EXPORT_DLL int playMidiFile() {
+		int ret = 0;
+		if (defaultOutput.midiout != NULL && defaultOutput.midiout->isPortOpen()) {
+			try {
+				ret = defaultOutput.player.play(defaultOutput.midiout, 0.0, &defaultOutput.sendMutex) ? 1 : 0;
+			}
+			catch (...) { ret = 0; }
+		}
+		return ret;
+	}
+
+	EXPORT_DLL int seekMidiFile(double seconds) {
+		int ret = 0;
+		if (defaultOutput.midiout != NULL && defaultOutput.midiout->isPortOpen()) {
+			try {
+				ret = defaultOutput.player.play(defaultOutput.midiout, seconds, &defaultOutput.sendMutex) ? 1 : 0;
+			}
+			catch (...) { ret = 0; }
+		}
+		return ret;
+	}
+
+	EXPORT_DLL void stopMidiFile() {
+		defaultOutput.player.stop();
+	}
+
+	EXPORT_DLL int isMidiFilePlaying() {
+		return defaultOutput.player.isPlaying() ? 1 : 0;
+	}
+
+	EXPORT_DLL double getMidiFilePosition() {
+		return defaultOutput.player.position();
+	}
+
+	EXPORT_DLL int startLoopRecording() {
+		if (defaultOutput.midiout == NULL || !defaultOutput.midiout->isPortOpen()) {
+			return 0;
+		}
+		looper.record(defaultOutput.midiout, &defaultOutput.sendMutex);
+		return 1;
+	}
+
+	EXPORT_DLL int playLoop() {
+		if (defaultOutput.midiout == NULL || !defaultOutput.midiout->isPortOpen()) {
+			return 0;
+		}
+		return looper.play(defaultOutput.midiout, &defaultOutput.sendMutex) ? 1 : 0;
+	}
+
+	EXPORT_DLL void setLoopOverdub(int enabled) {
+		looper.overdub(enabled != 0);
+	}
+
+	EXPORT_DLL void stopLoop() {
+		looper.stop();
+	}
+
+	EXPORT_DLL void clearLoop() {
+		looper.clear();
+	}
+
+	EXPORT_DLL int getLoopStatus(double &length, double &position, int &events, unsigned long long &dropped) {
+		length = looper.length();
+		position = looper.position(steadySeconds());
+		events = (int)looper.events();
+		dropped = looper.dropped();
+		return looper.state();
+	}
+
+	EXPORT_DLL int convertMidiFile(const char* smfPath, const char* flatPath) {
+		int ret = 0;
+		if (smfPath != NULL && flatPath != NULL) {
+			try {
+				ret = MidiPlayer::convert(smfPath, flatPath) ? 1 : 0;
+			}
+			catch (...) { ret = 0; }
+		}
+		return ret;
+	}
+
+	EXPORT_DLL int isFlatMidiFileCurrent(const char* flatPath, const char* smfPath) {
+		if (flatPath == NULL || smfPath == NULL) {
+			return 0;
+		}
+		return MidiPlayer::isCurrent(flatPath, smfPath) ? 1 : 0;
 	}
 }
 
 
 RtMidi* getMidiIn() {
-	return midiin;
+	return defaultInput.midiin;
 }
 RtMidi* getMidiOut() {
-	return midiout;
+	return defaultOutput.midiout;
 }
\ No newline at end of file
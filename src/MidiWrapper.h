@@ -40,7 +40,16 @@
 #define MIDIWRAPPER_H
 
 #ifndef EXPORT_DLL
-	#define EXPORT_DLL __declspec(dllexport) 
+	#if defined(_WIN32)
+		#define EXPORT_DLL __declspec(dllexport)
+	#else
+		#define EXPORT_DLL __attribute__((visibility("default")))
+	#endif
+#endif
+
+//calling convention of the callbacks, only meaningful on 32 bits Windows
+#if !defined(_WIN32) && !defined(__cdecl)
+	#define __cdecl
 #endif
 
 
@@ -68,10 +77,199 @@ extern "C" {
 		double timestamp = 0.0;
 	} MidiNoteMessage;
 
+	//A note from its note on to its note off, see getCompletedNotes. Times are input times:
+	//seconds since the input port was opened (sum of the backend delta times)
+	typedef struct {
+		unsigned char channel = 0; //0 to 15
+		unsigned char note = 0;
+		unsigned char velocity = 0;
+		unsigned char releaseVelocity = 0; //of the note off, 0 for a note on of velocity 0 or a note retriggered before its note off
+		double start = 0.0;
+		double duration = 0.0;
+	} MidiCompletedNote;
+
+	//A note on still waiting for its note off, see getOpenNotes
+	typedef struct {
+		unsigned char channel = 0;
+		unsigned char note = 0;
+		unsigned char velocity = 0;
+		double start = 0.0;
+	} MidiOpenNote;
+
+	//Port description filled by enumerateInputPorts / enumerateOutputPorts
+	typedef struct {
+		unsigned int id = 0; //port number to pass to openInputPort / openOutputPort
+		char name[256]; //zero terminated, truncated if longer
+	} PortInfo;
+
+	//Device (port) hot-plug notification, see RtMidiPortEvent
+	typedef struct {
+		int added = 0; //1 if the port appeared, 0 if it disappeared
+		int isInput = 0; //the port is a source that can be opened with openInputPort
+		int isOutput = 0; //the port is a destination that can be opened with openOutputPort
+		char name[256]; //zero terminated, same name getInputPortName / getOutputPortName give
+	} DeviceEvent;
+
+	//called from the backend notification thread, must return quickly
+	typedef void(__cdecl *DeviceEventCallback)(const DeviceEvent *event);
+
+	//flags of the sysex chunks, see RtMidiIn::SysexFlags
+	#define MIDI_SYSEX_START 0x01 //first chunk of a message (starts with 0xF0)
+	#define MIDI_SYSEX_CONTINUE 0x02 //any chunk after the first one
+	#define MIDI_SYSEX_END 0x04 //last chunk of a message (ends with 0xF7), may be combined with MIDI_SYSEX_START
+
+	//called from the input thread with each sysex chunk as it arrives, data is only valid during the call
+	typedef void(__cdecl *SysexChunkCallback)(const unsigned char *data, int size, int flags, double timestamp);
+
+	//states of the asynchronous sysex messages, see RtMidiOut::SysexStatus
+	#define MIDI_SYSEX_QUEUED 0
+	#define MIDI_SYSEX_SENDING 1
+	#define MIDI_SYSEX_DONE 2
+	#define MIDI_SYSEX_CANCELLED 3
+	#define MIDI_SYSEX_FAILED 4
+	#define MIDI_SYSEX_UNKNOWN 5
+
+	//called from the sending thread after each chunk and when a message is finished, must return quickly
+	typedef void(__cdecl *SysexProgressCallback)(unsigned int id, int sent, int total, int status);
+
+	//MIDI APIs (backends) for createInputEx / createOutputEx, see RtMidi::Api
+	#define MIDI_API_DEFAULT 0 //first compiled API with ports
+	#define MIDI_API_COREMIDI 1
+	#define MIDI_API_ALSA 2 //ALSA sequencer
+	#define MIDI_API_JACK 3
+	#define MIDI_API_WINMM 4
+	#define MIDI_API_ALSA_RAW 6 //ALSA rawmidi, hardware ports only
+	#define MIDI_API_LOOPBACK 7 //in-process, outputs feed inputs
+
+	//Counters of the low-latency (spin-then-sleep) input polling mode, see RtMidiIn::PollingStats
+	typedef struct {
+		unsigned long long spinHits = 0;
+		unsigned long long spinMisses = 0;
+		unsigned long long pollWakeups = 0;
+		unsigned long long spinNanoseconds = 0; //CPU cost
+		double avgSpinLatencyMicros = 0.0; //average pickup latency of the events caught while spinning
+		double avgPollLatencyMicros = 0.0; //average pickup latency of the events that needed a poll() wakeup
+		unsigned int maxSpinMicroseconds = 0;
+		unsigned int currentSpinMicroseconds = 0;
+	} MidiPollingStats;
+
+	//message types of the input filter, see MidiInputFilter::Type
+	#define MIDI_FILTER_NOTE_OFF 0x0001
+	#define MIDI_FILTER_NOTE_ON 0x0002
+	#define MIDI_FILTER_POLY_AFTERTOUCH 0x0004
+	#define MIDI_FILTER_CONTROL_CHANGE 0x0008
+	#define MIDI_FILTER_PROGRAM_CHANGE 0x0010
+	#define MIDI_FILTER_CHANNEL_AFTERTOUCH 0x0020
+	#define MIDI_FILTER_PITCH_BEND 0x0040
+	#define MIDI_FILTER_SYSEX 0x0080
+	#define MIDI_FILTER_SYSTEM_COMMON 0x0100 //0xF1 to 0xF6
+	#define MIDI_FILTER_CLOCK 0x0200 //clock, start, continue and stop
+	#define MIDI_FILTER_ACTIVE_SENSING 0x0400
+	#define MIDI_FILTER_SYSTEM_RESET 0x0800
+	#define MIDI_FILTER_ALL 0x0FFF
+
+	//input filter settings, the defaults let everything through
+	typedef struct {
+		int types = MIDI_FILTER_ALL; //combination of MIDI_FILTER_...
+		unsigned int channels = 0xFFFF; //bit n for channel n+1
+		unsigned char noteLow = 0; //note range (inclusive) of note on/off and poly aftertouch
+		unsigned char noteHigh = 127;
+		unsigned char controllers[16] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+			0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }; //controllers let through, bit (n % 8) of byte n / 8 for controller n
+	} MidiFilter;
+
+	//transforms of a route, see MidiRouter::TransformType
+	#define MIDI_ROUTE_MAX_TRANSFORMS 8
+	#define MIDI_TRANSFORM_TRANSPOSE 1 //amount: semitones, notes moved out of 0-127 are dropped
+	#define MIDI_TRANSFORM_CHANNEL 2 //table[n]: new channel (0-15) of the channel n+1 messages, above 15 drops them
+	#define MIDI_TRANSFORM_VELOCITY 3 //table[v]: new velocity of the note ons of velocity v (0 is taken as 1)
+
+	typedef struct {
+		int type = 0; //MIDI_TRANSFORM_...
+		int amount = 0;
+		unsigned char table[128] = {};
+	} MidiTransform;
+
+	//a route of the input to a route output, see setRoutes. Channel messages go through the transforms in order
+	typedef struct {
+		int output = 0; //id given by openRouteOutput
+		MidiFilter filter; //messages taken by the route
+		int transformCount = 0;
+		MidiTransform transforms[MIDI_ROUTE_MAX_TRANSFORMS];
+	} MidiRoute;
+
+	//chord qualities, see MidiChordTracker::Quality
+	#define MIDI_CHORD_NONE 0
+	#define MIDI_CHORD_MAJOR 1
+	#define MIDI_CHORD_MINOR 2
+	#define MIDI_CHORD_DIMINISHED 3
+	#define MIDI_CHORD_AUGMENTED 4
+	#define MIDI_CHORD_SUS2 5
+	#define MIDI_CHORD_SUS4 6
+	#define MIDI_CHORD_POWER 7
+	#define MIDI_CHORD_DOMINANT7 8
+	#define MIDI_CHORD_MAJOR7 9
+	#define MIDI_CHORD_MINOR7 10
+	#define MIDI_CHORD_HALF_DIMINISHED7 11
+	#define MIDI_CHORD_DIMINISHED7 12
+	#define MIDI_CHORD_MINOR_MAJOR7 13
+	#define MIDI_CHORD_AUGMENTED7 14
+	#define MIDI_CHORD_DOMINANT7_SUS4 15
+	#define MIDI_CHORD_MAJOR6 16
+	#define MIDI_CHORD_MINOR6 17
+	#define MIDI_CHORD_ADD9 18
+	#define MIDI_CHORD_DOMINANT9 19
+	#define MIDI_CHORD_MAJOR9 20
+	#define MIDI_CHORD_MINOR9 21
+
+	//chord of the held notes, see getCurrentChord
+	typedef struct {
+		int quality = MIDI_CHORD_NONE; //MIDI_CHORD_...
+		int root = -1; //pitch class, 0 for C to 11 for B, -1 without a chord
+		int inversion = 0; //0 root position, 1 third in the bass, 2 fifth in the bass...
+		int bass = -1; //pitch class of the lowest held note, -1 without notes
+		unsigned int pitchClasses = 0; //bit n set while a note of pitch class n is held
+	} MidiChord;
+
+	//upper bounds (exclusive, microseconds) of the input callback duration histogram buckets, the last one has none
+	#define MIDI_STATS_HISTOGRAM_SIZE 8
+	#define MIDI_STATS_HISTOGRAM_BOUNDS { 1, 4, 16, 64, 256, 1024, 4096 }
+
+	//Counters of the messages going through the wrapper, per stage, see getStats
+	typedef struct {
+		//backend stage (RtMidi input thread)
+		unsigned long long received = 0; //messages delivered by the backend
+		unsigned long long backendDropped = 0; //lost because the backend queue was full
+		unsigned long long backendOverruns = 0; //backend buffer overruns (ALSA -ENOSPC, full loopback queue), each one loses an unknown number of events
+		unsigned int backendQueueHighWater = 0;
+		//wrapper stage (input callback)
+		unsigned long long filtered = 0; //dropped by the input filter
+		unsigned long long notesQueued = 0; //note on / off messages pushed for getNextMessageStruct and the like
+		unsigned long long notesDropped = 0; //refused because the notes queue was full
+		unsigned int notesQueueHighWater = 0;
+		unsigned long long completedNotesDropped = 0; //refused because the completed notes queue was full
+		unsigned long long messagesDropped = 0; //oldest messages discarded by the full messages buffer
+		unsigned int messagesQueueHighWater = 0;
+		unsigned long long callbackHistogram[MIDI_STATS_HISTOGRAM_SIZE] = {}; //input callback calls per duration bucket
+		unsigned long long callbackMaxNanoseconds = 0;
+		unsigned long long routed = 0; //messages sent by the routes (of the default input, 0 for the other instances)
+		unsigned long long routeErrors = 0; //route sends that threw
+		//output (sendLimitedMessage, noteOn, noteOff)
+		unsigned long long sent = 0;
+		unsigned long long sendErrors = 0; //send calls that threw
+		double avgSendMicros = 0.0;
+		unsigned long long sendMaxNanoseconds = 0;
+	} MidiStats;
+
+	//opaque input and output instances, each one with its own device, queues, note state and counters (see createInputHandle)
+	typedef struct MidiInHandle MidiInHandle;
+	typedef struct MidiOutHandle MidiOutHandle;
+
 	///////////////////////////////////////////////////////////////////////////////////////////////////////
 	/// MIDI Initialization & status
 	/**
 	 * Setup the environment needed for the system to work (helpers and other variables)
+	 * nothing is needed anymore, the input instances are ready when created; kept for the existing callers
 	 */
 	EXPORT_DLL void setupEnv();
 
@@ -82,14 +280,35 @@ extern "C" {
 	 * returns 0 if failed, 1 otherwise
 	 */
 	EXPORT_DLL int createInput();
+
+	/**
+	* same as createInput, with the given API (MIDI_API_...), client name (NULL for the default one)
+	* and size of the RtMidi input queue in messages (0 for the default, 100)
+	* returns 0 if failed (e.g. the API is not compiled), 1 otherwise
+	*/
+	EXPORT_DLL int createInputEx(int api, const char* clientName, unsigned int queueSize);
+
+	/**
+	* fills up to max entries of the given array with the compiled APIs (MIDI_API_...), in the default search order
+	* returns the number of compiled APIs
+	*/
+	EXPORT_DLL int getCompiledApis(int* apis, int max);
+
+	/**
+	* returns the API (MIDI_API_...) of the input object, MIDI_API_DEFAULT if there is none
+	*/
+	EXPORT_DLL int getInputApi();
 	
 	/**
 	 * Cleans all the temporary buffers and variables taht keep the current input status (queue and so on)
+	 * safe while the input is running: the notes queue is emptied at once, the buffers and status written
+	 * by the input thread are reset by it before it handles its next message
 	 */
 	EXPORT_DLL void cleanupInputEnv();
 	
 	/**
 	  * destroys the input object (if exists)
+	  * waits for the input callback in flight (if any) to return, so it is safe while messages are arriving
 	  */
 	EXPORT_DLL int destroyInput();
 	
@@ -125,12 +344,29 @@ extern "C" {
 	*/
 	EXPORT_DLL char * getInputPortNamePtr(unsigned int port = 0);
 
+	/**
+	* fills up to max entries of the given array with the ids and names of all the input ports in one call
+	* returns the total number of input ports (may be bigger than max), 0 if there is no input object
+	*/
+	EXPORT_DLL int enumerateInputPorts(PortInfo* out, int max);
+
 	/**
 	 * sets up an output object.
 	 * If exists then disconnects and deletes creating a new connection
 	 * returns 0 if failed, 1 otherwise
 	 */
 	EXPORT_DLL int createOutput();
+
+	/**
+	* same as createOutput, with the given API (MIDI_API_...) and client name (NULL for the default one)
+	* returns 0 if failed (e.g. the API is not compiled), 1 otherwise
+	*/
+	EXPORT_DLL int createOutputEx(int api, const char* clientName);
+
+	/**
+	* returns the API (MIDI_API_...) of the output object, MIDI_API_DEFAULT if there is none
+	*/
+	EXPORT_DLL int getOutputApi();
 	/**
 	 * destroys the input object (if exists)
 	 */
@@ -166,6 +402,137 @@ extern "C" {
 	*/
 	EXPORT_DLL char * getOutputPortNamePtr(unsigned int port = 0);
 
+	/**
+	* fills up to max entries of the given array with the ids and names of all the output ports in one call
+	* returns the total number of output ports (may be bigger than max), 0 if there is no output object
+	*/
+	EXPORT_DLL int enumerateOutputPorts(PortInfo* out, int max);
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////
+	//MIDI instances (handles)
+	//the functions above and below without a handle work on the default instances, see getDefaultInputHandle
+	//every instance has its own input thread and queues, so they can be used concurrently from different threads
+	//one handle must not be used from several threads at once, as with the default instances
+	/**
+	* creates an input instance with the given API (MIDI_API_...), client name (NULL for the default one)
+	* and size of the RtMidi input queue in messages (0 for the default, 100), ready to be used (no setupEnv needed)
+	* returns NULL if failed (e.g. the API is not compiled)
+	*/
+	EXPORT_DLL MidiInHandle* createInputHandle(int api, const char* clientName, unsigned int queueSize);
+
+	/**
+	* closes and destroys the given input instance, the handle is not valid afterwards
+	* waits for its callback in flight (if any) as destroyInput; must not be called from a wrapper callback
+	* for the default instance only its input object is destroyed (as destroyInput)
+	* returns 0 if failed, 1 otherwise
+	*/
+	EXPORT_DLL int destroyInputHandle(MidiInHandle* handle);
+
+	/**
+	* returns the instance the handle-less input functions work on, always valid
+	*/
+	EXPORT_DLL MidiInHandle* getDefaultInputHandle();
+
+	/**
+	* same as openInputPort, closeInputPort, isInputPortOpen and enumerateInputPorts for the given instance
+	*/
+	EXPORT_DLL int openInputHandlePort(MidiInHandle* handle, int port);
+	EXPORT_DLL void closeInputHandlePort(MidiInHandle* handle);
+	EXPORT_DLL int isInputHandlePortOpen(MidiInHandle* handle);
+	EXPORT_DLL int enumerateInputHandlePorts(MidiInHandle* handle, PortInfo* out, int max);
+
+	/**
+	* same as cleanupInputEnv for the given instance
+	*/
+	EXPORT_DLL void cleanupInputHandle(MidiInHandle* handle);
+
+	/**
+	* moves the next queued note on / note off message of the given instance to message (see getNextMessageStruct)
+	* returns 1 if there was one, 0 if the queue was empty (message is left untouched)
+	*/
+	EXPORT_DLL int getInputHandleMessage(MidiInHandle* handle, MidiNoteMessage &message);
+
+	/**
+	* same as getCompletedNotes, getOpenNotes, getCurrentChord and setInputFilter for the given instance
+	*/
+	EXPORT_DLL int getInputHandleCompletedNotes(MidiInHandle* handle, MidiCompletedNote* notes, int max);
+	EXPORT_DLL int getInputHandleOpenNotes(MidiInHandle* handle, MidiOpenNote* notes, int max, double &time);
+	EXPORT_DLL int getInputHandleChord(MidiInHandle* handle, MidiChord* chord);
+	EXPORT_DLL void setInputHandleFilter(MidiInHandle* handle, const MidiFilter* filter);
+
+	/**
+	* fills the input counters of stats (up to routeErrors) with the ones of the given instance, the others are zeroed
+	* returns 0 if handle or stats is NULL, 1 otherwise
+	*/
+	EXPORT_DLL int getInputHandleStats(MidiInHandle* handle, MidiStats* stats);
+	EXPORT_DLL void resetInputHandleStats(MidiInHandle* handle);
+
+	/**
+	* creates an output instance with the given API (MIDI_API_...) and client name (NULL for the default one)
+	* returns NULL if failed (e.g. the API is not compiled)
+	*/
+	EXPORT_DLL MidiOutHandle* createOutputHandle(int api, const char* clientName);
+
+	/**
+	* closes and destroys the given output instance, the handle is not valid afterwards
+	* for the default instance only its output object is destroyed (as destroyOutput)
+	* returns 0 if failed, 1 otherwise
+	*/
+	EXPORT_DLL int destroyOutputHandle(MidiOutHandle* handle);
+
+	/**
+	* returns the instance the handle-less output functions work on, always valid
+	*/
+	EXPORT_DLL MidiOutHandle* getDefaultOutputHandle();
+
+	/**
+	* same as openOutputPort, closeOutputPort, isOutputPortOpen and enumerateOutputPorts for the given instance
+	*/
+	EXPORT_DLL int openOutputHandlePort(MidiOutHandle* handle, int port);
+	EXPORT_DLL void closeOutputHandlePort(MidiOutHandle* handle);
+	EXPORT_DLL int isOutputHandlePortOpen(MidiOutHandle* handle);
+	EXPORT_DLL int enumerateOutputHandlePorts(MidiOutHandle* handle, PortInfo* out, int max);
+
+	/**
+	* sends the given complete MIDI message (size bytes) through the given instance
+	* returns 0 if failed (no output object, nothing to send or the backend refused it), 1 otherwise
+	*/
+	EXPORT_DLL int sendOutputHandleMessage(MidiOutHandle* handle, const unsigned char* message, int size);
+
+	/**
+	* fills the output counters of stats (from sent) with the ones of the given instance, the others are zeroed
+	* returns 0 if handle or stats is NULL, 1 otherwise
+	*/
+	EXPORT_DLL int getOutputHandleStats(MidiOutHandle* handle, MidiStats* stats);
+	EXPORT_DLL void resetOutputHandleStats(MidiOutHandle* handle);
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////
+	//Device notifications
+	/**
+	* starts listening for devices being plugged or unplugged (Linux ALSA and JACK only)
+	* uses the input object if exists, else the output object; notifications stop when it is destroyed
+	* the events are queued (see getNextDeviceEvent) and passed to the device callback if set
+	* returns 0 if failed, 1 otherwise
+	**/
+	EXPORT_DLL int enableDeviceNotifications();
+
+	/**
+	* stops listening for devices being plugged or unplugged
+	**/
+	EXPORT_DLL void disableDeviceNotifications();
+
+	/**
+	* fills the given event with the next device event in the queue
+	* this is a destructive read (the event read will be popped from the queue)
+	* returns 0 if the queue was empty, 1 otherwise
+	**/
+	EXPORT_DLL int getNextDeviceEvent(DeviceEvent &event);
+
+	/**
+	* sets the function to call (from the notification thread) on each device event, NULL to remove it
+	**/
+	EXPORT_DLL void setDeviceEventCallback(DeviceEventCallback callback);
+
 	///////////////////////////////////////////////////////////////////////////////////////////////////////
 	//MIDI Input
 	/**
@@ -173,6 +540,7 @@ extern "C" {
 	* if the input queue is not empty will return the next one
 	if input queue is EMPTY will return a zero filled message (id, code and velocity are 0)
 	* this is a destructive read (the message read will be popped from the queue)
+	* the queue holds up to 4096 notes, the newer ones are dropped while it is full
 	**/
 	EXPORT_DLL MidiNoteMessage __cdecl getNextMessageStruct();
 
@@ -184,7 +552,201 @@ extern "C" {
 	EXPORT_DLL void __cdecl fillWithNextNoteMessage(MidiNoteMessage &message);
 
 	EXPORT_DLL long getNextMessageAsLong();
+
+	/**
+	* moves up to max completed notes (note on paired with its note off, any channel) to the given array, oldest first
+	* the queue holds up to 4096 notes, the newer ones are dropped while it is full (see MidiStats::completedNotesDropped)
+	* returns the number of notes copied
+	**/
+	EXPORT_DLL int getCompletedNotes(MidiCompletedNote* notes, int max);
+
+	/**
+	* snapshot of the notes still open (note on received, note off not yet): copies up to max of them,
+	* all taken at the same point in time, and fills time with the input time of that point
+	* returns the number of open notes, that can be more than max
+	**/
+	EXPORT_DLL int getOpenNotes(MidiOpenNote* notes, int max, double &time);
 	EXPORT_DLL unsigned int getNextMessageAsUInt();
+
+	/**
+	* enables the low-latency input polling mode: the input thread spins up to
+	* maxSpinMicroseconds waiting for events before going to sleep (Linux ALSA only)
+	* 0 disables it (default). Resets the polling stats.
+	* returns 0 if failed (no input or not supported by the backend), 1 otherwise
+	**/
+	EXPORT_DLL int setInputSpinPolling(unsigned int maxSpinMicroseconds);
+
+	/**
+	* fills the given stats with the counters of the low-latency polling mode
+	* the latency gained is avgPollLatencyMicros - avgSpinLatencyMicros, the cost is spinNanoseconds
+	* returns 0 if not available, 1 otherwise
+	**/
+	EXPORT_DLL int getInputPollingStats(MidiPollingStats &stats);
+
+	/**
+	* streams the incoming sysex messages to the given function chunk by chunk instead of
+	* reassembling them, so big dumps need no buffering (Linux ALSA only)
+	* streamed sysex messages are not passed to the input queue, NULL goes back to the default
+	* returns 0 if failed (no input or not supported by the backend), 1 otherwise
+	**/
+	EXPORT_DLL int setInputSysexCallback(SysexChunkCallback callback);
+
+	/**
+	* fills the given stats with the counters of the input and output, can be called from any thread at any time
+	* the backend stage counters are only available while an input exists
+	* returns 0 if stats is NULL, 1 otherwise
+	**/
+	EXPORT_DLL int getStats(MidiStats* stats);
+
+	/**
+	* sets all the counters back to zero
+	**/
+	EXPORT_DLL void resetStats();
+
+	/**
+	* sets the filter the input messages go through before anything else (queues, clock tracking ...)
+	* it is compiled into lookup tables, so dropping a message costs one or two lookups
+	* sysex, clock and active sensing are also dropped by the backend unless enabled (see enableClockTracking)
+	* can be called at any time from any thread, NULL lets everything through
+	**/
+	EXPORT_DLL void setInputFilter(const MidiFilter* filter);
+
+	/**
+	* starts (1) or stops (0) following the incoming MIDI clock (24 ticks per beat), start, continue,
+	* stop and song position messages. They are consumed on the input thread and never queued.
+	* call it after opening the input, resets the tempo and position
+	* returns 0 if there is no input, 1 otherwise
+	**/
+	/**
+	* opens an extra output port of the given API (MIDI_API_...) for the routes, see setRoutes
+	* route outputs are only used by the input thread, never by the functions sending to the output port
+	* returns its id, or -1 if failed
+	**/
+	EXPORT_DLL int openRouteOutput(int api, int port);
+
+	/**
+	* replaces the routes (count 0 removes them): each input message its filter lets through is
+	* transformed and sent to its route output, right from the input thread, without allocating
+	* the change is lock-free for the input thread, the call returns once the old routes are no longer used
+	* returns 0 if failed (unknown output, too many transforms), 1 otherwise
+	**/
+	EXPORT_DLL int setRoutes(const MidiRoute* routes, int count);
+
+	/**
+	* removes the routes and closes the route outputs
+	**/
+	EXPORT_DLL void closeRouteOutputs();
+
+	/**
+	* fills the chord of the notes held on any channel, as recognized by the input
+	* thread when they last changed: reading it costs nothing whatever the number of calls
+	* returns 1 if it changed since the previous call, 0 otherwise (or if chord is NULL)
+	**/
+	EXPORT_DLL int getCurrentChord(MidiChord* chord);
+
+	EXPORT_DLL int enableClockTracking(int enabled);
+
+	/**
+	* tempo of the incoming clock in beats per minute, filtered against the transport jitter
+	* 0 until two ticks were received or if no tick came for a second
+	**/
+	EXPORT_DLL double getClockBpm();
+
+	/**
+	* song position in beats (quarter notes) since the last start or song position message,
+	* extrapolated from the last tick at the current tempo
+	**/
+	EXPORT_DLL double getClockBeats();
+
+	/**
+	* position inside the current beat [0,1), the fractional part of getClockBeats
+	**/
+	EXPORT_DLL double getClockBeatPhase();
+
+	/**
+	* transport state: 1 playing (after start or continue), 0 stopped
+	**/
+	EXPORT_DLL int getClockTransport();
+
+	/**
+	* starts recording the input messages (after the input filter, without realtime ones) to the given
+	* standard MIDI file, format 0 (one track) or 1 (conductor and performance tracks)
+	* the file starts with the first message received, the input thread does no I/O nor allocation
+	* returns 0 if failed (already recording, wrong format or the file cannot be created), 1 otherwise
+	**/
+	EXPORT_DLL int startRecording(const char* path, int format);
+
+	/**
+	* finishes the recording and closes the file
+	* returns 0 if there was no recording or the file could not be written, 1 otherwise
+	**/
+	EXPORT_DLL int stopRecording();
+
+	/**
+	* fills the messages written and the ones lost (recording buffer full) by the current or last recording
+	* returns 1 while recording, 0 otherwise
+	**/
+	EXPORT_DLL int getRecordingStatus(unsigned long long &events, unsigned long long &dropped);
+
+	/**
+	* starts capturing all the input messages (after the input filter) to a compact log, meant for
+	* sessions of days: varint delta times, running status and compressed segments, written from
+	* a background thread. Read it back with openCaptureLog
+	* returns 0 if failed (already capturing or the file cannot be created), 1 otherwise
+	**/
+	EXPORT_DLL int startCapture(const char* path);
+
+	/**
+	* writes what is left and the time index, closes the log
+	* returns 0 if there was no capture or the file could not be written, 1 otherwise
+	**/
+	EXPORT_DLL int stopCapture();
+
+	/**
+	* fills the messages written, the ones lost (capture buffer full) and the size of the log so far
+	* for the current or last capture
+	* returns 1 while capturing, 0 otherwise
+	**/
+	EXPORT_DLL int getCaptureStatus(unsigned long long &events, unsigned long long &dropped, unsigned long long &bytes);
+
+	/**
+	* opens a capture log for reading, also one cut short by a crash (up to its last complete segment)
+	* returns 0 if it cannot be read or is not a capture log, 1 otherwise
+	**/
+	EXPORT_DLL int openCaptureLog(const char* path);
+
+	/**
+	* moves the reading to the first message at or after the given time (seconds from the first message)
+	**/
+	EXPORT_DLL void seekCaptureLog(double seconds);
+
+	/**
+	* reads the next message of the open capture log into message (size bytes available) and its time
+	* in seconds from the first message of the log
+	* returns the size of the message, 0 at the end of the log, or minus its size if it did not fit (it is skipped)
+	**/
+	EXPORT_DLL int readCaptureLog(double &time, unsigned char *message, int size);
+
+	EXPORT_DLL void closeCaptureLog();
+
+	/**
+	* starts (1) or stops (0) recording the trace points of the input path: backend read, decoding,
+	* input callback, notes queue push and pop. Each thread records its last 16384 events.
+	* The first start allocates the rings of 16 threads (4 MB), reused as threads exit.
+	**/
+	EXPORT_DLL void enableTrace(int enabled);
+
+	/**
+	* forgets the trace events recorded so far
+	**/
+	EXPORT_DLL void clearTrace();
+
+	/**
+	* writes the trace events recorded so far to the given file as Chrome trace JSON
+	* (open it in chrome://tracing or ui.perfetto.dev), better done with the tracing stopped
+	* returns the number of events written, -1 if the file could not be written
+	**/
+	EXPORT_DLL int dumpTrace(const char* path);
 	///////////////////////////////////////////////////////////////////////////////////////////////////////
 	// MIDI Output
 	/**
@@ -209,6 +771,124 @@ extern "C" {
 	* channel default 0
 	**/
 	EXPORT_DLL void noteOff(unsigned char  id, int channel = 0);
+
+	/**
+	* queues a complete sysex message (0xF0 ... 0xF7) to be sent in the background without blocking (Linux ALSA only)
+	* the data is copied, progress is reported to the sysex progress callback and by getSysexProgress
+	* meanwhile the other messages sent to the output (but realtime ones) wait for the end of the sysex message
+	* returns the id of the message, 0 if failed
+	**/
+	EXPORT_DLL unsigned int sendSysexAsync(const unsigned char *data, int size);
+
+	/**
+	* sets the size of the chunks the sysex messages are split in and the minimum delay between two chunks
+	* defaults to 256 bytes and no delay; a 31250 baud MIDI cable takes 320 microseconds per byte
+	**/
+	EXPORT_DLL void setSysexPacing(unsigned int chunkSize, unsigned int intervalMicroseconds);
+
+	/**
+	* fills sent and total (in bytes) for the given message
+	* returns its status (MIDI_SYSEX_...), MIDI_SYSEX_UNKNOWN if not found (only the last 16 finished ones are kept)
+	**/
+	EXPORT_DLL int getSysexProgress(unsigned int id, int &sent, int &total);
+
+	/**
+	* cancels the given sysex message, all of them if id is 0
+	**/
+	EXPORT_DLL void cancelSysex(unsigned int id = 0);
+
+	/**
+	* sets the function to call (from the sending thread) on sysex progress, NULL to remove it
+	**/
+	EXPORT_DLL void setSysexProgressCallback(SysexProgressCallback callback);
+
+	/**
+	* opens the given standard MIDI file or flat file (see convertMidiFile) for playback
+	* memory mapped, the tracks of a standard MIDI file are decoded while playing
+	* returns 0 if it cannot be read or is not a MIDI file, 1 otherwise
+	**/
+	EXPORT_DLL int loadMidiFile(const char* path);
+
+	/**
+	* plays the loaded file from the start to the output, from a timing thread
+	* its sends are serialized with the other sends to the output (notes, messages, the looper)
+	* returns 0 if failed (no file loaded or no output port open), 1 otherwise
+	**/
+	EXPORT_DLL int playMidiFile();
+
+	/**
+	* plays the loaded file from the given time in seconds, whether it is playing or not
+	* the program, controller, pitch bend and pressure state the song has at that time is sent first
+	* returns 0 if failed (no file loaded or no output port open), 1 otherwise
+	**/
+	EXPORT_DLL int seekMidiFile(double seconds);
+
+	/**
+	* stops the playback, sending all notes off
+	**/
+	EXPORT_DLL void stopMidiFile();
+
+	EXPORT_DLL int isMidiFilePlaying();
+
+	/**
+	* time of the last event played, in seconds from the start of the file
+	**/
+	EXPORT_DLL double getMidiFilePosition();
+
+	//looper states, see getLoopStatus
+	#define MIDI_LOOP_IDLE 0
+	#define MIDI_LOOP_RECORDING 1
+	#define MIDI_LOOP_PLAYING 2
+	#define MIDI_LOOP_OVERDUBBING 3
+
+	/**
+	* drops the current loop and starts recording the input channel messages as a new one
+	* the loop plays to the output port, serialized with the other sends to it
+	* returns 0 if failed (no output port open), 1 otherwise
+	**/
+	EXPORT_DLL int startLoopRecording();
+
+	/**
+	* ends the first pass (its duration becomes the loop length) and loops it, or plays the stopped loop again
+	* returns 0 if there is nothing to play or no output port open, 1 otherwise
+	**/
+	EXPORT_DLL int playLoop();
+
+	/**
+	* records the input on top of the playing loop while enabled
+	**/
+	EXPORT_DLL void setLoopOverdub(int enabled);
+
+	/**
+	* stops the loop playback, sending note offs for the notes it left held, the loop is kept
+	**/
+	EXPORT_DLL void stopLoop();
+
+	/**
+	* stops and drops the loop
+	**/
+	EXPORT_DLL void clearLoop();
+
+	/**
+	* fills the loop length (0 during the first pass) and the position in the current pass (seconds),
+	* the events in the loop and the ones lost (loop full)
+	* returns the looper state, MIDI_LOOP_...
+	**/
+	EXPORT_DLL int getLoopStatus(double &length, double &position, int &events, unsigned long long &dropped);
+
+	/**
+	* converts a standard MIDI file into the flat playback format: timestamps in nanoseconds, tempo
+	* map applied, running status and sysex lengths resolved, so playback only copies bytes, and an index
+	* with the channel state every 256 events, so a seek only chases the events of one block
+	* the flat file records the size and modification time of the source, see isFlatMidiFileCurrent
+	* returns 0 if failed, 1 otherwise
+	**/
+	EXPORT_DLL int convertMidiFile(const char* smfPath, const char* flatPath);
+
+	/**
+	* returns 1 if the flat file was converted from the current version of the standard MIDI file, 0 otherwise (convert it again)
+	**/
+	EXPORT_DLL int isFlatMidiFileCurrent(const char* flatPath, const char* smfPath);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -37,7 +37,9 @@
 /**********************************************************************/
 
 #include "RtMidi.h"
+#include "MidiTrace.h"
 #include <sstream>
+#include <thread>
 
 //*********************************************************************//
 //  RtMidi Definitions
@@ -60,6 +62,21 @@ std::string RtMidi :: getVersion( void ) throw()
   return std::string( RTMIDI_VERSION );
 }
 
+void RtMidi :: getPortNames( std::vector<std::string> &names )
+{
+  rtapi_->getPortNames( names );
+}
+
+void RtMidi :: setPortCallback( RtMidiPortCallback callback, void *userData )
+{
+  rtapi_->setPortCallback( callback, userData );
+}
+
+void RtMidi :: cancelPortCallback( void )
+{
+  rtapi_->cancelPortCallback();
+}
+
 void RtMidi :: getCompiledApi( std::vector<RtMidi::Api> &apis ) throw()
 {
   apis.clear();
@@ -75,11 +92,14 @@ void RtMidi :: getCompiledApi( std::vector<RtMidi::Api> &apis ) throw()
 #if defined(__UNIX_JACK__)
   apis.push_back( UNIX_JACK );
 #endif
+#if defined(__LINUX_ALSA__)
+  apis.push_back( LINUX_ALSA_RAW );
+#endif
 #if defined(__WINDOWS_MM__)
   apis.push_back( WINDOWS_MM );
 #endif
-#if defined(__RTMIDI_DUMMY__)
-  apis.push_back( RTMIDI_DUMMY );
+#if defined(__RTMIDI_LOOPBACK__)
+  apis.push_back( LOOPBACK );
 #endif
 }
 
@@ -100,6 +120,8 @@ void RtMidiIn :: openMidiApi( RtMidi::Api api, const std::string clientName, uns
 #if defined(__LINUX_ALSA__)
   if ( api == LINUX_ALSA )
     rtapi_ = new MidiInAlsa( clientName, queueSizeLimit );
+  if ( api == LINUX_ALSA_RAW )
+    rtapi_ = new MidiInAlsaRaw( clientName, queueSizeLimit );
 #endif
 #if defined(__WINDOWS_MM__)
   if ( api == WINDOWS_MM )
@@ -109,9 +131,9 @@ void RtMidiIn :: openMidiApi( RtMidi::Api api, const std::string clientName, uns
   if ( api == MACOSX_CORE )
     rtapi_ = new MidiInCore( clientName, queueSizeLimit );
 #endif
-#if defined(__RTMIDI_DUMMY__)
-  if ( api == RTMIDI_DUMMY )
-    rtapi_ = new MidiInDummy( clientName, queueSizeLimit );
+#if defined(__RTMIDI_LOOPBACK__)
+  if ( api == LOOPBACK || api == RTMIDI_DUMMY )
+    rtapi_ = new MidiInLoopback( clientName, queueSizeLimit );
 #endif
 }
 
@@ -133,6 +155,8 @@ RtMidiIn :: RtMidiIn( RtMidi::Api api, const std::string clientName, unsigned in
   std::vector< RtMidi::Api > apis;
   getCompiledApi( apis );
   for ( unsigned int i=0; i<apis.size(); i++ ) {
+    // The loopback API is only a default when no other API is compiled.
+    if ( apis[i] == LOOPBACK && i > 0 ) break;
     openMidiApi( apis[i], clientName, queueSizeLimit );
     if ( rtapi_->getPortCount() ) break;
   }
@@ -140,7 +164,7 @@ RtMidiIn :: RtMidiIn( RtMidi::Api api, const std::string clientName, unsigned in
   if ( rtapi_ ) return;
 
   // It should not be possible to get here because the preprocessor
-  // definition __RTMIDI_DUMMY__ is automatically defined if no
+  // definition __RTMIDI_LOOPBACK__ is automatically defined if no
   // API-specific definitions are passed to the compiler. But just in
   // case something weird happens, we'll throw an error.
   std::string errorText = "RtMidiIn: no compiled API support found ... critical error!!";
@@ -169,6 +193,8 @@ void RtMidiOut :: openMidiApi( RtMidi::Api api, const std::string clientName )
 #if defined(__LINUX_ALSA__)
   if ( api == LINUX_ALSA )
     rtapi_ = new MidiOutAlsa( clientName );
+  if ( api == LINUX_ALSA_RAW )
+    rtapi_ = new MidiOutAlsaRaw( clientName );
 #endif
 #if defined(__WINDOWS_MM__)
   if ( api == WINDOWS_MM )
@@ -178,9 +204,9 @@ void RtMidiOut :: openMidiApi( RtMidi::Api api, const std::string clientName )
   if ( api == MACOSX_CORE )
     rtapi_ = new MidiOutCore( clientName );
 #endif
-#if defined(__RTMIDI_DUMMY__)
-  if ( api == RTMIDI_DUMMY )
-    rtapi_ = new MidiOutDummy( clientName );
+#if defined(__RTMIDI_LOOPBACK__)
+  if ( api == LOOPBACK || api == RTMIDI_DUMMY )
+    rtapi_ = new MidiOutLoopback( clientName );
 #endif
 }
 
@@ -201,6 +227,8 @@ RtMidiOut :: RtMidiOut( RtMidi::Api api, const std::string clientName )
   std::vector< RtMidi::Api > apis;
   getCompiledApi( apis );
   for ( unsigned int i=0; i<apis.size(); i++ ) {
+    // The loopback API is only a default when no other API is compiled.
+    if ( apis[i] == LOOPBACK && i > 0 ) break;
     openMidiApi( apis[i], clientName );
     if ( rtapi_->getPortCount() ) break;
   }
@@ -208,7 +236,7 @@ RtMidiOut :: RtMidiOut( RtMidi::Api api, const std::string clientName )
   if ( rtapi_ ) return;
 
   // It should not be possible to get here because the preprocessor
-  // definition __RTMIDI_DUMMY__ is automatically defined if no
+  // definition __RTMIDI_LOOPBACK__ is automatically defined if no
   // API-specific definitions are passed to the compiler. But just in
   // case something weird happens, we'll thrown an error.
   std::string errorText = "RtMidiOut: no compiled API support found ... critical error!!";
@@ -232,6 +260,24 @@ MidiApi :: ~MidiApi( void )
 {
 }
 
+void MidiApi :: getPortNames( std::vector<std::string> &names )
+{
+  unsigned int nPorts = getPortCount();
+  names.resize( nPorts );
+  for ( unsigned int i=0; i<nPorts; i++ )
+    names[i] = getPortName( i );
+}
+
+void MidiApi :: setPortCallback( RtMidiPortCallback /*callback*/, void * /*userData*/ )
+{
+  errorString_ = "MidiApi::setPortCallback: port notifications are not supported by the current API.";
+  error( RtMidiError::WARNING, errorString_ );
+}
+
+void MidiApi :: cancelPortCallback( void )
+{
+}
+
 void MidiApi :: setErrorCallback( RtMidiErrorCallback errorCallback )
 {
     errorCallback_ = errorCallback;
@@ -313,9 +359,12 @@ void MidiInApi :: cancelCallback()
     return;
   }
 
+  inputData_.usingCallback = false;
+  // The input thread may still be running the callback, it is only
+  // detached once that call returns.
+  inputData_.waitCallbacks();
   inputData_.userCallback = 0;
   inputData_.userData = 0;
-  inputData_.usingCallback = false;
 }
 
 void MidiInApi :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense )
@@ -350,6 +399,57 @@ double MidiInApi :: getMessage( std::vector<unsigned char> *message )
   return deltaTime;
 }
 
+void MidiInApi :: setSpinPolling( unsigned int /*maxSpinMicroseconds*/ )
+{
+  errorString_ = "MidiInApi::setSpinPolling: spin polling is not supported by the current API.";
+  error( RtMidiError::WARNING, errorString_ );
+}
+
+bool MidiInApi :: getPollingStats( RtMidiIn::PollingStats * /*stats*/ )
+{
+  return false;
+}
+
+void MidiInApi :: setSysexCallback( RtMidiIn::RtMidiSysexCallback /*callback*/, void * /*userData*/ )
+{
+  errorString_ = "MidiInApi::setSysexCallback: streaming sysex is not supported by the current API.";
+  error( RtMidiError::WARNING, errorString_ );
+}
+
+void MidiInApi :: cancelSysexCallback( void )
+{
+  inputData_.sysexCallback = 0;
+  inputData_.waitCallbacks();
+  inputData_.sysexUserData = 0;
+}
+
+void MidiInApi :: RtMidiInData :: waitCallbacks( void )
+{
+  // Grace period: a callback entered before the cancellation ends with
+  // the next epoch increment, the ones entered after it see it.
+  unsigned long long current = callbackEpoch.load();
+  if ( current & 1 ) {
+    while ( callbackEpoch.load() == current )
+      std::this_thread::yield();
+  }
+}
+
+void MidiInApi :: getInputStats( RtMidiIn::InputStats *stats )
+{
+  stats->received = inputData_.received.load( std::memory_order_relaxed );
+  stats->queueDrops = inputData_.queueDrops.load( std::memory_order_relaxed );
+  stats->overruns = inputData_.overruns.load( std::memory_order_relaxed );
+  stats->queueHighWater = inputData_.queueHighWater.load( std::memory_order_relaxed );
+}
+
+void MidiInApi :: resetInputStats( void )
+{
+  inputData_.received.store( 0 );
+  inputData_.queueDrops.store( 0 );
+  inputData_.overruns.store( 0 );
+  inputData_.queueHighWater.store( 0 );
+}
+
 //*********************************************************************//
 //  Common MidiOutApi Definitions
 //*********************************************************************//
@@ -363,6 +463,29 @@ MidiOutApi :: ~MidiOutApi( void )
 {
 }
 
+unsigned int MidiOutApi :: sendSysexAsync( const std::vector<unsigned char> & /*message*/,
+                                           RtMidiOut::RtMidiSysexProgressCallback /*callback*/, void * /*userData*/ )
+{
+  errorString_ = "MidiOutApi::sendSysexAsync: asynchronous sysex is not supported by the current API.";
+  error( RtMidiError::WARNING, errorString_ );
+  return 0;
+}
+
+void MidiOutApi :: setSysexPacing( unsigned int /*chunkSize*/, unsigned int /*intervalMicroseconds*/ )
+{
+  errorString_ = "MidiOutApi::setSysexPacing: asynchronous sysex is not supported by the current API.";
+  error( RtMidiError::WARNING, errorString_ );
+}
+
+RtMidiOut::SysexStatus MidiOutApi :: getSysexStatus( unsigned int /*id*/, size_t * /*sent*/, size_t * /*total*/ )
+{
+  return RtMidiOut::SYSEX_UNKNOWN;
+}
+
+void MidiOutApi :: cancelSysex( unsigned int /*id*/ )
+{
+}
+
 // *************************************************** //
 //
 // OS/API-specific methods.
@@ -400,6 +523,7 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
 {
   MidiInApi::RtMidiInData *data = static_cast<MidiInApi::RtMidiInData *> (procRef);
   CoreMidiData *apiData = static_cast<CoreMidiData *> (data->apiData);
+  midiTrace( MIDI_TRACE_INGRESS, list->numPackets );
 
   unsigned char status;
   unsigned short nBytes, iByte, size;
@@ -457,9 +581,12 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
 
       if ( !( data->ignoreFlags & 0x01 ) && !continueSysex ) {
         // If not a continuing sysex message, invoke the user callback function or queue the message.
-        if ( data->usingCallback ) {
+        midiTrace( MIDI_TRACE_DECODE, message.bytes.empty() ? 0 : message.bytes[0] );
+        data->countReceived();
+        if ( data->enterCallback() ) {
           RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
           callback( message.timeStamp, &message.bytes, data->userData );
+          data->leaveCallback();
         }
         else {
           // As long as we haven't reached our queue size limit, push the message.
@@ -468,9 +595,12 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
             if ( data->queue.back == data->queue.ringSize )
               data->queue.back = 0;
             data->queue.size++;
+            data->countQueued();
           }
-          else
+          else {
+            data->countQueueDrop();
             std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
+          }
         }
         message.bytes.clear();
       }
@@ -521,9 +651,12 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
           message.bytes.assign( &packet->data[iByte], &packet->data[iByte+size] );
           if ( !continueSysex ) {
             // If not a continuing sysex message, invoke the user callback function or queue the message.
-            if ( data->usingCallback ) {
+            midiTrace( MIDI_TRACE_DECODE, message.bytes.empty() ? 0 : message.bytes[0] );
+            data->countReceived();
+            if ( data->enterCallback() ) {
               RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
               callback( message.timeStamp, &message.bytes, data->userData );
+              data->leaveCallback();
             }
             else {
               // As long as we haven't reached our queue size limit, push the message.
@@ -532,9 +665,12 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
                 if ( data->queue.back == data->queue.ringSize )
                   data->queue.back = 0;
                 data->queue.size++;
+                data->countQueued();
               }
-              else
+              else {
+                data->countQueueDrop();
                 std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
+              }
             }
             message.bytes.clear();
           }
@@ -1101,10 +1237,101 @@ void MidiOutCore :: sendMessage( std::vector<unsigned char> *message )
 
 #include <pthread.h>
 #include <sys/time.h>
+#include <time.h>
+#include <deque>
 
 // ALSA header file.
 #include <alsa/asoundlib.h>
 
+struct AlsaSysexSender;
+
+// Spin polling state and counters.  Only the input thread writes them,
+// as relaxed atomics inside a seqlock so getPollingStats() reads a
+// consistent snapshot without stalling the thread.  A reset asked by
+// setSpinPolling() is applied by the input thread, until then readers
+// see zeroed counters.
+struct AlsaPollingStats {
+  std::atomic<unsigned long long> spinBudget;  // maximum spin time in ns before falling back to poll() (0 = disabled)
+  std::atomic<unsigned long long> spinCurrent; // adaptive spin time in ns, between spinBudget/16 and spinBudget
+  std::atomic<unsigned long long> spinHits;
+  std::atomic<unsigned long long> spinMisses;
+  std::atomic<unsigned long long> pollWakeups;
+  std::atomic<unsigned long long> spinNanoseconds;
+  std::atomic<unsigned long long> spinLatencyNanoseconds;
+  std::atomic<unsigned long long> spinLatencyCount;
+  std::atomic<unsigned long long> pollLatencyNanoseconds;
+  std::atomic<unsigned long long> pollLatencyCount;
+  std::atomic<unsigned int> sequence;          // odd while the input thread updates the counters
+  std::atomic<bool> resetRequested;
+
+  void init( void )
+  {
+    spinBudget.store( 0 );
+    sequence.store( 0 );
+    resetRequested.store( false );
+    clear();
+  }
+
+  // Input thread only, between begin() and end().
+  void clear( void )
+  {
+    spinCurrent.store( spinBudget.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+    spinHits.store( 0, std::memory_order_relaxed );
+    spinMisses.store( 0, std::memory_order_relaxed );
+    pollWakeups.store( 0, std::memory_order_relaxed );
+    spinNanoseconds.store( 0, std::memory_order_relaxed );
+    spinLatencyNanoseconds.store( 0, std::memory_order_relaxed );
+    spinLatencyCount.store( 0, std::memory_order_relaxed );
+    pollLatencyNanoseconds.store( 0, std::memory_order_relaxed );
+    pollLatencyCount.store( 0, std::memory_order_relaxed );
+  }
+
+  void begin( void )
+  {
+    sequence.store( sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+  }
+
+  void end( void )
+  {
+    sequence.store( sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+  }
+
+  // Single writer: a plain load and store, no read-modify-write.
+  static void add( std::atomic<unsigned long long> &counter, unsigned long long value )
+  {
+    counter.store( counter.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+  }
+
+  void read( RtMidiIn::PollingStats *stats ) const
+  {
+    unsigned int before, after;
+    bool reset;
+    do {
+      before = sequence.load( std::memory_order_acquire );
+      reset = resetRequested.load( std::memory_order_acquire );
+      stats->spinHits = spinHits.load( std::memory_order_relaxed );
+      stats->spinMisses = spinMisses.load( std::memory_order_relaxed );
+      stats->pollWakeups = pollWakeups.load( std::memory_order_relaxed );
+      stats->spinNanoseconds = spinNanoseconds.load( std::memory_order_relaxed );
+      stats->spinLatencyNanoseconds = spinLatencyNanoseconds.load( std::memory_order_relaxed );
+      stats->spinLatencyCount = spinLatencyCount.load( std::memory_order_relaxed );
+      stats->pollLatencyNanoseconds = pollLatencyNanoseconds.load( std::memory_order_relaxed );
+      stats->pollLatencyCount = pollLatencyCount.load( std::memory_order_relaxed );
+      stats->currentSpinMicroseconds = (unsigned int) ( spinCurrent.load( std::memory_order_relaxed ) / 1000 );
+      std::atomic_thread_fence( std::memory_order_acquire );
+      after = sequence.load( std::memory_order_relaxed );
+    } while ( ( before & 1 ) || before != after );
+    stats->maxSpinMicroseconds = (unsigned int) ( spinBudget.load( std::memory_order_relaxed ) / 1000 );
+    if ( reset ) {
+      unsigned int maxSpin = stats->maxSpinMicroseconds;
+      *stats = RtMidiIn::PollingStats();
+      stats->maxSpinMicroseconds = maxSpin;
+      stats->currentSpinMicroseconds = maxSpin;
+    }
+  }
+};
+
 // A structure to hold variables related to the ALSA API
 // implementation.
 struct AlsaMidiData {
@@ -1120,10 +1347,141 @@ struct AlsaMidiData {
   unsigned long long lastTime;
   int queue_id; // an input queue is needed to get timestamped events
   int trigger_fds[2];
+  unsigned long long queueStartTime; // monotonic time at which the input queue was started
+  AlsaPollingStats pollStats;
+  AlsaSysexSender *sender;           // asynchronous sysex output, started on first use
 };
 
 #define PORT_TYPE( pinfo, bits ) ((snd_seq_port_info_get_capability(pinfo) & (bits)) == (bits))
 
+// Monotonic clock in nanoseconds, used to account the spin polling mode.
+static unsigned long long alsaMonotonicTime( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Reference counting of the shared port table (see below).
+static void alsaPortCacheAttach( void );
+static void alsaPortCacheDetach( void );
+static void alsaPortCacheRemoveListener( MidiApi *owner );
+
+// Ways the input thread can come to find an event pending.
+enum AlsaWaitPath { ALSA_WAIT_NONE, ALSA_WAIT_SPIN, ALSA_WAIT_POLL };
+
+// The ALSA sequencer has a maximum buffer size for MIDI sysex events of
+// 256 bytes.  If a device sends sysex messages larger than this, they
+// are segmented into 256 byte chunks.  Unless they are streamed to a
+// sysex callback, the chunks are collected in a chain of fixed size
+// blocks, recycled from one message to the next, and copied once into
+// the message when the final chunk arrives.
+#define ALSA_SYSEX_BLOCK_SIZE 4096
+#define ALSA_SYSEX_POOL_LIMIT 256 // blocks kept for reuse (1 MB)
+
+struct AlsaSysexBlock {
+  unsigned char bytes[ALSA_SYSEX_BLOCK_SIZE];
+  unsigned int size;
+  AlsaSysexBlock *next;
+};
+
+struct AlsaSysexChain {
+  AlsaSysexBlock *head;
+  AlsaSysexBlock *tail;
+  AlsaSysexBlock *pool;
+  unsigned int poolSize;
+  size_t total;
+
+  AlsaSysexChain() : head(0), tail(0), pool(0), poolSize(0), total(0) {}
+};
+
+static bool alsaSysexAppend( AlsaSysexChain *chain, const unsigned char *bytes, size_t size )
+{
+  while ( size > 0 ) {
+    if ( !chain->tail || chain->tail->size == ALSA_SYSEX_BLOCK_SIZE ) {
+      AlsaSysexBlock *block = chain->pool;
+      if ( block ) {
+        chain->pool = block->next;
+        chain->poolSize--;
+      }
+      else {
+        block = (AlsaSysexBlock *) malloc( sizeof( AlsaSysexBlock ) );
+        if ( block == NULL ) return false;
+      }
+      block->size = 0;
+      block->next = 0;
+      if ( chain->tail ) chain->tail->next = block;
+      else chain->head = block;
+      chain->tail = block;
+    }
+    size_t n = ALSA_SYSEX_BLOCK_SIZE - chain->tail->size;
+    if ( n > size ) n = size;
+    memcpy( chain->tail->bytes + chain->tail->size, bytes, n );
+    chain->tail->size += n;
+    chain->total += n;
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Copy the collected chunks into \e bytes and recycle the blocks.
+static void alsaSysexFlatten( AlsaSysexChain *chain, std::vector<unsigned char> &bytes )
+{
+  bytes.resize( chain->total );
+  size_t offset = 0;
+  AlsaSysexBlock *block = chain->head;
+  while ( block ) {
+    AlsaSysexBlock *next = block->next;
+    if ( block->size ) memcpy( &bytes[offset], block->bytes, block->size );
+    offset += block->size;
+    if ( chain->poolSize < ALSA_SYSEX_POOL_LIMIT ) {
+      block->next = chain->pool;
+      chain->pool = block;
+      chain->poolSize++;
+    }
+    else free( block );
+    block = next;
+  }
+  chain->head = chain->tail = 0;
+  chain->total = 0;
+}
+
+static void alsaSysexFree( AlsaSysexChain *chain )
+{
+  std::vector<unsigned char> unused;
+  chain->poolSize = ALSA_SYSEX_POOL_LIMIT;
+  alsaSysexFlatten( chain, unused );
+  while ( chain->pool ) {
+    AlsaSysexBlock *next = chain->pool->next;
+    free( chain->pool );
+    chain->pool = next;
+  }
+  chain->poolSize = 0;
+}
+
+// Delta time in seconds between the given event and the previous one.
+static double alsaDeltaTime( MidiInApi::RtMidiInData *data, AlsaMidiData *apiData, const snd_seq_event_t *ev )
+{
+  unsigned long long time, lastTime;
+
+  // Method 1: Use the system time.
+  //(void)gettimeofday(&tv, (struct timezone *)NULL);
+  //time = (tv.tv_sec * 1000000) + tv.tv_usec;
+
+  // Method 2: Use the ALSA sequencer event time data.
+  // (thanks to Pedro Lopez-Cabanillas!).
+  time = ( ev->time.time.tv_sec * 1000000 ) + ( ev->time.time.tv_nsec/1000 );
+  lastTime = time;
+  time -= apiData->lastTime;
+  apiData->lastTime = lastTime;
+  if ( data->firstMessage == true ) {
+    data->firstMessage = false;
+    return 0.0;
+  }
+  return time * 0.000001;
+}
+
 //*********************************************************************//
 //  API: LINUX ALSA
 //  Class Definitions: MidiInAlsa
@@ -1135,15 +1493,17 @@ static void *alsaMidiHandler( void *ptr )
   AlsaMidiData *apiData = static_cast<AlsaMidiData *> (data->apiData);
 
   long nBytes;
-  unsigned long long time, lastTime;
   bool continueSysex = false;
   bool doDecode = false;
+  bool doSysex = false;
   MidiInApi::MidiMessage message;
+  AlsaSysexChain sysex;
   int poll_fd_count;
   struct pollfd *poll_fds;
 
   snd_seq_event_t *ev;
   int result;
+  AlsaWaitPath waitPath = ALSA_WAIT_NONE;
   apiData->bufferSize = 32;
   result = snd_midi_event_new( 0, &apiData->coder );
   if ( result < 0 ) {
@@ -1168,16 +1528,65 @@ static void *alsaMidiHandler( void *ptr )
   poll_fds[0].fd = apiData->trigger_fds[0];
   poll_fds[0].events = POLLIN;
 
+  AlsaPollingStats &pollStats = apiData->pollStats;
   while ( data->doInput ) {
 
+    // Acquire: pairs with the release store of setSpinPolling, so the new
+    // spin budget is seen by clear().
+    if ( pollStats.resetRequested.load( std::memory_order_acquire ) ) {
+      pollStats.begin();
+      pollStats.resetRequested.store( false, std::memory_order_relaxed );
+      pollStats.clear();
+      pollStats.end();
+    }
+
     if ( snd_seq_event_input_pending( apiData->seq, 1 ) == 0 ) {
-      // No data pending
+      // No data pending.  In low-latency mode, busy-poll the sequencer
+      // for a while before paying for a full poll() wakeup.  The spin
+      // time grows while spins keep catching events and shrinks while
+      // they expire, so sparse input does not burn a whole core.
+      unsigned long long budget = pollStats.spinBudget.load( std::memory_order_relaxed );
+      if ( budget > 0 ) {
+        unsigned long long spinTime = pollStats.spinCurrent.load( std::memory_order_relaxed );
+        unsigned long long spinStart = alsaMonotonicTime();
+        unsigned long long now = spinStart;
+        bool found = false;
+        while ( data->doInput && now - spinStart < spinTime ) {
+          if ( snd_seq_event_input_pending( apiData->seq, 1 ) > 0 ) {
+            found = true;
+            break;
+          }
+          now = alsaMonotonicTime();
+        }
+        if ( found ) {
+          spinTime *= 2;
+          if ( spinTime > budget ) spinTime = budget;
+        }
+        else {
+          spinTime /= 2;
+          if ( spinTime < budget / 16 ) spinTime = budget / 16;
+        }
+        pollStats.begin();
+        AlsaPollingStats::add( pollStats.spinNanoseconds, now - spinStart );
+        AlsaPollingStats::add( found ? pollStats.spinHits : pollStats.spinMisses, 1 );
+        pollStats.spinCurrent.store( spinTime, std::memory_order_relaxed );
+        pollStats.end();
+        if ( found ) {
+          waitPath = ALSA_WAIT_SPIN;
+          continue;
+        }
+      }
+
       if ( poll( poll_fds, poll_fd_count, -1) >= 0 ) {
         if ( poll_fds[0].revents & POLLIN ) {
           bool dummy;
           int res = read( poll_fds[0].fd, &dummy, sizeof(dummy) );
           (void) res;
         }
+        pollStats.begin();
+        AlsaPollingStats::add( pollStats.pollWakeups, 1 );
+        pollStats.end();
+        waitPath = ALSA_WAIT_POLL;
       }
       continue;
     }
@@ -1185,6 +1594,7 @@ static void *alsaMidiHandler( void *ptr )
     // If here, there should be data.
     result = snd_seq_event_input( apiData->seq, &ev );
     if ( result == -ENOSPC ) {
+      data->countOverrun();
       std::cerr << "\nMidiInAlsa::alsaMidiHandler: MIDI input buffer overrun!\n\n";
       continue;
     }
@@ -1193,12 +1603,36 @@ static void *alsaMidiHandler( void *ptr )
       perror("System reports");
       continue;
     }
+    midiTrace( MIDI_TRACE_INGRESS, ev->type );
+
+#ifndef AVOID_TIMESTAMPING
+    // Account the pickup latency (queue timestamp to now) of the event
+    // against the way we waited for it.
+    if ( waitPath != ALSA_WAIT_NONE && pollStats.spinBudget.load( std::memory_order_relaxed ) > 0 ) {
+      unsigned long long stamp = apiData->queueStartTime
+        + (unsigned long long) ev->time.time.tv_sec * 1000000000ULL + ev->time.time.tv_nsec;
+      unsigned long long now = alsaMonotonicTime();
+      unsigned long long latency = ( now > stamp ) ? now - stamp : 0;
+      pollStats.begin();
+      if ( waitPath == ALSA_WAIT_SPIN ) {
+        AlsaPollingStats::add( pollStats.spinLatencyNanoseconds, latency );
+        AlsaPollingStats::add( pollStats.spinLatencyCount, 1 );
+      }
+      else {
+        AlsaPollingStats::add( pollStats.pollLatencyNanoseconds, latency );
+        AlsaPollingStats::add( pollStats.pollLatencyCount, 1 );
+      }
+      pollStats.end();
+    }
+#endif
+    waitPath = ALSA_WAIT_NONE;
 
     // This is a bit weird, but we now have to decode an ALSA MIDI
     // event (back) into MIDI bytes.  We'll ignore non-MIDI types.
-    if ( !continueSysex ) message.bytes.clear();
+    message.bytes.clear();
 
     doDecode = false;
+    doSysex = false;
     switch ( ev->type ) {
 
     case SND_SEQ_EVENT_PORT_SUBSCRIBED:
@@ -1235,71 +1669,63 @@ static void *alsaMidiHandler( void *ptr )
       break;
 
 		case SND_SEQ_EVENT_SYSEX:
-      if ( (data->ignoreFlags & 0x01) ) break;
-      if ( ev->data.ext.len > apiData->bufferSize ) {
-        apiData->bufferSize = ev->data.ext.len;
-        free( buffer );
-        buffer = (unsigned char *) malloc( apiData->bufferSize );
-        if ( buffer == NULL ) {
-          data->doInput = false;
-          std::cerr << "\nMidiInAlsa::alsaMidiHandler: error resizing buffer memory!\n\n";
-          break;
-        }
-      }
+      // Sysex events already carry raw MIDI bytes, no decoding is needed.
+      if ( data->sysexCallback || !( data->ignoreFlags & 0x01 ) ) doSysex = true;
+      break;
 
     default:
       doDecode = true;
     }
 
-    if ( doDecode ) {
+    if ( doSysex ) {
+      const unsigned char *chunk = (const unsigned char *) ev->data.ext.ptr;
+      size_t size = ev->data.ext.len;
+      bool last = ( size == 0 || chunk[size - 1] == 0xF7 );
+      // Entered unconditionally, cancelSysexCallback waits on the same epoch.
+      data->callbackEpoch.fetch_add( 1 );
+      RtMidiIn::RtMidiSysexCallback sysexCallback = data->sysexCallback;
+      if ( sysexCallback ) {
+        // Hand the chunk over as it is, straight from the event.
+        int flags = continueSysex ? RtMidiIn::SYSEX_CONTINUE : RtMidiIn::SYSEX_START;
+        if ( last ) flags |= RtMidiIn::SYSEX_END;
+        sysexCallback( alsaDeltaTime( data, apiData, ev ), chunk, size, flags, data->sysexUserData );
+      }
+      else if ( !alsaSysexAppend( &sysex, chunk, size ) ) {
+        std::cerr << "\nMidiInAlsa::alsaMidiHandler: error allocating sysex memory, message dropped!\n\n";
+        std::vector<unsigned char> dropped;
+        alsaSysexFlatten( &sysex, dropped );
+        last = true;
+      }
+      else if ( last ) {
+        alsaSysexFlatten( &sysex, message.bytes );
+        message.timeStamp = alsaDeltaTime( data, apiData, ev );
+      }
+      data->leaveCallback();
+      continueSysex = !last;
+    }
+    else if ( doDecode ) {
 
       nBytes = snd_midi_event_decode( apiData->coder, buffer, apiData->bufferSize, ev );
       if ( nBytes > 0 ) {
-        // The ALSA sequencer has a maximum buffer size for MIDI sysex
-        // events of 256 bytes.  If a device sends sysex messages larger
-        // than this, they are segmented into 256 byte chunks.  So,
-        // we'll watch for this and concatenate sysex chunks into a
-        // single sysex message if necessary.
-        if ( !continueSysex )
-          message.bytes.assign( buffer, &buffer[nBytes] );
-        else
-          message.bytes.insert( message.bytes.end(), buffer, &buffer[nBytes] );
-
-        continueSysex = ( ( ev->type == SND_SEQ_EVENT_SYSEX ) && ( message.bytes.back() != 0xF7 ) );
-        if ( !continueSysex ) {
-
-          // Calculate the time stamp:
-          message.timeStamp = 0.0;
-
-          // Method 1: Use the system time.
-          //(void)gettimeofday(&tv, (struct timezone *)NULL);
-          //time = (tv.tv_sec * 1000000) + tv.tv_usec;
-
-          // Method 2: Use the ALSA sequencer event time data.
-          // (thanks to Pedro Lopez-Cabanillas!).
-          time = ( ev->time.time.tv_sec * 1000000 ) + ( ev->time.time.tv_nsec/1000 );
-          lastTime = time;
-          time -= apiData->lastTime;
-          apiData->lastTime = lastTime;
-          if ( data->firstMessage == true )
-            data->firstMessage = false;
-          else
-            message.timeStamp = time * 0.000001;
-        }
-        else {
+        message.bytes.assign( buffer, &buffer[nBytes] );
+        message.timeStamp = alsaDeltaTime( data, apiData, ev );
+      }
+      else {
 #if defined(__RTMIDI_DEBUG__)
-          std::cerr << "\nMidiInAlsa::alsaMidiHandler: event parsing error or not a MIDI event!\n\n";
+        std::cerr << "\nMidiInAlsa::alsaMidiHandler: event parsing error or not a MIDI event!\n\n";
 #endif
-        }
       }
     }
 
     snd_seq_free_event( ev );
-    if ( message.bytes.size() == 0 || continueSysex ) continue;
+    if ( message.bytes.size() == 0 ) continue;
 
-    if ( data->usingCallback ) {
+    midiTrace( MIDI_TRACE_DECODE, message.bytes.empty() ? 0 : message.bytes[0] );
+    data->countReceived();
+    if ( data->enterCallback() ) {
       RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
       callback( message.timeStamp, &message.bytes, data->userData );
+      data->leaveCallback();
     }
     else {
       // As long as we haven't reached our queue size limit, push the message.
@@ -1308,13 +1734,17 @@ static void *alsaMidiHandler( void *ptr )
         if ( data->queue.back == data->queue.ringSize )
           data->queue.back = 0;
         data->queue.size++;
+        data->countQueued();
       }
-      else
+      else {
+        data->countQueueDrop();
         std::cerr << "\nMidiInAlsa: message queue limit reached!!\n\n";
+      }
     }
   }
 
   if ( buffer ) free( buffer );
+  alsaSysexFree( &sysex );
   snd_midi_event_free( apiData->coder );
   apiData->coder = 0;
   apiData->thread = apiData->dummy_thread_id;
@@ -1328,11 +1758,14 @@ MidiInAlsa :: MidiInAlsa( const std::string clientName, unsigned int queueSizeLi
 
 MidiInAlsa :: ~MidiInAlsa()
 {
+  // Nothing to clean up if the initialization failed.
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( !data ) return;
+
   // Close a connection if it exists.
   closePort();
 
   // Shutdown the input thread.
-  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
   if ( inputData_.doInput ) {
     inputData_.doInput = false;
     int res = write( data->trigger_fds[1], &inputData_.doInput, sizeof(inputData_.doInput) );
@@ -1350,6 +1783,8 @@ MidiInAlsa :: ~MidiInAlsa()
 #endif
   snd_seq_close( data->seq );
   delete data;
+  alsaPortCacheRemoveListener( this );
+  alsaPortCacheDetach();
 }
 
 void MidiInAlsa :: initialize( const std::string& clientName )
@@ -1376,14 +1811,21 @@ void MidiInAlsa :: initialize( const std::string& clientName )
   data->thread = data->dummy_thread_id;
   data->trigger_fds[0] = -1;
   data->trigger_fds[1] = -1;
-  apiData_ = (void *) data;
-  inputData_.apiData = (void *) data;
+  data->queueStartTime = 0;
+  data->pollStats.init();
+  data->sender = 0;
 
-   if ( pipe(data->trigger_fds) == -1 ) {
+  if ( pipe(data->trigger_fds) == -1 ) {
+    snd_seq_close( seq );
+    delete data;
     errorString_ = "MidiInAlsa::initialize: error creating pipe objects.";
     error( RtMidiError::DRIVER_ERROR, errorString_ );
     return;
   }
+  apiData_ = (void *) data;
+  inputData_.apiData = (void *) data;
+  // Only attached once nothing can fail, the destructor detaches.
+  alsaPortCacheAttach();
 
   // Create the input queue
 #ifndef AVOID_TIMESTAMPING
@@ -1398,103 +1840,504 @@ void MidiInAlsa :: initialize( const std::string& clientName )
 #endif
 }
 
-// This function is used to count or get the pinfo structure for a given port number.
-unsigned int portInfo( snd_seq_t *seq, snd_seq_port_info_t *pinfo, unsigned int type, int portNumber )
-{
-  snd_seq_client_info_t *cinfo;
+// The sequencer port table is shared by all the ALSA instances of the
+// process.  It is built once by walking every client and port, and then
+// kept up to date incrementally from the events announced on the
+// System:Announce port, so getPortCount() and getPortName() do not pay a
+// full client/port scan on each call.  While port callbacks are set, a
+// monitor thread applies the announcements as they arrive and reports
+// the ports added and removed to the callbacks.
+struct AlsaPortEntry {
   int client;
-  int count = 0;
-  snd_seq_client_info_alloca( &cinfo );
+  int port;
+  unsigned int caps;
+  std::string name;
+};
 
-  snd_seq_client_info_set_client( cinfo, -1 );
-  while ( snd_seq_query_next_client( seq, cinfo ) >= 0 ) {
-    client = snd_seq_client_info_get_client( cinfo );
-    if ( client == 0 ) continue;
-    // Reset query info
-    snd_seq_port_info_set_client( pinfo, client );
-    snd_seq_port_info_set_port( pinfo, -1 );
-    while ( snd_seq_query_next_port( seq, pinfo ) >= 0 ) {
-      unsigned int atyp = snd_seq_port_info_get_type( pinfo );
-      if ( ( atyp & SND_SEQ_PORT_TYPE_MIDI_GENERIC ) == 0 ) continue;
-      unsigned int caps = snd_seq_port_info_get_capability( pinfo );
-      if ( ( caps & type ) != type ) continue;
-      if ( count == portNumber ) return 1;
-      ++count;
+struct AlsaPortListener {
+  MidiApi *owner;
+  RtMidiPortCallback callback;
+  void *userData;
+};
+
+struct AlsaPortCache {
+  snd_seq_t *seq;          // client subscribed to System:Announce (0 if unavailable)
+  unsigned int refCount;
+  bool valid;              // false until built, or after the announce queue overran
+  std::vector<AlsaPortEntry> ports;  // MIDI generic ports, sorted by client and port
+  std::vector<unsigned int> inputs;  // indices of the readable ports
+  std::vector<unsigned int> outputs; // indices of the writable ports
+  std::vector<AlsaPortListener> listeners;
+  std::vector<RtMidiPortEvent> pending; // changes not reported to the listeners yet
+  pthread_t monitorThread;
+  bool monitoring;         // the monitor thread is running (iff there are listeners)
+  int trigger_fds[2];      // wakes the monitor thread up to stop it
+
+  AlsaPortCache() : seq(0), refCount(0), valid(false), monitoring(false) {}
+};
+
+static AlsaPortCache alsaPortCache;
+static pthread_mutex_t alsaPortCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+// Held while calling the listeners, so that a listener cannot be removed
+// (and its instance deleted) in the middle of a notification.  Always
+// taken before alsaPortCacheMutex.
+static pthread_mutex_t alsaPortDispatchMutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define ALSA_INPUT_CAPS ( SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ )
+#define ALSA_OUTPUT_CAPS ( SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE )
+
+static void alsaPortCacheAttach( void )
+{
+  pthread_mutex_lock( &alsaPortCacheMutex );
+  if ( alsaPortCache.refCount++ == 0 ) {
+    alsaPortCache.valid = false;
+    snd_seq_t *seq;
+    if ( snd_seq_open( &seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK ) >= 0 ) {
+      snd_seq_set_client_name( seq, "RtMidi Port Monitor" );
+      int port = snd_seq_create_simple_port( seq, "Announce",
+                                             SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE|SND_SEQ_PORT_CAP_NO_EXPORT,
+                                             SND_SEQ_PORT_TYPE_APPLICATION );
+      if ( port >= 0 &&
+           snd_seq_connect_from( seq, port, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE ) >= 0 )
+        alsaPortCache.seq = seq;
+      else
+        snd_seq_close( seq );
     }
+#if defined(__RTMIDI_DEBUG__)
+    if ( !alsaPortCache.seq )
+      std::cerr << "\nRtMidi ALSA: could not subscribe to System:Announce, ports will be rescanned on each query.\n\n";
+#endif
   }
+  pthread_mutex_unlock( &alsaPortCacheMutex );
+}
 
-  // If a negative portNumber was used, return the port count.
-  if ( portNumber < 0 ) return count;
-  return 0;
+static void alsaPortCacheDetach( void )
+{
+  pthread_mutex_lock( &alsaPortCacheMutex );
+  if ( alsaPortCache.refCount > 0 && --alsaPortCache.refCount == 0 ) {
+    if ( alsaPortCache.seq ) snd_seq_close( alsaPortCache.seq );
+    alsaPortCache.seq = 0;
+    alsaPortCache.valid = false;
+    alsaPortCache.ports.clear();
+    alsaPortCache.inputs.clear();
+    alsaPortCache.outputs.clear();
+  }
+  pthread_mutex_unlock( &alsaPortCacheMutex );
 }
 
-unsigned int MidiInAlsa :: getPortCount()
+static std::string alsaPortName( snd_seq_t *seq, int client, int port )
+{
+  snd_seq_client_info_t *cinfo;
+  snd_seq_client_info_alloca( &cinfo );
+  std::ostringstream os;
+  if ( snd_seq_get_any_client_info( seq, client, cinfo ) >= 0 )
+    os << snd_seq_client_info_get_name( cinfo );
+  os << " ";                                    // These lines added to make sure devices are listed
+  os << client;                                 // with full portnames added to ensure individual device names
+  os << ":";
+  os << port;
+  return os.str();
+}
+
+// Queue a notification for the listeners.  Called with the cache mutex held.
+static void alsaPortCacheNotify( RtMidiPortEvent::Type type, const AlsaPortEntry &entry )
+{
+  if ( alsaPortCache.listeners.empty() ) return;
+  RtMidiPortEvent event;
+  event.type = type;
+  event.isInput = ( entry.caps & ALSA_INPUT_CAPS ) == ALSA_INPUT_CAPS;
+  event.isOutput = ( entry.caps & ALSA_OUTPUT_CAPS ) == ALSA_OUTPUT_CAPS;
+  event.portName = entry.name;
+  if ( event.isInput || event.isOutput ) alsaPortCache.pending.push_back( event );
+}
+
+// Position of the given address in the (sorted) table, or of the entry
+// it should be inserted before.
+static unsigned int alsaPortCacheFind( int client, int port )
+{
+  unsigned int lo = 0, hi = alsaPortCache.ports.size();
+  while ( lo < hi ) {
+    unsigned int mid = ( lo + hi ) / 2;
+    const AlsaPortEntry &e = alsaPortCache.ports[mid];
+    if ( e.client < client || ( e.client == client && e.port < port ) ) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// Re-read a single port from the sequencer and insert, replace or
+// remove its table entry accordingly.
+static void alsaPortCacheUpdate( snd_seq_t *seq, int client, int port )
 {
+  unsigned int i = alsaPortCacheFind( client, port );
+  bool present = ( i < alsaPortCache.ports.size() &&
+                   alsaPortCache.ports[i].client == client && alsaPortCache.ports[i].port == port );
+
   snd_seq_port_info_t *pinfo;
   snd_seq_port_info_alloca( &pinfo );
+  if ( client == SND_SEQ_CLIENT_SYSTEM ||
+       snd_seq_get_any_port_info( seq, client, port, pinfo ) < 0 ||
+       ( snd_seq_port_info_get_type( pinfo ) & SND_SEQ_PORT_TYPE_MIDI_GENERIC ) == 0 ) {
+    if ( present ) {
+      alsaPortCacheNotify( RtMidiPortEvent::PORT_REMOVED, alsaPortCache.ports[i] );
+      alsaPortCache.ports.erase( alsaPortCache.ports.begin() + i );
+    }
+    return;
+  }
 
-  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
-  return portInfo( data->seq, pinfo, SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ, -1 );
+  AlsaPortEntry entry;
+  entry.client = client;
+  entry.port = port;
+  entry.caps = snd_seq_port_info_get_capability( pinfo );
+  entry.name = alsaPortName( seq, client, port );
+  if ( present ) {
+    AlsaPortEntry &old = alsaPortCache.ports[i];
+    if ( old.caps != entry.caps || old.name != entry.name ) {
+      alsaPortCacheNotify( RtMidiPortEvent::PORT_REMOVED, old );
+      alsaPortCacheNotify( RtMidiPortEvent::PORT_ADDED, entry );
+    }
+    old = entry;
+  }
+  else {
+    alsaPortCache.ports.insert( alsaPortCache.ports.begin() + i, entry );
+    alsaPortCacheNotify( RtMidiPortEvent::PORT_ADDED, entry );
+  }
 }
 
-std::string MidiInAlsa :: getPortName( unsigned int portNumber )
+static void alsaPortCacheRebuild( snd_seq_t *seq )
 {
   snd_seq_client_info_t *cinfo;
   snd_seq_port_info_t *pinfo;
   snd_seq_client_info_alloca( &cinfo );
   snd_seq_port_info_alloca( &pinfo );
 
-  std::string stringName;
-  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
-  if ( portInfo( data->seq, pinfo, SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ, (int) portNumber ) ) {
-    int cnum = snd_seq_port_info_get_client( pinfo );
-    snd_seq_get_any_client_info( data->seq, cnum, cinfo );
-    std::ostringstream os;
-    os << snd_seq_client_info_get_name( cinfo );
-    os << " ";                                    // These lines added to make sure devices are listed
-    os << snd_seq_port_info_get_client( pinfo );  // with full portnames added to ensure individual device names
-    os << ":";
-    os << snd_seq_port_info_get_port( pinfo );
-    stringName = os.str();
-    return stringName;
+  std::vector<AlsaPortEntry> previous;
+  previous.swap( alsaPortCache.ports );
+  snd_seq_client_info_set_client( cinfo, -1 );
+  while ( snd_seq_query_next_client( seq, cinfo ) >= 0 ) {
+    int client = snd_seq_client_info_get_client( cinfo );
+    if ( client == 0 ) continue;
+    // Reset query info
+    snd_seq_port_info_set_client( pinfo, client );
+    snd_seq_port_info_set_port( pinfo, -1 );
+    while ( snd_seq_query_next_port( seq, pinfo ) >= 0 ) {
+      unsigned int atyp = snd_seq_port_info_get_type( pinfo );
+      if ( ( atyp & SND_SEQ_PORT_TYPE_MIDI_GENERIC ) == 0 ) continue;
+      AlsaPortEntry entry;
+      entry.client = client;
+      entry.port = snd_seq_port_info_get_port( pinfo );
+      entry.caps = snd_seq_port_info_get_capability( pinfo );
+      std::ostringstream os;
+      os << snd_seq_client_info_get_name( cinfo ) << " " << client << ":" << entry.port;
+      entry.name = os.str();
+      alsaPortCache.ports.push_back( entry );
+    }
   }
 
-  // If we get here, we didn't find a match.
-  errorString_ = "MidiInAlsa::getPortName: error looking for port name!";
-  error( RtMidiError::WARNING, errorString_ );
-  return stringName;
+  // Report what changed meanwhile (both lists are sorted by address).
+  if ( alsaPortCache.listeners.empty() ) return;
+  unsigned int i = 0, j = 0;
+  while ( i < previous.size() || j < alsaPortCache.ports.size() ) {
+    const AlsaPortEntry *a = ( i < previous.size() ) ? &previous[i] : 0;
+    const AlsaPortEntry *b = ( j < alsaPortCache.ports.size() ) ? &alsaPortCache.ports[j] : 0;
+    if ( a && ( !b || a->client < b->client || ( a->client == b->client && a->port < b->port ) ) ) {
+      alsaPortCacheNotify( RtMidiPortEvent::PORT_REMOVED, *a );
+      ++i;
+    }
+    else if ( b && ( !a || b->client < a->client || ( a->client == b->client && b->port < a->port ) ) ) {
+      alsaPortCacheNotify( RtMidiPortEvent::PORT_ADDED, *b );
+      ++j;
+    }
+    else {
+      if ( a->caps != b->caps || a->name != b->name ) {
+        alsaPortCacheNotify( RtMidiPortEvent::PORT_REMOVED, *a );
+        alsaPortCacheNotify( RtMidiPortEvent::PORT_ADDED, *b );
+      }
+      ++i;
+      ++j;
+    }
+  }
 }
 
-void MidiInAlsa :: openPort( unsigned int portNumber, const std::string portName )
+// Bring the table up to date.  Must be called with the cache mutex held.
+// While the monitor thread runs, it is the only one draining the
+// announcements (so that every change is reported exactly once).
+static void alsaPortCacheRefresh( snd_seq_t *querySeq, bool drain )
 {
-  if ( connected_ ) {
-    errorString_ = "MidiInAlsa::openPort: a valid connection already exists!";
-    error( RtMidiError::WARNING, errorString_ );
-    return;
+  snd_seq_t *seq = alsaPortCache.seq ? alsaPortCache.seq : querySeq;
+  bool changed = false;
+
+  if ( alsaPortCache.seq && drain ) {
+    snd_seq_event_t *ev;
+    int result;
+    while ( ( result = snd_seq_event_input( alsaPortCache.seq, &ev ) ) >= 0 || result == -ENOSPC ) {
+      if ( result == -ENOSPC ) {
+        // Some announcements were lost, the whole table must be rebuilt.
+        alsaPortCache.valid = false;
+        continue;
+      }
+      if ( !alsaPortCache.valid ) continue;
+      switch ( ev->type ) {
+      case SND_SEQ_EVENT_PORT_START:
+      case SND_SEQ_EVENT_PORT_EXIT:
+      case SND_SEQ_EVENT_PORT_CHANGE:
+        alsaPortCacheUpdate( seq, ev->data.addr.client, ev->data.addr.port );
+        changed = true;
+        break;
+      case SND_SEQ_EVENT_CLIENT_EXIT:
+      case SND_SEQ_EVENT_CLIENT_CHANGE: {
+        // Client renamed or gone: refresh all of its ports.
+        int client = ev->data.addr.client;
+        unsigned int i = alsaPortCacheFind( client, 0 );
+        std::vector<int> clientPorts;
+        for ( ; i < alsaPortCache.ports.size() && alsaPortCache.ports[i].client == client; ++i )
+          clientPorts.push_back( alsaPortCache.ports[i].port );
+        for ( i = 0; i < clientPorts.size(); ++i )
+          alsaPortCacheUpdate( seq, client, clientPorts[i] );
+        changed = true;
+        break;
+      }
+      default:
+        break;
+      }
+    }
   }
 
-  unsigned int nSrc = this->getPortCount();
-  if ( nSrc < 1 ) {
-    errorString_ = "MidiInAlsa::openPort: no MIDI input sources found!";
-    error( RtMidiError::NO_DEVICES_FOUND, errorString_ );
-    return;
+  // Without an announce subscription, nothing tells us about changes.
+  if ( !alsaPortCache.valid || !alsaPortCache.seq ) {
+    alsaPortCacheRebuild( seq );
+    alsaPortCache.valid = true;
+    changed = true;
   }
 
-  snd_seq_port_info_t *src_pinfo;
-  snd_seq_port_info_alloca( &src_pinfo );
-  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
-  if ( portInfo( data->seq, src_pinfo, SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ, (int) portNumber ) == 0 ) {
-    std::ostringstream ost;
-    ost << "MidiInAlsa::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
-    errorString_ = ost.str();
-    error( RtMidiError::INVALID_PARAMETER, errorString_ );
-    return;
+  if ( changed ) {
+    alsaPortCache.inputs.clear();
+    alsaPortCache.outputs.clear();
+    for ( unsigned int i = 0; i < alsaPortCache.ports.size(); ++i ) {
+      unsigned int caps = alsaPortCache.ports[i].caps;
+      if ( ( caps & ALSA_INPUT_CAPS ) == ALSA_INPUT_CAPS ) alsaPortCache.inputs.push_back( i );
+      if ( ( caps & ALSA_OUTPUT_CAPS ) == ALSA_OUTPUT_CAPS ) alsaPortCache.outputs.push_back( i );
+    }
   }
+}
+
+static unsigned int alsaPortCount( snd_seq_t *seq, unsigned int caps )
+{
+  pthread_mutex_lock( &alsaPortCacheMutex );
+  alsaPortCacheRefresh( seq, !alsaPortCache.monitoring );
+  unsigned int count = ( caps == ALSA_INPUT_CAPS ) ? alsaPortCache.inputs.size() : alsaPortCache.outputs.size();
+  pthread_mutex_unlock( &alsaPortCacheMutex );
+  return count;
+}
+
+// Copy the table entry of the given port number.  Returns false if there is no such port.
+static bool alsaPortLookup( snd_seq_t *seq, unsigned int caps, unsigned int portNumber, AlsaPortEntry *entry )
+{
+  pthread_mutex_lock( &alsaPortCacheMutex );
+  alsaPortCacheRefresh( seq, !alsaPortCache.monitoring );
+  const std::vector<unsigned int> &list = ( caps == ALSA_INPUT_CAPS ) ? alsaPortCache.inputs : alsaPortCache.outputs;
+  bool found = portNumber < list.size();
+  if ( found ) *entry = alsaPortCache.ports[ list[portNumber] ];
+  pthread_mutex_unlock( &alsaPortCacheMutex );
+  return found;
+}
+
+static void alsaPortNames( snd_seq_t *seq, unsigned int caps, std::vector<std::string> &names )
+{
+  pthread_mutex_lock( &alsaPortCacheMutex );
+  alsaPortCacheRefresh( seq, !alsaPortCache.monitoring );
+  const std::vector<unsigned int> &list = ( caps == ALSA_INPUT_CAPS ) ? alsaPortCache.inputs : alsaPortCache.outputs;
+  names.resize( list.size() );
+  for ( unsigned int i = 0; i < list.size(); ++i )
+    names[i] = alsaPortCache.ports[ list[i] ].name;
+  pthread_mutex_unlock( &alsaPortCacheMutex );
+}
+
+static void *alsaPortMonitor( void * )
+{
+  int poll_fd_count = snd_seq_poll_descriptors_count( alsaPortCache.seq, POLLIN ) + 1;
+  struct pollfd *poll_fds = (struct pollfd*)alloca( poll_fd_count * sizeof( struct pollfd ));
+  snd_seq_poll_descriptors( alsaPortCache.seq, poll_fds + 1, poll_fd_count - 1, POLLIN );
+  poll_fds[0].fd = alsaPortCache.trigger_fds[0];
+  poll_fds[0].events = POLLIN;
+
+  std::vector<RtMidiPortEvent> events;
+  std::vector<AlsaPortListener> listeners;
+  while ( true ) {
+    if ( poll( poll_fds, poll_fd_count, -1 ) < 0 ) continue;
+    if ( poll_fds[0].revents & POLLIN ) {
+      bool dummy;
+      int res = read( poll_fds[0].fd, &dummy, sizeof(dummy) );
+      (void) res;
+    }
+
+    pthread_mutex_lock( &alsaPortDispatchMutex );
+    pthread_mutex_lock( &alsaPortCacheMutex );
+    if ( !alsaPortCache.monitoring ) {
+      pthread_mutex_unlock( &alsaPortCacheMutex );
+      pthread_mutex_unlock( &alsaPortDispatchMutex );
+      break;
+    }
+    alsaPortCacheRefresh( 0, true );
+    events.swap( alsaPortCache.pending );
+    alsaPortCache.pending.clear();
+    listeners = alsaPortCache.listeners;
+    pthread_mutex_unlock( &alsaPortCacheMutex );
+
+    // The callbacks may query the ports, but not add or remove listeners.
+    for ( unsigned int i=0; i<events.size(); i++ )
+      for ( unsigned int j=0; j<listeners.size(); j++ )
+        listeners[j].callback( events[i], listeners[j].userData );
+    pthread_mutex_unlock( &alsaPortDispatchMutex );
+    events.clear();
+  }
+
+  return 0;
+}
+
+// Register (or replace) the port callback of the given instance, starting
+// the monitor thread for the first one.  Returns false if the sequencer
+// announcements are not available.
+static bool alsaPortCacheAddListener( MidiApi *owner, RtMidiPortCallback callback, void *userData )
+{
+  bool ok = true;
+  pthread_mutex_lock( &alsaPortDispatchMutex );
+  pthread_mutex_lock( &alsaPortCacheMutex );
+  if ( !alsaPortCache.seq ) ok = false;
+  else {
+    unsigned int i = 0;
+    while ( i < alsaPortCache.listeners.size() && alsaPortCache.listeners[i].owner != owner ) ++i;
+    if ( i == alsaPortCache.listeners.size() ) {
+      if ( !alsaPortCache.monitoring ) {
+        // Make sure the table is current before changes start being reported.
+        alsaPortCacheRefresh( 0, true );
+        if ( pipe( alsaPortCache.trigger_fds ) == -1 ) ok = false;
+        else {
+          alsaPortCache.monitoring = true;
+          if ( pthread_create( &alsaPortCache.monitorThread, NULL, alsaPortMonitor, NULL ) ) {
+            alsaPortCache.monitoring = false;
+            close( alsaPortCache.trigger_fds[0] );
+            close( alsaPortCache.trigger_fds[1] );
+            ok = false;
+          }
+        }
+      }
+      if ( ok ) alsaPortCache.listeners.push_back( AlsaPortListener() );
+    }
+    if ( ok ) {
+      alsaPortCache.listeners[i].owner = owner;
+      alsaPortCache.listeners[i].callback = callback;
+      alsaPortCache.listeners[i].userData = userData;
+    }
+  }
+  pthread_mutex_unlock( &alsaPortCacheMutex );
+  pthread_mutex_unlock( &alsaPortDispatchMutex );
+  return ok;
+}
+
+// Unregister the port callback of the given instance (if any), stopping
+// the monitor thread with the last one.
+static void alsaPortCacheRemoveListener( MidiApi *owner )
+{
+  bool stop = false;
+  pthread_mutex_lock( &alsaPortDispatchMutex );
+  pthread_mutex_lock( &alsaPortCacheMutex );
+  for ( unsigned int i=0; i<alsaPortCache.listeners.size(); i++ ) {
+    if ( alsaPortCache.listeners[i].owner == owner ) {
+      alsaPortCache.listeners.erase( alsaPortCache.listeners.begin() + i );
+      break;
+    }
+  }
+  if ( alsaPortCache.listeners.empty() && alsaPortCache.monitoring ) {
+    alsaPortCache.monitoring = false;
+    alsaPortCache.pending.clear();
+    stop = true;
+  }
+  pthread_mutex_unlock( &alsaPortCacheMutex );
+  pthread_mutex_unlock( &alsaPortDispatchMutex );
+
+  if ( stop ) {
+    bool dummy = false;
+    int res = write( alsaPortCache.trigger_fds[1], &dummy, sizeof(dummy) );
+    (void) res;
+    pthread_join( alsaPortCache.monitorThread, NULL );
+    close( alsaPortCache.trigger_fds[0] );
+    close( alsaPortCache.trigger_fds[1] );
+  }
+}
+
+unsigned int MidiInAlsa :: getPortCount()
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  return alsaPortCount( data->seq, ALSA_INPUT_CAPS );
+}
+
+std::string MidiInAlsa :: getPortName( unsigned int portNumber )
+{
+  AlsaPortEntry entry;
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( alsaPortLookup( data->seq, ALSA_INPUT_CAPS, portNumber, &entry ) )
+    return entry.name;
+
+  // If we get here, we didn't find a match.
+  errorString_ = "MidiInAlsa::getPortName: error looking for port name!";
+  error( RtMidiError::WARNING, errorString_ );
+  return std::string();
+}
+
+void MidiInAlsa :: getPortNames( std::vector<std::string> &names )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  alsaPortNames( data->seq, ALSA_INPUT_CAPS, names );
+}
+
+void MidiInAlsa :: setPortCallback( RtMidiPortCallback callback, void *userData )
+{
+  if ( !callback ) {
+    errorString_ = "MidiInAlsa::setPortCallback: callback function value is invalid!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+  if ( !alsaPortCacheAddListener( this, callback, userData ) ) {
+    errorString_ = "MidiInAlsa::setPortCallback: could not start monitoring the ALSA System:Announce port.";
+    error( RtMidiError::WARNING, errorString_ );
+  }
+}
+
+void MidiInAlsa :: cancelPortCallback( void )
+{
+  alsaPortCacheRemoveListener( this );
+}
+
+void MidiInAlsa :: openPort( unsigned int portNumber, const std::string portName )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiInAlsa::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  unsigned int nSrc = this->getPortCount();
+  if ( nSrc < 1 ) {
+    errorString_ = "MidiInAlsa::openPort: no MIDI input sources found!";
+    error( RtMidiError::NO_DEVICES_FOUND, errorString_ );
+    return;
+  }
+
+  AlsaPortEntry src;
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( !alsaPortLookup( data->seq, ALSA_INPUT_CAPS, portNumber, &src ) ) {
+    std::ostringstream ost;
+    ost << "MidiInAlsa::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+
+  snd_seq_addr_t sender, receiver;
+  sender.client = src.client;
+  sender.port = src.port;
 
-  snd_seq_addr_t sender, receiver;
-  sender.client = snd_seq_port_info_get_client( src_pinfo );
-  sender.port = snd_seq_port_info_get_port( src_pinfo );
-
   snd_seq_port_info_t *pinfo;
   snd_seq_port_info_alloca( &pinfo );
   if ( data->vport < 0 ) {
@@ -1549,6 +2392,7 @@ void MidiInAlsa :: openPort( unsigned int portNumber, const std::string portName
 #ifndef AVOID_TIMESTAMPING
     snd_seq_start_queue( data->seq, data->queue_id, NULL );
     snd_seq_drain_output( data->seq );
+    data->queueStartTime = alsaMonotonicTime();
 #endif
     // Start our MIDI input thread.
     pthread_attr_t attr;
@@ -1611,6 +2455,7 @@ void MidiInAlsa :: openVirtualPort( std::string portName )
 #ifndef AVOID_TIMESTAMPING
     snd_seq_start_queue( data->seq, data->queue_id, NULL );
     snd_seq_drain_output( data->seq );
+    data->queueStartTime = alsaMonotonicTime();
 #endif
     // Start our MIDI input thread.
     pthread_attr_t attr;
@@ -1663,11 +2508,313 @@ void MidiInAlsa :: closePort( void )
   }
 }
 
+void MidiInAlsa :: setSysexCallback( RtMidiIn::RtMidiSysexCallback callback, void *userData )
+{
+  if ( !callback ) {
+    errorString_ = "MidiInAlsa::setSysexCallback: callback function value is invalid!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  inputData_.sysexUserData = userData;
+  inputData_.sysexCallback = callback;
+}
+
+void MidiInAlsa :: setSpinPolling( unsigned int maxSpinMicroseconds )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  // The input thread restarts the adaptive spin from the new budget
+  // when it applies the reset.
+  data->pollStats.spinBudget.store( (unsigned long long) maxSpinMicroseconds * 1000, std::memory_order_relaxed );
+  data->pollStats.resetRequested.store( true, std::memory_order_release );
+}
+
+bool MidiInAlsa :: getPollingStats( RtMidiIn::PollingStats *stats )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  data->pollStats.read( stats );
+  return true;
+}
+
 //*********************************************************************//
 //  API: LINUX ALSA
 //  Class Definitions: MidiOutAlsa
 //*********************************************************************//
 
+// Asynchronous sysex output.  Messages are queued by sendSysexAsync()
+// and sent by a dedicated thread, one chunk (a variable length
+// SND_SEQ_EVENT_SYSEX event) at a time.  Before each chunk the thread
+// waits for the client output pool to have room for it, so that the
+// sequencer never refuses data and slower receivers set the pace.  The
+// last few finished messages are kept for getSysexStatus().  While
+// messages are queued, sendMessage() only lets realtime messages
+// through: the others would end the sysex on the wire, so they are
+// deferred and sent by the thread between two sysex messages.
+#define ALSA_SYSEX_DEFAULT_CHUNK 256
+#define ALSA_SYSEX_FINISHED_LIMIT 16
+
+struct AlsaSysexTransfer {
+  unsigned int id;
+  std::vector<unsigned char> bytes; // released once finished
+  size_t total;
+  size_t sent;
+  RtMidiOut::SysexStatus status;
+  RtMidiOut::RtMidiSysexProgressCallback callback;
+  void *userData;
+};
+
+// An event given to sendMessage() during a sysex transfer, encoded.
+// The sysex ones keep their bytes, the event only points to them.
+struct AlsaDeferredEvent {
+  snd_seq_event_t ev;
+  std::vector<unsigned char> sysex;
+  unsigned long long after;      // transfers queued before it, to finish before it goes out
+};
+
+struct AlsaSysexSender {
+  pthread_t thread;
+  pthread_mutex_t mutex;         // protects everything below
+  pthread_mutex_t outputMutex;   // serializes the use of the output sequencer handle
+  int trigger_fds[2];            // wakes the thread up on new messages, cancellation or stop
+  bool running;
+  unsigned int chunkSize;
+  unsigned int interval;         // microseconds between two chunks
+  unsigned int nextId;
+  unsigned long long queued;     // transfers queued so far
+  unsigned long long ended;      // transfers done, failed or cancelled so far
+  std::deque<AlsaSysexTransfer *> pending;  // front one is being sent
+  std::deque<AlsaSysexTransfer *> finished;
+  std::deque<AlsaDeferredEvent> deferred;   // sendMessage() events waiting for the end of a sysex message
+};
+
+// Whether the output pool can take a sysex event of the given size.  In
+// the kernel, a variable length event uses one cell for the event plus
+// one for each sizeof(snd_seq_event_t) bytes of data.
+static bool alsaOutputRoom( snd_seq_t *seq, size_t bytes )
+{
+  snd_seq_client_pool_t *pool;
+  snd_seq_client_pool_alloca( &pool );
+  if ( snd_seq_get_client_pool( seq, pool ) < 0 ) return true;
+  size_t cells = 1 + ( bytes + sizeof( snd_seq_event_t ) - 1 ) / sizeof( snd_seq_event_t );
+  size_t total = snd_seq_client_pool_get_output_pool( pool );
+  if ( cells > total ) cells = total; // never fits, send it through an empty pool
+  return snd_seq_client_pool_get_output_free( pool ) >= cells;
+}
+
+// Wait until the trigger fires, the timeout expires (-1 = forever) or,
+// if waitOutput is set, the output pool has room.
+static void alsaSysexWait( AlsaMidiData *data, bool waitOutput, int timeout )
+{
+  AlsaSysexSender *sender = data->sender;
+  int poll_fd_count = 1;
+  if ( waitOutput ) poll_fd_count += snd_seq_poll_descriptors_count( data->seq, POLLOUT );
+  struct pollfd *poll_fds = (struct pollfd*)alloca( poll_fd_count * sizeof( struct pollfd ));
+  if ( waitOutput ) snd_seq_poll_descriptors( data->seq, poll_fds + 1, poll_fd_count - 1, POLLOUT );
+  poll_fds[0].fd = sender->trigger_fds[0];
+  poll_fds[0].events = POLLIN;
+  if ( poll( poll_fds, poll_fd_count, timeout ) > 0 && ( poll_fds[0].revents & POLLIN ) ) {
+    bool dummy;
+    int res = read( poll_fds[0].fd, &dummy, sizeof(dummy) );
+    (void) res;
+  }
+}
+
+static void alsaSysexWake( AlsaSysexSender *sender )
+{
+  bool dummy = false;
+  int res = write( sender->trigger_fds[1], &dummy, sizeof(dummy) );
+  (void) res;
+}
+
+// Output one sysex event, without blocking.
+static int alsaSysexOutput( AlsaMidiData *data, const unsigned char *bytes, size_t size )
+{
+  snd_seq_event_t ev;
+  snd_seq_ev_clear( &ev );
+  snd_seq_ev_set_source( &ev, data->vport );
+  snd_seq_ev_set_subs( &ev );
+  snd_seq_ev_set_direct( &ev );
+  snd_seq_ev_set_sysex( &ev, size, (void *) bytes );
+  pthread_mutex_lock( &data->sender->outputMutex );
+  int result = snd_seq_event_output_direct( data->seq, &ev );
+  pthread_mutex_unlock( &data->sender->outputMutex );
+  return result;
+}
+
+// Output an encoded sendMessage() event, as sendMessage() does.
+static int alsaEventOutput( AlsaMidiData *data, snd_seq_event_t *ev )
+{
+  pthread_mutex_lock( &data->sender->outputMutex );
+  int result = snd_seq_event_output( data->seq, ev );
+  if ( result >= 0 ) snd_seq_drain_output( data->seq );
+  pthread_mutex_unlock( &data->sender->outputMutex );
+  return result;
+}
+
+// Output, in order, the deferred events whose preceding transfers have
+// all ended.  Called with the sender mutex held, so that sendMessage()
+// keeps deferring until they are out.
+static void alsaDeferredFlush( AlsaMidiData *data )
+{
+  AlsaSysexSender *sender = data->sender;
+  while ( !sender->deferred.empty() && sender->deferred.front().after <= sender->ended ) {
+    AlsaDeferredEvent &deferred = sender->deferred.front();
+    if ( !deferred.sysex.empty() ) snd_seq_ev_set_sysex( &deferred.ev, deferred.sysex.size(), &deferred.sysex[0] );
+    alsaEventOutput( data, &deferred.ev );
+    sender->deferred.pop_front();
+  }
+}
+
+static void *alsaSysexSend( void *ptr )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (ptr);
+  AlsaSysexSender *sender = data->sender;
+  static const unsigned char sysexEnd = 0xF7;
+  unsigned long long nextChunkTime = 0;
+
+  pthread_mutex_lock( &sender->mutex );
+  while ( sender->running ) {
+    // Between two sysex messages, send what sendMessage() deferred once
+    // the transfers queued before it have ended, keeping the caller order.
+    alsaDeferredFlush( data );
+
+    if ( sender->pending.empty() ) {
+      pthread_mutex_unlock( &sender->mutex );
+      alsaSysexWait( data, false, -1 );
+      pthread_mutex_lock( &sender->mutex );
+      continue;
+    }
+
+    // Only this thread removes or deletes transfers, so the front one
+    // can be used unlocked, except for its status and progress.
+    AlsaSysexTransfer *transfer = sender->pending.front();
+    size_t size = transfer->total - transfer->sent;
+    if ( size > sender->chunkSize ) size = sender->chunkSize;
+    nextChunkTime += sender->interval * 1000ULL;
+    bool cancelled = ( transfer->status == RtMidiOut::SYSEX_CANCELLED );
+    pthread_mutex_unlock( &sender->mutex );
+
+    int result = 0;
+    if ( cancelled ) {
+      // Terminate a partially sent message, so that receivers resynchronize.
+      if ( transfer->sent > 0 ) alsaSysexOutput( data, &sysexEnd, 1 );
+    }
+    else {
+      unsigned long long now = alsaMonotonicTime();
+      if ( now < nextChunkTime ) {
+        alsaSysexWait( data, false, (int) ( ( nextChunkTime - now + 999999 ) / 1000000 ) );
+        result = -EAGAIN;
+      }
+      else if ( !alsaOutputRoom( data->seq, size ) ) {
+        alsaSysexWait( data, true, 10 );
+        result = -EAGAIN;
+      }
+      else {
+        result = alsaSysexOutput( data, &transfer->bytes[transfer->sent], size );
+        if ( result == -EAGAIN ) alsaSysexWait( data, true, 10 );
+        else nextChunkTime = now;
+      }
+    }
+
+    pthread_mutex_lock( &sender->mutex );
+    if ( result == -EAGAIN ) {
+      nextChunkTime -= sender->interval * 1000ULL;
+      continue;
+    }
+    if ( result < 0 )
+      transfer->status = RtMidiOut::SYSEX_FAILED;
+    else if ( !cancelled ) {
+      transfer->sent += size;
+      if ( transfer->sent == transfer->total ) transfer->status = RtMidiOut::SYSEX_DONE;
+      else if ( transfer->status != RtMidiOut::SYSEX_CANCELLED ) transfer->status = RtMidiOut::SYSEX_SENDING;
+    }
+
+    // A message cancelled meanwhile is terminated on the next round.
+    bool finished = ( cancelled || transfer->status == RtMidiOut::SYSEX_DONE ||
+                      transfer->status == RtMidiOut::SYSEX_FAILED );
+    unsigned int id = transfer->id;
+    size_t sent = transfer->sent;
+    size_t total = transfer->total;
+    int status = transfer->status;
+    RtMidiOut::RtMidiSysexProgressCallback callback = transfer->callback;
+    void *userData = transfer->userData;
+    if ( finished ) {
+      sender->pending.pop_front();
+      sender->ended++;
+      std::vector<unsigned char>().swap( transfer->bytes );
+      sender->finished.push_back( transfer );
+      if ( sender->finished.size() > ALSA_SYSEX_FINISHED_LIMIT ) {
+        delete sender->finished.front();
+        sender->finished.pop_front();
+      }
+    }
+    pthread_mutex_unlock( &sender->mutex );
+
+    if ( callback && ( finished || status == RtMidiOut::SYSEX_SENDING ) )
+      callback( id, sent, total, status, userData );
+    pthread_mutex_lock( &sender->mutex );
+  }
+  pthread_mutex_unlock( &sender->mutex );
+
+  return 0;
+}
+
+// Create the sender (without starting its thread) if needed.
+static bool alsaSysexSenderCreate( AlsaMidiData *data )
+{
+  if ( data->sender ) return true;
+  AlsaSysexSender *sender = new AlsaSysexSender;
+  if ( pipe( sender->trigger_fds ) == -1 ) {
+    delete sender;
+    return false;
+  }
+  pthread_mutex_init( &sender->mutex, NULL );
+  pthread_mutex_init( &sender->outputMutex, NULL );
+  sender->running = false;
+  sender->chunkSize = ALSA_SYSEX_DEFAULT_CHUNK;
+  sender->interval = 0;
+  sender->nextId = 1;
+  sender->queued = 0;
+  sender->ended = 0;
+  data->sender = sender;
+  return true;
+}
+
+// Stop the sending thread, reporting the messages not sent as cancelled.
+static void alsaSysexSenderStop( AlsaMidiData *data )
+{
+  AlsaSysexSender *sender = data->sender;
+  if ( !sender ) return;
+
+  pthread_mutex_lock( &sender->mutex );
+  bool running = sender->running;
+  sender->running = false;
+  pthread_mutex_unlock( &sender->mutex );
+  if ( running ) {
+    alsaSysexWake( sender );
+    pthread_join( sender->thread, NULL );
+  }
+
+  for ( unsigned int i=0; i<sender->pending.size(); i++ ) {
+    AlsaSysexTransfer *transfer = sender->pending[i];
+    if ( transfer->callback )
+      transfer->callback( transfer->id, transfer->sent, transfer->total,
+                          RtMidiOut::SYSEX_CANCELLED, transfer->userData );
+    delete transfer;
+    sender->ended++;
+  }
+  sender->pending.clear();
+  for ( unsigned int i=0; i<sender->finished.size(); i++ ) delete sender->finished[i];
+  // No sysex is left open, the deferred events can go out now.
+  alsaDeferredFlush( data );
+  close( sender->trigger_fds[0] );
+  close( sender->trigger_fds[1] );
+  pthread_mutex_destroy( &sender->mutex );
+  pthread_mutex_destroy( &sender->outputMutex );
+  delete sender;
+  data->sender = 0;
+}
+
 MidiOutAlsa :: MidiOutAlsa( const std::string clientName ) : MidiOutApi()
 {
   initialize( clientName );
@@ -1675,16 +2822,22 @@ MidiOutAlsa :: MidiOutAlsa( const std::string clientName ) : MidiOutApi()
 
 MidiOutAlsa :: ~MidiOutAlsa()
 {
+  // Nothing to clean up if the initialization failed.
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( !data ) return;
+
   // Close a connection if it exists.
   closePort();
 
   // Cleanup.
-  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  alsaSysexSenderStop( data );
   if ( data->vport >= 0 ) snd_seq_delete_port( data->seq, data->vport );
   if ( data->coder ) snd_midi_event_free( data->coder );
   if ( data->buffer ) free( data->buffer );
   snd_seq_close( data->seq );
   delete data;
+  alsaPortCacheRemoveListener( this );
+  alsaPortCacheDetach();
 }
 
 void MidiOutAlsa :: initialize( const std::string& clientName )
@@ -1709,6 +2862,7 @@ void MidiOutAlsa :: initialize( const std::string& clientName )
   data->bufferSize = 32;
   data->coder = 0;
   data->buffer = 0;
+  data->sender = 0;
   int result = snd_midi_event_new( data->bufferSize, &data->coder );
   if ( result < 0 ) {
     delete data;
@@ -1725,43 +2879,50 @@ void MidiOutAlsa :: initialize( const std::string& clientName )
   }
   snd_midi_event_init( data->coder );
   apiData_ = (void *) data;
+  alsaPortCacheAttach();
 }
 
 unsigned int MidiOutAlsa :: getPortCount()
 {
-	snd_seq_port_info_t *pinfo;
-	snd_seq_port_info_alloca( &pinfo );
-
   AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
-  return portInfo( data->seq, pinfo, SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE, -1 );
+  return alsaPortCount( data->seq, ALSA_OUTPUT_CAPS );
 }
 
 std::string MidiOutAlsa :: getPortName( unsigned int portNumber )
 {
-  snd_seq_client_info_t *cinfo;
-  snd_seq_port_info_t *pinfo;
-  snd_seq_client_info_alloca( &cinfo );
-  snd_seq_port_info_alloca( &pinfo );
-
-  std::string stringName;
+  AlsaPortEntry entry;
   AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
-  if ( portInfo( data->seq, pinfo, SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE, (int) portNumber ) ) {
-    int cnum = snd_seq_port_info_get_client(pinfo);
-    snd_seq_get_any_client_info( data->seq, cnum, cinfo );
-    std::ostringstream os;
-    os << snd_seq_client_info_get_name(cinfo);
-    os << " ";                                    // These lines added to make sure devices are listed
-    os << snd_seq_port_info_get_client( pinfo );  // with full portnames added to ensure individual device names
-    os << ":";
-    os << snd_seq_port_info_get_port(pinfo);
-    stringName = os.str();
-    return stringName;
-  }
+  if ( alsaPortLookup( data->seq, ALSA_OUTPUT_CAPS, portNumber, &entry ) )
+    return entry.name;
 
   // If we get here, we didn't find a match.
   errorString_ = "MidiOutAlsa::getPortName: error looking for port name!";
   error( RtMidiError::WARNING, errorString_ );
-  return stringName;
+  return std::string();
+}
+
+void MidiOutAlsa :: getPortNames( std::vector<std::string> &names )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  alsaPortNames( data->seq, ALSA_OUTPUT_CAPS, names );
+}
+
+void MidiOutAlsa :: setPortCallback( RtMidiPortCallback callback, void *userData )
+{
+  if ( !callback ) {
+    errorString_ = "MidiOutAlsa::setPortCallback: callback function value is invalid!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+  if ( !alsaPortCacheAddListener( this, callback, userData ) ) {
+    errorString_ = "MidiOutAlsa::setPortCallback: could not start monitoring the ALSA System:Announce port.";
+    error( RtMidiError::WARNING, errorString_ );
+  }
+}
+
+void MidiOutAlsa :: cancelPortCallback( void )
+{
+  alsaPortCacheRemoveListener( this );
 }
 
 void MidiOutAlsa :: openPort( unsigned int portNumber, const std::string portName )
@@ -1779,10 +2940,9 @@ void MidiOutAlsa :: openPort( unsigned int portNumber, const std::string portNam
     return;
   }
 
-	snd_seq_port_info_t *pinfo;
-	snd_seq_port_info_alloca( &pinfo );
+  AlsaPortEntry dest;
   AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
-  if ( portInfo( data->seq, pinfo, SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE, (int) portNumber ) == 0 ) {
+  if ( !alsaPortLookup( data->seq, ALSA_OUTPUT_CAPS, portNumber, &dest ) ) {
     std::ostringstream ost;
     ost << "MidiOutAlsa::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
     errorString_ = ost.str();
@@ -1791,8 +2951,8 @@ void MidiOutAlsa :: openPort( unsigned int portNumber, const std::string portNam
   }
 
   snd_seq_addr_t sender, receiver;
-  receiver.client = snd_seq_port_info_get_client( pinfo );
-  receiver.port = snd_seq_port_info_get_port( pinfo );
+  receiver.client = dest.client;
+  receiver.port = dest.port;
   sender.client = snd_seq_client_id( data->seq );
 
   if ( data->vport < 0 ) {
@@ -1890,32 +3050,657 @@ void MidiOutAlsa :: sendMessage( std::vector<unsigned char> *message )
   }
 
   // Send the event.
-  result = snd_seq_event_output(data->seq, &ev);
+  AlsaSysexSender *sender = data->sender;
+  if ( sender ) {
+    pthread_mutex_lock( &sender->mutex );
+    // A sysex message is going out in chunks: anything but a realtime
+    // message would end it on the wire, so it waits for its end.
+    if ( ( !sender->pending.empty() || !sender->deferred.empty() ) && nBytes > 0 && message->at(0) < 0xF8 ) {
+      AlsaDeferredEvent deferred;
+      deferred.ev = ev;
+      if ( message->at(0) == 0xF0 ) deferred.sysex.assign( data->buffer, data->buffer + nBytes );
+      deferred.after = sender->queued;
+      sender->deferred.push_back( deferred );
+      pthread_mutex_unlock( &sender->mutex );
+      alsaSysexWake( sender );
+      return;
+    }
+    result = alsaEventOutput( data, &ev );
+    pthread_mutex_unlock( &sender->mutex );
+  }
+  else {
+    result = snd_seq_event_output(data->seq, &ev);
+    if ( result >= 0 ) snd_seq_drain_output(data->seq);
+  }
   if ( result < 0 ) {
     errorString_ = "MidiOutAlsa::sendMessage: error sending MIDI message to port.";
     error( RtMidiError::WARNING, errorString_ );
     return;
   }
-  snd_seq_drain_output(data->seq);
 }
 
-#endif // __LINUX_ALSA__
-
+unsigned int MidiOutAlsa :: sendSysexAsync( const std::vector<unsigned char> &message,
+                                            RtMidiOut::RtMidiSysexProgressCallback callback, void *userData )
+{
+  if ( message.size() < 2 || message.front() != 0xF0 || message.back() != 0xF7 ) {
+    errorString_ = "MidiOutAlsa::sendSysexAsync: the message is not a complete sysex message (0xF0 ... 0xF7).";
+    error( RtMidiError::WARNING, errorString_ );
+    return 0;
+  }
 
-//*********************************************************************//
-//  API: Windows Multimedia Library (MM)
-//*********************************************************************//
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( !alsaSysexSenderCreate( data ) ) {
+    errorString_ = "MidiOutAlsa::sendSysexAsync: error creating pipe objects.";
+    error( RtMidiError::WARNING, errorString_ );
+    return 0;
+  }
 
-// API information deciphered from:
-//  - http://msdn.microsoft.com/library/default.asp?url=/library/en-us/multimed/htm/_win32_midi_reference.asp
+  AlsaSysexSender *sender = data->sender;
+  AlsaSysexTransfer *transfer = new AlsaSysexTransfer;
+  transfer->bytes = message;
+  transfer->total = message.size();
+  transfer->sent = 0;
+  transfer->status = RtMidiOut::SYSEX_QUEUED;
+  transfer->callback = callback;
+  transfer->userData = userData;
+
+  pthread_mutex_lock( &sender->mutex );
+  if ( !sender->running ) {
+    sender->running = true;
+    if ( pthread_create( &sender->thread, NULL, alsaSysexSend, data ) ) {
+      sender->running = false;
+      pthread_mutex_unlock( &sender->mutex );
+      delete transfer;
+      errorString_ = "MidiOutAlsa::sendSysexAsync: error starting the sysex output thread!";
+      error( RtMidiError::WARNING, errorString_ );
+      return 0;
+    }
+  }
+  transfer->id = sender->nextId++;
+  if ( sender->nextId == 0 ) sender->nextId = 1;
+  sender->pending.push_back( transfer );
+  sender->queued++;
+  unsigned int id = transfer->id;
+  pthread_mutex_unlock( &sender->mutex );
+
+  alsaSysexWake( sender );
+  return id;
+}
 
-// Thanks to Jean-Baptiste Berruchon for the sysex code.
+void MidiOutAlsa :: setSysexPacing( unsigned int chunkSize, unsigned int intervalMicroseconds )
+{
+  if ( chunkSize == 0 ) {
+    errorString_ = "MidiOutAlsa::setSysexPacing: the chunk size must be greater than 0.";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
 
-#if defined(__WINDOWS_MM__)
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( !alsaSysexSenderCreate( data ) ) {
+    errorString_ = "MidiOutAlsa::setSysexPacing: error creating pipe objects.";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+  pthread_mutex_lock( &data->sender->mutex );
+  data->sender->chunkSize = chunkSize;
+  data->sender->interval = intervalMicroseconds;
+  pthread_mutex_unlock( &data->sender->mutex );
+}
 
-// The Windows MM API is based on the use of a callback function for
-// MIDI input.  We convert the system specific time stamps to delta
-// time values.
+RtMidiOut::SysexStatus MidiOutAlsa :: getSysexStatus( unsigned int id, size_t *sent, size_t *total )
+{
+  RtMidiOut::SysexStatus status = RtMidiOut::SYSEX_UNKNOWN;
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  AlsaSysexSender *sender = data->sender;
+  if ( !sender ) return status;
+
+  pthread_mutex_lock( &sender->mutex );
+  for ( int list=0; list<2 && status == RtMidiOut::SYSEX_UNKNOWN; list++ ) {
+    const std::deque<AlsaSysexTransfer *> &transfers = list ? sender->finished : sender->pending;
+    for ( unsigned int i=0; i<transfers.size(); i++ ) {
+      if ( transfers[i]->id != id ) continue;
+      status = transfers[i]->status;
+      if ( sent ) *sent = transfers[i]->sent;
+      if ( total ) *total = transfers[i]->total;
+      break;
+    }
+  }
+  pthread_mutex_unlock( &sender->mutex );
+  return status;
+}
+
+void MidiOutAlsa :: cancelSysex( unsigned int id )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  AlsaSysexSender *sender = data->sender;
+  if ( !sender ) return;
+
+  pthread_mutex_lock( &sender->mutex );
+  for ( unsigned int i=0; i<sender->pending.size(); i++ ) {
+    if ( id == 0 || sender->pending[i]->id == id )
+      sender->pending[i]->status = RtMidiOut::SYSEX_CANCELLED;
+  }
+  pthread_mutex_unlock( &sender->mutex );
+  alsaSysexWake( sender );
+}
+
+
+//*********************************************************************//
+//  API: LINUX ALSA RAWMIDI
+//  Class Definitions: MidiInAlsaRaw, MidiOutAlsaRaw
+//*********************************************************************//
+
+// The rawmidi interface gives direct access to the hardware MIDI ports,
+// as byte streams.  This skips the sequencer event encoding/decoding
+// and its kernel routing, at the cost of exclusive access to the device
+// (other clients cannot open it meanwhile), no virtual ports and no
+// kernel timestamps: incoming messages are stamped when read.
+
+struct AlsaRawPort {
+  std::string device; // "hw:card,device,subdevice"
+  std::string name;
+};
+
+// Running status aware MIDI byte stream parser.
+struct AlsaRawParser {
+  unsigned char runningStatus; // 0 if none
+  unsigned int expected;       // length of the message being collected
+  bool inSysex;
+  std::vector<unsigned char> bytes;
+
+  AlsaRawParser() : runningStatus(0), expected(0), inSysex(false) {}
+};
+
+struct AlsaRawMidiData {
+  snd_rawmidi_t *handle;
+  pthread_t thread;
+  pthread_t dummy_thread_id;
+  int trigger_fds[2];
+  unsigned long long lastTime;
+  AlsaRawParser parser;
+};
+
+// List the rawmidi subdevices of all the cards for the given direction.
+static void alsaRawPorts( snd_rawmidi_stream_t stream, std::vector<AlsaRawPort> &ports )
+{
+  ports.clear();
+  snd_rawmidi_info_t *info;
+  snd_rawmidi_info_alloca( &info );
+  int card = -1;
+  while ( snd_card_next( &card ) >= 0 && card >= 0 ) {
+    snd_ctl_t *ctl;
+    char name[32];
+    sprintf( name, "hw:%d", card );
+    if ( snd_ctl_open( &ctl, name, 0 ) < 0 ) continue;
+
+    int device = -1;
+    while ( snd_ctl_rawmidi_next_device( ctl, &device ) >= 0 && device >= 0 ) {
+      snd_rawmidi_info_set_device( info, device );
+      snd_rawmidi_info_set_stream( info, stream );
+      snd_rawmidi_info_set_subdevice( info, 0 );
+      if ( snd_ctl_rawmidi_info( ctl, info ) < 0 ) continue;
+      unsigned int count = snd_rawmidi_info_get_subdevices_count( info );
+      for ( unsigned int sub=0; sub<count; sub++ ) {
+        snd_rawmidi_info_set_subdevice( info, sub );
+        if ( snd_ctl_rawmidi_info( ctl, info ) < 0 ) continue;
+        std::ostringstream os;
+        os << "hw:" << card << "," << device << "," << sub;
+        AlsaRawPort port;
+        port.device = os.str();
+        const char *subName = snd_rawmidi_info_get_subdevice_name( info );
+        port.name = ( subName && subName[0] ) ? subName : snd_rawmidi_info_get_name( info );
+        port.name += " " + port.device;
+        ports.push_back( port );
+      }
+    }
+    snd_ctl_close( ctl );
+  }
+}
+
+// Length of a channel or system common message, from its status byte.
+static unsigned int alsaRawMessageLength( unsigned char status )
+{
+  if ( status < 0xF0 ) return ( ( status & 0xE0 ) == 0xC0 ) ? 2 : 3;
+  switch ( status ) {
+  case 0xF1:
+  case 0xF3: return 2;
+  case 0xF2: return 3;
+  default: return 1;
+  }
+}
+
+static void alsaRawDispatch( MidiInApi::RtMidiInData *data, const unsigned char *bytes, size_t size, double timeStamp )
+{
+  // Filter the ignored types.
+  if ( ( bytes[0] == 0xF0 && ( data->ignoreFlags & 0x01 ) ) ||
+       ( ( bytes[0] == 0xF1 || bytes[0] == 0xF8 ) && ( data->ignoreFlags & 0x02 ) ) ||
+       ( bytes[0] == 0xFE && ( data->ignoreFlags & 0x04 ) ) )
+    return;
+
+  MidiInApi::MidiMessage &message = data->message;
+  message.bytes.assign( bytes, bytes + size );
+  message.timeStamp = timeStamp;
+  midiTrace( MIDI_TRACE_DECODE, message.bytes.empty() ? 0 : message.bytes[0] );
+  data->countReceived();
+  if ( data->enterCallback() ) {
+    RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
+    callback( message.timeStamp, &message.bytes, data->userData );
+    data->leaveCallback();
+  }
+  else {
+    // As long as we haven't reached our queue size limit, push the message.
+    if ( data->queue.size < data->queue.ringSize ) {
+      data->queue.ring[data->queue.back++] = message;
+      if ( data->queue.back == data->queue.ringSize )
+        data->queue.back = 0;
+      data->queue.size++;
+      data->countQueued();
+    }
+    else {
+      data->countQueueDrop();
+      std::cerr << "\nMidiInAlsaRaw: message queue limit reached!!\n\n";
+    }
+  }
+}
+
+// Feed the parser with bytes read at the given (monotonic) time.
+static void alsaRawParse( MidiInApi::RtMidiInData *data, const unsigned char *bytes, size_t size,
+                          unsigned long long time )
+{
+  AlsaRawMidiData *apiData = static_cast<AlsaRawMidiData *> (data->apiData);
+  AlsaRawParser &parser = apiData->parser;
+
+  // All the messages completed by one read share its time stamp.
+  double timeStamp = 0.0;
+  if ( data->firstMessage == false )
+    timeStamp = ( time - apiData->lastTime ) * 0.000000001;
+
+  for ( size_t i=0; i<size; i++ ) {
+    unsigned char byte = bytes[i];
+    bool complete = false;
+
+    if ( byte >= 0xF8 ) {
+      // Real-time messages may appear anywhere, even within other messages.
+      if ( byte == 0xF9 || byte == 0xFD ) continue; // undefined
+      data->firstMessage = false;
+      apiData->lastTime = time;
+      alsaRawDispatch( data, &byte, 1, timeStamp );
+      timeStamp = 0.0;
+      continue;
+    }
+
+    if ( byte == 0xF7 ) {
+      if ( !parser.inSysex ) continue;
+      parser.bytes.push_back( byte );
+      parser.inSysex = false;
+      complete = true;
+    }
+    else if ( byte & 0x80 ) {
+      // Any other status byte ends a sysex message.  An unterminated
+      // one is dropped.
+#if defined(__RTMIDI_DEBUG__)
+      if ( parser.inSysex )
+        std::cerr << "\nMidiInAlsaRaw::alsaRawParse: unterminated sysex message dropped!\n\n";
+#endif
+      parser.inSysex = ( byte == 0xF0 );
+      // System messages cancel running status.
+      parser.runningStatus = ( byte < 0xF0 ) ? byte : 0;
+      parser.expected = parser.inSysex ? 0 : alsaRawMessageLength( byte );
+      parser.bytes.assign( 1, byte );
+      complete = ( parser.expected == 1 );
+      if ( complete && ( byte == 0xF4 || byte == 0xF5 ) ) { // undefined
+        parser.bytes.clear();
+        continue;
+      }
+    }
+    else if ( parser.inSysex ) {
+      parser.bytes.push_back( byte );
+    }
+    else {
+      if ( parser.bytes.empty() ) {
+        // A data byte without status: use the running status, if any.
+        if ( !parser.runningStatus ) continue;
+        parser.bytes.push_back( parser.runningStatus );
+        parser.expected = alsaRawMessageLength( parser.runningStatus );
+      }
+      parser.bytes.push_back( byte );
+      complete = ( parser.bytes.size() == parser.expected );
+    }
+
+    if ( complete ) {
+      data->firstMessage = false;
+      apiData->lastTime = time;
+      alsaRawDispatch( data, &parser.bytes[0], parser.bytes.size(), timeStamp );
+      timeStamp = 0.0;
+      parser.bytes.clear();
+    }
+  }
+}
+
+static void *alsaRawMidiHandler( void *ptr )
+{
+  MidiInApi::RtMidiInData *data = static_cast<MidiInApi::RtMidiInData *> (ptr);
+  AlsaRawMidiData *apiData = static_cast<AlsaRawMidiData *> (data->apiData);
+
+  int poll_fd_count = snd_rawmidi_poll_descriptors_count( apiData->handle ) + 1;
+  struct pollfd *poll_fds = (struct pollfd*)alloca( poll_fd_count * sizeof( struct pollfd ));
+  snd_rawmidi_poll_descriptors( apiData->handle, poll_fds + 1, poll_fd_count - 1 );
+  poll_fds[0].fd = apiData->trigger_fds[0];
+  poll_fds[0].events = POLLIN;
+
+  unsigned char buffer[256];
+  while ( data->doInput ) {
+    if ( poll( poll_fds, poll_fd_count, -1 ) < 0 ) continue;
+    if ( poll_fds[0].revents & POLLIN ) {
+      bool dummy;
+      int res = read( poll_fds[0].fd, &dummy, sizeof(dummy) );
+      (void) res;
+      continue;
+    }
+
+    ssize_t nBytes;
+    while ( ( nBytes = snd_rawmidi_read( apiData->handle, buffer, sizeof(buffer) ) ) > 0 ) {
+      midiTrace( MIDI_TRACE_INGRESS, (unsigned int) nBytes );
+      alsaRawParse( data, buffer, nBytes, alsaMonotonicTime() );
+    }
+    if ( nBytes < 0 && nBytes != -EAGAIN ) {
+      std::cerr << "\nMidiInAlsaRaw::alsaRawMidiHandler: error reading from the device, input stopped!\n\n";
+      break;
+    }
+  }
+
+  apiData->thread = apiData->dummy_thread_id;
+  return 0;
+}
+
+MidiInAlsaRaw :: MidiInAlsaRaw( const std::string clientName, unsigned int queueSizeLimit ) : MidiInApi( queueSizeLimit )
+{
+  initialize( clientName );
+}
+
+MidiInAlsaRaw :: ~MidiInAlsaRaw()
+{
+  // Close a connection if it exists.
+  closePort();
+
+  // Cleanup.
+  AlsaRawMidiData *data = static_cast<AlsaRawMidiData *> (apiData_);
+  close ( data->trigger_fds[0] );
+  close ( data->trigger_fds[1] );
+  delete data;
+}
+
+void MidiInAlsaRaw :: initialize( const std::string& /*clientName*/ )
+{
+  // Save our api-specific connection information.
+  AlsaRawMidiData *data = (AlsaRawMidiData *) new AlsaRawMidiData;
+  data->handle = 0;
+  data->dummy_thread_id = pthread_self();
+  data->thread = data->dummy_thread_id;
+  data->lastTime = 0;
+  if ( pipe( data->trigger_fds ) == -1 ) {
+    delete data;
+    errorString_ = "MidiInAlsaRaw::initialize: error creating pipe objects.";
+    error( RtMidiError::DRIVER_ERROR, errorString_ );
+    return;
+  }
+  apiData_ = (void *) data;
+  inputData_.apiData = (void *) data;
+}
+
+unsigned int MidiInAlsaRaw :: getPortCount()
+{
+  std::vector<AlsaRawPort> ports;
+  alsaRawPorts( SND_RAWMIDI_STREAM_INPUT, ports );
+  return ports.size();
+}
+
+std::string MidiInAlsaRaw :: getPortName( unsigned int portNumber )
+{
+  std::vector<AlsaRawPort> ports;
+  alsaRawPorts( SND_RAWMIDI_STREAM_INPUT, ports );
+  if ( portNumber < ports.size() )
+    return ports[portNumber].name;
+
+  // If we get here, we didn't find a match.
+  errorString_ = "MidiInAlsaRaw::getPortName: error looking for port name!";
+  error( RtMidiError::WARNING, errorString_ );
+  return std::string();
+}
+
+void MidiInAlsaRaw :: getPortNames( std::vector<std::string> &names )
+{
+  std::vector<AlsaRawPort> ports;
+  alsaRawPorts( SND_RAWMIDI_STREAM_INPUT, ports );
+  names.resize( ports.size() );
+  for ( unsigned int i=0; i<ports.size(); i++ ) names[i] = ports[i].name;
+}
+
+void MidiInAlsaRaw :: openPort( unsigned int portNumber, const std::string /*portName*/ )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiInAlsaRaw::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  std::vector<AlsaRawPort> ports;
+  alsaRawPorts( SND_RAWMIDI_STREAM_INPUT, ports );
+  if ( ports.size() < 1 ) {
+    errorString_ = "MidiInAlsaRaw::openPort: no MIDI input sources found!";
+    error( RtMidiError::NO_DEVICES_FOUND, errorString_ );
+    return;
+  }
+  if ( portNumber >= ports.size() ) {
+    std::ostringstream ost;
+    ost << "MidiInAlsaRaw::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+
+  AlsaRawMidiData *data = static_cast<AlsaRawMidiData *> (apiData_);
+  if ( snd_rawmidi_open( &data->handle, NULL, ports[portNumber].device.c_str(), SND_RAWMIDI_NONBLOCK ) < 0 ) {
+    data->handle = 0;
+    errorString_ = "MidiInAlsaRaw::openPort: error opening ALSA rawmidi device " + ports[portNumber].device + " (is it in use?).";
+    error( RtMidiError::DRIVER_ERROR, errorString_ );
+    return;
+  }
+
+  data->parser = AlsaRawParser();
+  inputData_.firstMessage = true;
+
+  // Start our MIDI input thread.
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+
+  inputData_.doInput = true;
+  int err = pthread_create(&data->thread, &attr, alsaRawMidiHandler, &inputData_);
+  pthread_attr_destroy(&attr);
+  if ( err ) {
+    snd_rawmidi_close( data->handle );
+    data->handle = 0;
+    inputData_.doInput = false;
+    errorString_ = "MidiInAlsaRaw::openPort: error starting MIDI input thread!";
+    error( RtMidiError::THREAD_ERROR, errorString_ );
+    return;
+  }
+
+  connected_ = true;
+}
+
+void MidiInAlsaRaw :: openVirtualPort( const std::string /*portName*/ )
+{
+  // This function cannot be implemented for the ALSA rawmidi API.
+  errorString_ = "MidiInAlsaRaw::openVirtualPort: cannot be implemented in ALSA rawmidi API!";
+  error( RtMidiError::WARNING, errorString_ );
+}
+
+void MidiInAlsaRaw :: closePort( void )
+{
+  AlsaRawMidiData *data = static_cast<AlsaRawMidiData *> (apiData_);
+
+  // Stop thread to avoid triggering the callback, while the port is intended to be closed
+  if ( inputData_.doInput ) {
+    inputData_.doInput = false;
+    int res = write( data->trigger_fds[1], &inputData_.doInput, sizeof(inputData_.doInput) );
+    (void) res;
+    if ( !pthread_equal(data->thread, data->dummy_thread_id) )
+      pthread_join( data->thread, NULL );
+  }
+
+  if ( connected_ ) {
+    snd_rawmidi_close( data->handle );
+    data->handle = 0;
+    connected_ = false;
+  }
+}
+
+MidiOutAlsaRaw :: MidiOutAlsaRaw( const std::string clientName ) : MidiOutApi()
+{
+  initialize( clientName );
+}
+
+MidiOutAlsaRaw :: ~MidiOutAlsaRaw()
+{
+  // Close a connection if it exists.
+  closePort();
+
+  // Cleanup.
+  AlsaRawMidiData *data = static_cast<AlsaRawMidiData *> (apiData_);
+  delete data;
+}
+
+void MidiOutAlsaRaw :: initialize( const std::string& /*clientName*/ )
+{
+  // Save our api-specific connection information.
+  AlsaRawMidiData *data = (AlsaRawMidiData *) new AlsaRawMidiData;
+  data->handle = 0;
+  data->trigger_fds[0] = -1;
+  data->trigger_fds[1] = -1;
+  apiData_ = (void *) data;
+}
+
+unsigned int MidiOutAlsaRaw :: getPortCount()
+{
+  std::vector<AlsaRawPort> ports;
+  alsaRawPorts( SND_RAWMIDI_STREAM_OUTPUT, ports );
+  return ports.size();
+}
+
+std::string MidiOutAlsaRaw :: getPortName( unsigned int portNumber )
+{
+  std::vector<AlsaRawPort> ports;
+  alsaRawPorts( SND_RAWMIDI_STREAM_OUTPUT, ports );
+  if ( portNumber < ports.size() )
+    return ports[portNumber].name;
+
+  // If we get here, we didn't find a match.
+  errorString_ = "MidiOutAlsaRaw::getPortName: error looking for port name!";
+  error( RtMidiError::WARNING, errorString_ );
+  return std::string();
+}
+
+void MidiOutAlsaRaw :: getPortNames( std::vector<std::string> &names )
+{
+  std::vector<AlsaRawPort> ports;
+  alsaRawPorts( SND_RAWMIDI_STREAM_OUTPUT, ports );
+  names.resize( ports.size() );
+  for ( unsigned int i=0; i<ports.size(); i++ ) names[i] = ports[i].name;
+}
+
+void MidiOutAlsaRaw :: openPort( unsigned int portNumber, const std::string /*portName*/ )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiOutAlsaRaw::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  std::vector<AlsaRawPort> ports;
+  alsaRawPorts( SND_RAWMIDI_STREAM_OUTPUT, ports );
+  if ( ports.size() < 1 ) {
+    errorString_ = "MidiOutAlsaRaw::openPort: no MIDI output destinations found!";
+    error( RtMidiError::NO_DEVICES_FOUND, errorString_ );
+    return;
+  }
+  if ( portNumber >= ports.size() ) {
+    std::ostringstream ost;
+    ost << "MidiOutAlsaRaw::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+
+  // Open non-blocking so that a busy device is reported instead of
+  // waited for, then write in blocking mode.
+  AlsaRawMidiData *data = static_cast<AlsaRawMidiData *> (apiData_);
+  if ( snd_rawmidi_open( NULL, &data->handle, ports[portNumber].device.c_str(), SND_RAWMIDI_NONBLOCK ) < 0 ) {
+    data->handle = 0;
+    errorString_ = "MidiOutAlsaRaw::openPort: error opening ALSA rawmidi device " + ports[portNumber].device + " (is it in use?).";
+    error( RtMidiError::DRIVER_ERROR, errorString_ );
+    return;
+  }
+  snd_rawmidi_nonblock( data->handle, 0 );
+
+  connected_ = true;
+}
+
+void MidiOutAlsaRaw :: openVirtualPort( const std::string /*portName*/ )
+{
+  // This function cannot be implemented for the ALSA rawmidi API.
+  errorString_ = "MidiOutAlsaRaw::openVirtualPort: cannot be implemented in ALSA rawmidi API!";
+  error( RtMidiError::WARNING, errorString_ );
+}
+
+void MidiOutAlsaRaw :: closePort( void )
+{
+  if ( connected_ ) {
+    AlsaRawMidiData *data = static_cast<AlsaRawMidiData *> (apiData_);
+    snd_rawmidi_close( data->handle );
+    data->handle = 0;
+    connected_ = false;
+  }
+}
+
+void MidiOutAlsaRaw :: sendMessage( std::vector<unsigned char> *message )
+{
+  if ( !connected_ ) return;
+
+  unsigned int nBytes = message->size();
+  if ( nBytes == 0 ) {
+    errorString_ = "MidiOutAlsaRaw::sendMessage: message argument is empty!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  AlsaRawMidiData *data = static_cast<AlsaRawMidiData *> (apiData_);
+  ssize_t result = snd_rawmidi_write( data->handle, &message->at(0), nBytes );
+  if ( result < (ssize_t)nBytes ) {
+    errorString_ = "MidiOutAlsaRaw::sendMessage: error sending MIDI message to port.";
+    error( RtMidiError::WARNING, errorString_ );
+  }
+}
+
+#endif // __LINUX_ALSA__
+
+
+//*********************************************************************//
+//  API: Windows Multimedia Library (MM)
+//*********************************************************************//
+
+// API information deciphered from:
+//  - http://msdn.microsoft.com/library/default.asp?url=/library/en-us/multimed/htm/_win32_midi_reference.asp
+
+// Thanks to Jean-Baptiste Berruchon for the sysex code.
+
+#if defined(__WINDOWS_MM__)
+
+// The Windows MM API is based on the use of a callback function for
+// MIDI input.  We convert the system specific time stamps to delta
+// time values.
 
 // Windows MM MIDI header files.
 #include <windows.h>
@@ -1947,6 +3732,7 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
                                         DWORD timestamp )
 {
   if ( inputStatus != MIM_DATA && inputStatus != MIM_LONGDATA && inputStatus != MIM_LONGERROR ) return;
+  midiTrace( MIDI_TRACE_INGRESS, inputStatus );
 
   //MidiInApi::RtMidiInData *data = static_cast<MidiInApi::RtMidiInData *> (instancePtr);
   MidiInApi::RtMidiInData *data = (MidiInApi::RtMidiInData *)instancePtr;
@@ -2019,9 +3805,12 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
     else return;
   }
 
-  if ( data->usingCallback ) {
+  midiTrace( MIDI_TRACE_DECODE, apiData->message.bytes.empty() ? 0 : apiData->message.bytes[0] );
+  data->countReceived();
+  if ( data->enterCallback() ) {
     RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
     callback( apiData->message.timeStamp, &apiData->message.bytes, data->userData );
+    data->leaveCallback();
   }
   else {
     // As long as we haven't reached our queue size limit, push the message.
@@ -2030,9 +3819,12 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
       if ( data->queue.back == data->queue.ringSize )
         data->queue.back = 0;
       data->queue.size++;
+      data->countQueued();
     }
-    else
+    else {
+      data->countQueueDrop();
       std::cerr << "\nRtMidiIn: message queue limit reached!!\n\n";
+    }
   }
 
   // Clear the vector for the next input message.
@@ -2434,6 +4226,8 @@ void MidiOutWinMM :: sendMessage( std::vector<unsigned char> *message )
 
 #if defined(__UNIX_JACK__)
 
+#include <cstring>
+
 // JACK header files
 #include <jack/jack.h>
 #include <jack/midiport.h>
@@ -2448,8 +4242,63 @@ struct JackMidiData {
   jack_ringbuffer_t *buffMessage;
   jack_time_t lastTime;
   MidiInApi :: RtMidiInData *rtMidiIn;
+  // Set and cancelled by the user thread, called from the JACK
+  // notification thread.
+  std::atomic<RtMidiPortCallback> portCallback;
+  std::atomic<void *> portUserData;
+  // Odd while the notification thread is inside the port callback, so
+  // that cancelling it can wait for the call in flight (see
+  // RtMidiInData::waitCallbacks).
+  std::atomic<unsigned long long> portEpoch;
   };
 
+static void jackPortCallbackInit( JackMidiData *data )
+{
+  data->portCallback.store( 0 );
+  data->portUserData.store( 0 );
+  data->portEpoch.store( 0 );
+}
+
+static void jackSetPortCallback( JackMidiData *data, RtMidiPortCallback callback, void *userData )
+{
+  data->portUserData.store( userData );
+  data->portCallback.store( callback );
+}
+
+// Must not be called from the port callback.
+static void jackCancelPortCallback( JackMidiData *data )
+{
+  data->portCallback.store( 0 );
+  // Grace period: a notification that got the callback before it was
+  // cleared ends with the next epoch increment.
+  unsigned long long current = data->portEpoch.load();
+  if ( current & 1 ) {
+    while ( data->portEpoch.load() == current )
+      std::this_thread::yield();
+  }
+  data->portUserData.store( 0 );
+}
+
+// Port registration callback (called by JACK from its notification
+// thread), forwarding MIDI port additions and removals to the user.
+static void jackPortRegistration( jack_port_id_t portId, int registered, void *arg )
+{
+  JackMidiData *data = (JackMidiData *) arg;
+  data->portEpoch.fetch_add( 1 );
+  RtMidiPortCallback callback = data->portCallback.load();
+  jack_port_t *port = callback ? jack_port_by_id( data->client, portId ) : NULL;
+  if ( port != NULL && strcmp( jack_port_type( port ), JACK_DEFAULT_MIDI_TYPE ) == 0 ) {
+    RtMidiPortEvent event;
+    event.type = registered ? RtMidiPortEvent::PORT_ADDED : RtMidiPortEvent::PORT_REMOVED;
+    int flags = jack_port_flags( port );
+    event.isInput = ( flags & JackPortIsOutput ) != 0;
+    event.isOutput = ( flags & JackPortIsInput ) != 0;
+    event.portName = jack_port_name( port );
+    callback( event, data->portUserData.load() );
+  }
+  data->portEpoch.fetch_add( 1 );
+}
+
 //*********************************************************************//
 //  API: JACK
 //  Class Definitions: MidiInJack
@@ -2473,6 +4322,7 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
     message.bytes.clear();
 
     jack_midi_event_get( &event, buff, j );
+    midiTrace( MIDI_TRACE_INGRESS, (unsigned int) event.size );
 
     for ( unsigned int i = 0; i < event.size; i++ )
       message.bytes.push_back( event.buffer[i] );
@@ -2487,9 +4337,12 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
     jData->lastTime = time;
 
     if ( !rtData->continueSysex ) {
-      if ( rtData->usingCallback ) {
+      midiTrace( MIDI_TRACE_DECODE, message.bytes.empty() ? 0 : message.bytes[0] );
+      rtData->countReceived();
+      if ( rtData->enterCallback() ) {
         RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) rtData->userCallback;
         callback( message.timeStamp, &message.bytes, rtData->userData );
+        rtData->leaveCallback();
       }
       else {
         // As long as we haven't reached our queue size limit, push the message.
@@ -2498,9 +4351,12 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
           if ( rtData->queue.back == rtData->queue.ringSize )
             rtData->queue.back = 0;
           rtData->queue.size++;
+          rtData->countQueued();
         }
-        else
+        else {
+          rtData->countQueueDrop();
           std::cerr << "\nMidiInJack: message queue limit reached!!\n\n";
+        }
       }
     }
   }
@@ -2521,6 +4377,7 @@ void MidiInJack :: initialize( const std::string& clientName )
   data->rtMidiIn = &inputData_;
   data->port = NULL;
   data->client = NULL;
+  jackPortCallbackInit( data );
   this->clientName = clientName;
 
   connect();
@@ -2540,6 +4397,7 @@ void MidiInJack :: connect()
   }
 
   jack_set_process_callback( data->client, jackProcessIn, data );
+  jack_set_port_registration_callback( data->client, jackPortRegistration, data );
   jack_activate( data->client );
 }
 
@@ -2640,6 +4498,23 @@ std::string MidiInJack :: getPortName( unsigned int portNumber )
   return retStr;
 }
 
+void MidiInJack :: setPortCallback( RtMidiPortCallback callback, void *userData )
+{
+  JackMidiData *data = static_cast<JackMidiData *> (apiData_);
+  connect();
+  if ( !data->client || !callback ) {
+    errorString_ = "MidiInJack::setPortCallback: no JACK client or invalid callback function!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+  jackSetPortCallback( data, callback, userData );
+}
+
+void MidiInJack :: cancelPortCallback( void )
+{
+  jackCancelPortCallback( static_cast<JackMidiData *> (apiData_) );
+}
+
 void MidiInJack :: closePort()
 {
   JackMidiData *data = static_cast<JackMidiData *> (apiData_);
@@ -2689,6 +4564,7 @@ void MidiOutJack :: initialize( const std::string& clientName )
 
   data->port = NULL;
   data->client = NULL;
+  jackPortCallbackInit( data );
   this->clientName = clientName;
 
   connect();
@@ -2708,6 +4584,7 @@ void MidiOutJack :: connect()
   }
 
   jack_set_process_callback( data->client, jackProcessOut, data );
+  jack_set_port_registration_callback( data->client, jackPortRegistration, data );
   data->buffSize = jack_ringbuffer_create( JACK_RINGBUFFER_SIZE );
   data->buffMessage = jack_ringbuffer_create( JACK_RINGBUFFER_SIZE );
   jack_activate( data->client );
@@ -2816,6 +4693,23 @@ std::string MidiOutJack :: getPortName( unsigned int portNumber )
   return retStr;
 }
 
+void MidiOutJack :: setPortCallback( RtMidiPortCallback callback, void *userData )
+{
+  JackMidiData *data = static_cast<JackMidiData *> (apiData_);
+  connect();
+  if ( !data->client || !callback ) {
+    errorString_ = "MidiOutJack::setPortCallback: no JACK client or invalid callback function!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+  jackSetPortCallback( data, callback, userData );
+}
+
+void MidiOutJack :: cancelPortCallback( void )
+{
+  jackCancelPortCallback( static_cast<JackMidiData *> (apiData_) );
+}
+
 void MidiOutJack :: closePort()
 {
   JackMidiData *data = static_cast<JackMidiData *> (apiData_);
@@ -2837,3 +4731,517 @@ void MidiOutJack :: sendMessage( std::vector<unsigned char> *message )
 }
 
 #endif  // __UNIX_JACK__
+
+
+//*********************************************************************//
+//  API: LOOPBACK
+//*********************************************************************//
+
+// The loopback API is written with the standard library only, so that
+// it is available on every platform.  An output port pushes each message
+// in the lock-free queue of each input opened on the same port; a thread
+// per input pops them and delivers them like the other APIs do.
+
+#if defined(__RTMIDI_LOOPBACK__)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#define LOOPBACK_QUEUE_SIZE 1024 // per input port, a power of two
+
+struct LoopbackEvent {
+  unsigned long long time; // steady clock, in nanoseconds
+  std::vector<unsigned char> bytes;
+};
+
+// Bounded multiple producers / single consumer queue.  Each cell carries
+// a sequence number telling whether it is free for the producer holding
+// the matching position or filled for the consumer.  The cells keep
+// their byte vectors, so no memory is allocated once they have grown.
+struct LoopbackQueue {
+  struct Cell {
+    std::atomic<unsigned int> sequence;
+    LoopbackEvent event;
+  };
+
+  Cell cells[LOOPBACK_QUEUE_SIZE];
+  std::atomic<unsigned int> enqueuePos;
+  unsigned int dequeuePos;
+
+  LoopbackQueue() : enqueuePos(0), dequeuePos(0) {
+    for ( unsigned int i=0; i<LOOPBACK_QUEUE_SIZE; i++ )
+      cells[i].sequence.store( i, std::memory_order_relaxed );
+  }
+
+  bool push( unsigned long long time, const std::vector<unsigned char> &bytes ) {
+    Cell *cell;
+    unsigned int pos = enqueuePos.load( std::memory_order_relaxed );
+    while ( true ) {
+      cell = &cells[pos & ( LOOPBACK_QUEUE_SIZE - 1 )];
+      int diff = (int) ( cell->sequence.load( std::memory_order_acquire ) - pos );
+      if ( diff == 0 ) {
+        if ( enqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) break;
+      }
+      else if ( diff < 0 ) return false; // full
+      else pos = enqueuePos.load( std::memory_order_relaxed );
+    }
+    cell->event.time = time;
+    cell->event.bytes.assign( bytes.begin(), bytes.end() );
+    cell->sequence.store( pos + 1, std::memory_order_release );
+    return true;
+  }
+
+  // The event is swapped out of the cell, which keeps the previous
+  // buffer of the caller.
+  bool pop( LoopbackEvent &event ) {
+    Cell *cell = &cells[dequeuePos & ( LOOPBACK_QUEUE_SIZE - 1 )];
+    if ( (int) ( cell->sequence.load( std::memory_order_acquire ) - ( dequeuePos + 1 ) ) < 0 ) return false;
+    event.time = cell->event.time;
+    event.bytes.swap( cell->event.bytes );
+    cell->sequence.store( dequeuePos + LOOPBACK_QUEUE_SIZE, std::memory_order_release );
+    dequeuePos++;
+    return true;
+  }
+};
+
+// The receiving side of an input port.
+struct LoopbackInput {
+  LoopbackQueue queue;
+  std::mutex mutex;                // only used to sleep and wake up
+  std::condition_variable wakeup;
+  std::atomic<bool> sleeping;
+  std::atomic<bool> running;
+  std::atomic<unsigned long long> overruns; // pushes refused while full, moved to the stats by the delivery thread
+  std::atomic<bool> overrunning;           // the last push was refused, warned once until one succeeds
+  std::thread thread;
+
+  LoopbackInput() : sleeping(false), running(false), overruns(0), overrunning(false) {}
+
+  // Called by the senders after a push.  The fence pairs with the one
+  // of the delivery thread going to sleep: either the sender sees it
+  // sleeping, or the thread sees the pushed event.
+  void notify( void ) {
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if ( sleeping.load() ) {
+      std::lock_guard<std::mutex> lock( mutex );
+      wakeup.notify_one();
+    }
+  }
+};
+
+typedef std::vector< std::shared_ptr<LoopbackInput> > LoopbackInputList;
+
+// A port.  The list of inputs is replaced as a whole when it changes,
+// so that senders read it without locking.
+struct LoopbackPort {
+  std::string name;
+  MidiApi *owner; // the instance which created a virtual port, 0 for the default one
+  std::shared_ptr<const LoopbackInputList> inputs;
+
+  LoopbackPort( const std::string &portName, MidiApi *creator )
+    : name( portName ), owner( creator ), inputs( new LoopbackInputList ) {}
+};
+
+static std::mutex loopbackMutex; // protects loopbackPorts and the changes of the input lists
+static std::vector< std::shared_ptr<LoopbackPort> > loopbackPorts( 1, std::make_shared<LoopbackPort>( "RtMidi Loopback", (MidiApi *) 0 ) );
+
+static unsigned long long loopbackTime( void )
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static std::shared_ptr<LoopbackPort> loopbackPort( unsigned int portNumber )
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  if ( portNumber < loopbackPorts.size() ) return loopbackPorts[portNumber];
+  return std::shared_ptr<LoopbackPort>();
+}
+
+static void loopbackPortNames( std::vector<std::string> &names )
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  names.resize( loopbackPorts.size() );
+  for ( unsigned int i=0; i<loopbackPorts.size(); i++ ) names[i] = loopbackPorts[i]->name;
+}
+
+static std::shared_ptr<LoopbackPort> loopbackCreatePort( const std::string &portName, MidiApi *owner )
+{
+  std::shared_ptr<LoopbackPort> port = std::make_shared<LoopbackPort>( portName, owner );
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  loopbackPorts.push_back( port );
+  return port;
+}
+
+// Remove the virtual port created by the given instance, if any.
+static void loopbackRemovePort( MidiApi *owner )
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  for ( unsigned int i=1; i<loopbackPorts.size(); i++ ) {
+    if ( loopbackPorts[i]->owner == owner ) {
+      loopbackPorts.erase( loopbackPorts.begin() + i );
+      return;
+    }
+  }
+}
+
+static void loopbackConnect( LoopbackPort *port, const std::shared_ptr<LoopbackInput> &input, bool connect )
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  std::shared_ptr<LoopbackInputList> inputs( new LoopbackInputList( *std::atomic_load( &port->inputs ) ) );
+  if ( connect ) inputs->push_back( input );
+  else {
+    for ( unsigned int i=0; i<inputs->size(); i++ ) {
+      if ( (*inputs)[i] == input ) {
+        inputs->erase( inputs->begin() + i );
+        break;
+      }
+    }
+  }
+  std::atomic_store( &port->inputs, std::shared_ptr<const LoopbackInputList>( inputs ) );
+}
+
+struct LoopbackInData {
+  std::shared_ptr<LoopbackInput> input;
+  std::shared_ptr<LoopbackPort> port;
+  unsigned long long lastTime;
+};
+
+struct LoopbackOutData {
+  std::shared_ptr<LoopbackPort> port;
+};
+
+static void loopbackMidiHandler( MidiInApi::RtMidiInData *data )
+{
+  LoopbackInData *apiData = static_cast<LoopbackInData *> (data->apiData);
+  LoopbackInput *input = apiData->input.get();
+  LoopbackEvent event;
+  MidiInApi::MidiMessage message;
+
+  while ( input->running.load() ) {
+    if ( !input->queue.pop( event ) ) {
+      std::unique_lock<std::mutex> lock( input->mutex );
+      input->sleeping.store( true );
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+      // Check again now that the senders know they must wake us up.
+      while ( input->running.load() && !input->queue.pop( event ) )
+        input->wakeup.wait( lock );
+      input->sleeping.store( false );
+      if ( !input->running.load() ) break;
+    }
+    midiTrace( MIDI_TRACE_INGRESS, (unsigned int) event.bytes.size() );
+    if ( input->overruns.load( std::memory_order_relaxed ) )
+      data->overruns.fetch_add( input->overruns.exchange( 0 ), std::memory_order_relaxed );
+
+    unsigned char status = event.bytes.empty() ? 0 : event.bytes[0];
+    if ( status == 0 ) continue;
+    if ( ( status == 0xF0 && ( data->ignoreFlags & 0x01 ) ) ||
+         ( ( status == 0xF1 || status == 0xF8 ) && ( data->ignoreFlags & 0x02 ) ) ||
+         ( status == 0xFE && ( data->ignoreFlags & 0x04 ) ) )
+      continue;
+
+    message.bytes.swap( event.bytes );
+    message.timeStamp = 0.0;
+    if ( data->firstMessage == true )
+      data->firstMessage = false;
+    else
+      message.timeStamp = ( event.time - apiData->lastTime ) * 0.000000001;
+    apiData->lastTime = event.time;
+
+    midiTrace( MIDI_TRACE_DECODE, message.bytes.empty() ? 0 : message.bytes[0] );
+    data->countReceived();
+    if ( data->enterCallback() ) {
+      RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
+      callback( message.timeStamp, &message.bytes, data->userData );
+      data->leaveCallback();
+    }
+    else {
+      // As long as we haven't reached our queue size limit, push the message.
+      if ( data->queue.size < data->queue.ringSize ) {
+        data->queue.ring[data->queue.back++] = message;
+        if ( data->queue.back == data->queue.ringSize )
+          data->queue.back = 0;
+        data->queue.size++;
+        data->countQueued();
+      }
+      else {
+        data->countQueueDrop();
+        std::cerr << "\nMidiInLoopback: message queue limit reached!!\n\n";
+      }
+    }
+    message.bytes.swap( event.bytes );
+  }
+}
+
+// Start the delivery thread of an input and connect it to the given port.
+static bool loopbackStartInput( MidiInApi::RtMidiInData *inputData, const std::shared_ptr<LoopbackPort> &port )
+{
+  LoopbackInData *data = static_cast<LoopbackInData *> (inputData->apiData);
+  data->input = std::make_shared<LoopbackInput>();
+  data->port = port;
+  inputData->firstMessage = true;
+
+  inputData->doInput = true;
+  data->input->running.store( true );
+  try {
+    data->input->thread = std::thread( loopbackMidiHandler, inputData );
+  }
+  catch ( std::exception & ) {
+    inputData->doInput = false;
+    data->input.reset();
+    data->port.reset();
+    return false;
+  }
+  loopbackConnect( port.get(), data->input, true );
+  return true;
+}
+
+//*********************************************************************//
+//  API: LOOPBACK
+//  Class Definitions: MidiInLoopback
+//*********************************************************************//
+
+MidiInLoopback :: MidiInLoopback( const std::string clientName, unsigned int queueSizeLimit ) : MidiInApi( queueSizeLimit )
+{
+  initialize( clientName );
+}
+
+MidiInLoopback :: ~MidiInLoopback()
+{
+  // Close a connection if it exists.
+  closePort();
+
+  // Cleanup.
+  LoopbackInData *data = static_cast<LoopbackInData *> (apiData_);
+  loopbackRemovePort( this );
+  delete data;
+}
+
+void MidiInLoopback :: initialize( const std::string& /*clientName*/ )
+{
+  // Save our api-specific connection information.
+  LoopbackInData *data = new LoopbackInData;
+  data->lastTime = 0;
+  apiData_ = (void *) data;
+  inputData_.apiData = (void *) data;
+}
+
+unsigned int MidiInLoopback :: getPortCount()
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  return loopbackPorts.size();
+}
+
+std::string MidiInLoopback :: getPortName( unsigned int portNumber )
+{
+  std::shared_ptr<LoopbackPort> port = loopbackPort( portNumber );
+  if ( port ) return port->name;
+
+  // If we get here, we didn't find a match.
+  errorString_ = "MidiInLoopback::getPortName: error looking for port name!";
+  error( RtMidiError::WARNING, errorString_ );
+  return std::string();
+}
+
+void MidiInLoopback :: getPortNames( std::vector<std::string> &names )
+{
+  loopbackPortNames( names );
+}
+
+void MidiInLoopback :: openPort( unsigned int portNumber, const std::string /*portName*/ )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiInLoopback::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  std::shared_ptr<LoopbackPort> port = loopbackPort( portNumber );
+  if ( !port ) {
+    std::ostringstream ost;
+    ost << "MidiInLoopback::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+
+  if ( !loopbackStartInput( &inputData_, port ) ) {
+    errorString_ = "MidiInLoopback::openPort: error starting MIDI input thread!";
+    error( RtMidiError::THREAD_ERROR, errorString_ );
+    return;
+  }
+
+  connected_ = true;
+}
+
+void MidiInLoopback :: openVirtualPort( const std::string portName )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiInLoopback::openVirtualPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  std::shared_ptr<LoopbackPort> port = loopbackCreatePort( portName, this );
+  if ( !loopbackStartInput( &inputData_, port ) ) {
+    loopbackRemovePort( this );
+    errorString_ = "MidiInLoopback::openVirtualPort: error starting MIDI input thread!";
+    error( RtMidiError::THREAD_ERROR, errorString_ );
+    return;
+  }
+
+  connected_ = true;
+}
+
+void MidiInLoopback :: closePort( void )
+{
+  LoopbackInData *data = static_cast<LoopbackInData *> (apiData_);
+
+  if ( connected_ ) {
+    loopbackConnect( data->port.get(), data->input, false );
+
+    // Stop thread to avoid triggering the callback, while the port is intended to be closed
+    inputData_.doInput = false;
+    data->input->running.store( false );
+    {
+      std::lock_guard<std::mutex> lock( data->input->mutex );
+      data->input->wakeup.notify_one();
+    }
+    data->input->thread.join();
+
+    // Senders may still hold the input for a while, the queue goes with it.
+    data->input.reset();
+    data->port.reset();
+    loopbackRemovePort( this );
+    connected_ = false;
+  }
+}
+
+//*********************************************************************//
+//  API: LOOPBACK
+//  Class Definitions: MidiOutLoopback
+//*********************************************************************//
+
+MidiOutLoopback :: MidiOutLoopback( const std::string clientName ) : MidiOutApi()
+{
+  initialize( clientName );
+}
+
+MidiOutLoopback :: ~MidiOutLoopback()
+{
+  // Close a connection if it exists.
+  closePort();
+
+  // Cleanup.
+  LoopbackOutData *data = static_cast<LoopbackOutData *> (apiData_);
+  loopbackRemovePort( this );
+  delete data;
+}
+
+void MidiOutLoopback :: initialize( const std::string& /*clientName*/ )
+{
+  // Save our api-specific connection information.
+  LoopbackOutData *data = new LoopbackOutData;
+  apiData_ = (void *) data;
+}
+
+unsigned int MidiOutLoopback :: getPortCount()
+{
+  std::lock_guard<std::mutex> lock( loopbackMutex );
+  return loopbackPorts.size();
+}
+
+std::string MidiOutLoopback :: getPortName( unsigned int portNumber )
+{
+  std::shared_ptr<LoopbackPort> port = loopbackPort( portNumber );
+  if ( port ) return port->name;
+
+  // If we get here, we didn't find a match.
+  errorString_ = "MidiOutLoopback::getPortName: error looking for port name!";
+  error( RtMidiError::WARNING, errorString_ );
+  return std::string();
+}
+
+void MidiOutLoopback :: getPortNames( std::vector<std::string> &names )
+{
+  loopbackPortNames( names );
+}
+
+void MidiOutLoopback :: openPort( unsigned int portNumber, const std::string /*portName*/ )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiOutLoopback::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  std::shared_ptr<LoopbackPort> port = loopbackPort( portNumber );
+  if ( !port ) {
+    std::ostringstream ost;
+    ost << "MidiOutLoopback::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+
+  LoopbackOutData *data = static_cast<LoopbackOutData *> (apiData_);
+  data->port = port;
+  connected_ = true;
+}
+
+void MidiOutLoopback :: openVirtualPort( const std::string portName )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiOutLoopback::openVirtualPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  LoopbackOutData *data = static_cast<LoopbackOutData *> (apiData_);
+  data->port = loopbackCreatePort( portName, this );
+  connected_ = true;
+}
+
+void MidiOutLoopback :: closePort( void )
+{
+  if ( connected_ ) {
+    LoopbackOutData *data = static_cast<LoopbackOutData *> (apiData_);
+    data->port.reset();
+    loopbackRemovePort( this );
+    connected_ = false;
+  }
+}
+
+void MidiOutLoopback :: sendMessage( std::vector<unsigned char> *message )
+{
+  if ( !connected_ ) return;
+
+  if ( message->size() == 0 ) {
+    errorString_ = "MidiOutLoopback::sendMessage: message argument is empty!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  LoopbackOutData *data = static_cast<LoopbackOutData *> (apiData_);
+  unsigned long long time = loopbackTime();
+  std::shared_ptr<const LoopbackInputList> inputs = std::atomic_load( &data->port->inputs );
+  for ( unsigned int i=0; i<inputs->size(); i++ ) {
+    LoopbackInput *input = (*inputs)[i].get();
+    if ( input->queue.push( time, *message ) ) {
+      if ( input->overrunning.load( std::memory_order_relaxed ) )
+        input->overrunning.store( false, std::memory_order_relaxed );
+      input->notify();
+    }
+    else {
+      // The drops are counted in the overruns, only warn when they start.
+      input->overruns.fetch_add( 1, std::memory_order_relaxed );
+      if ( !input->overrunning.exchange( true, std::memory_order_relaxed ) )
+        std::cerr << "\nMidiOutLoopback::sendMessage: input port queue full, dropping messages!\n\n";
+    }
+  }
+}
+
+#endif  // __RTMIDI_LOOPBACK__
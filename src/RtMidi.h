@@ -35,9 +35,6 @@
     WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 /**********************************************************************/
-#ifndef __WINDOWS_MM__
-	#define __WINDOWS_MM__
-#endif
 /*!
   \file RtMidi.h
  */
@@ -47,6 +44,22 @@
 
 #define RTMIDI_VERSION "2.1.0"
 
+// When no API is given to the compiler, pick the native ones of the
+// platform: Windows MM, CoreMIDI, or ALSA (sequencer and rawmidi) with
+// the loopback API on Linux.  JACK needs its library, so it is only
+// compiled when __UNIX_JACK__ is defined.
+#if !defined(__LINUX_ALSA__) && !defined(__UNIX_JACK__) && !defined(__MACOSX_CORE__) && !defined(__WINDOWS_MM__) && !defined(__RTMIDI_DUMMY__) && !defined(__RTMIDI_LOOPBACK__)
+  #if defined(_WIN32)
+    #define __WINDOWS_MM__
+  #elif defined(__APPLE__)
+    #define __MACOSX_CORE__
+  #elif defined(__linux__)
+    #define __LINUX_ALSA__
+    #define __RTMIDI_LOOPBACK__
+  #endif
+#endif
+
+#include <atomic>
 #include <exception>
 #include <iostream>
 #include <string>
@@ -113,6 +126,30 @@ class RtMidiError : public std::exception
  */
 typedef void (*RtMidiErrorCallback)( RtMidiError::Type type, const std::string &errorText );
 
+//! Description of a MIDI port that appeared or disappeared on the system.
+struct RtMidiPortEvent {
+  //! Kind of change.
+  enum Type {
+    PORT_ADDED,   /*!< A new port is available. */
+    PORT_REMOVED  /*!< A port is no longer available. */
+  };
+
+  Type type;
+  bool isInput;          /*!< The port is a MIDI source that RtMidiIn can open. */
+  bool isOutput;         /*!< The port is a MIDI destination that RtMidiOut can open. */
+  std::string portName;  /*!< The identifier getPortName() reports (or reported) for the port. */
+};
+
+//! RtMidi port (hot-plug) notification callback function prototype.
+/*!
+    \param event The port that was added or removed.
+    \param userData The pointer given to setPortCallback().
+
+    The callback is invoked from a backend notification thread.  It
+    must return quickly and must not set or cancel port callbacks.
+ */
+typedef void (*RtMidiPortCallback)( const RtMidiPortEvent &event, void *userData );
+
 class MidiApi;
 
 class RtMidi
@@ -126,7 +163,9 @@ class RtMidi
     LINUX_ALSA,     /*!< The Advanced Linux Sound Architecture API. */
     UNIX_JACK,      /*!< The JACK Low-Latency MIDI Server API. */
     WINDOWS_MM,     /*!< The Microsoft Multimedia MIDI API. */
-    RTMIDI_DUMMY    /*!< A compilable but non-functional API. */
+    RTMIDI_DUMMY,   /*!< Obsolete, now the same as LOOPBACK. */
+    LINUX_ALSA_RAW, /*!< The ALSA rawmidi API: direct hardware access, bypassing the sequencer. */
+    LOOPBACK        /*!< An in-process API whose output ports feed its input ports. */
   };
 
   //! A static function to determine the current RtMidi version.
@@ -152,6 +191,25 @@ class RtMidi
   //! Pure virtual getPortName() function.
   virtual std::string getPortName( unsigned int portNumber = 0 ) = 0;
 
+  //! Fill \e names with the identifiers of all the available ports, indexed by port number.
+  /*!
+    This is equivalent to calling getPortName() for every port number
+    below getPortCount(), but the list is taken in a single pass and is
+    consistent even if devices are added or removed meanwhile.
+  */
+  void getPortNames( std::vector<std::string> &names );
+
+  //! Set a callback function to be invoked when MIDI ports are added or removed (Linux ALSA and JACK only).
+  /*!
+    Events are reported for the ports of both directions, see
+    RtMidiPortEvent.  Only one port callback can be set per instance.
+    A warning is issued for the APIs without hot-plug notifications.
+  */
+  void setPortCallback( RtMidiPortCallback callback, void *userData = 0 );
+
+  //! Cancel use of the current port callback function (if one exists).
+  void cancelPortCallback( void );
+
   //! Pure virtual closePort() function.
   virtual void closePort( void ) = 0;
 
@@ -212,6 +270,57 @@ class RtMidiIn : public RtMidi
   //! User callback function type definition.
   typedef void (*RtMidiCallback)( double timeStamp, std::vector<unsigned char> *message, void *userData);
 
+  //! Flags describing the position of a chunk passed to an RtMidiSysexCallback.
+  enum SysexFlags {
+    SYSEX_START = 0x01,    /*!< The chunk begins a sysex message (starts with 0xF0). */
+    SYSEX_CONTINUE = 0x02, /*!< The chunk follows a previous chunk of the same message. */
+    SYSEX_END = 0x04       /*!< The chunk ends the message (ends with 0xF7). */
+  };
+
+  //! Streaming sysex callback function type definition.
+  /*!
+    \param timeStamp Delta time in seconds since the previous message or chunk.
+    \param data The chunk bytes, only valid during the call.
+    \param size The number of bytes in the chunk.
+    \param flags A combination of SysexFlags.
+    \param userData The pointer given to setSysexCallback().
+  */
+  typedef void (*RtMidiSysexCallback)( double timeStamp, const unsigned char *data, size_t size, int flags, void *userData );
+
+  //! Counters of the messages going through the input, kept for every API.
+  /*!
+    Messages ignored by ignoreTypes() or streamed to a sysex callback
+    are not counted.  An overrun means the backend itself lost an
+    unknown number of events before they could be read (ALSA -ENOSPC,
+    full loopback port queue).
+  */
+  struct InputStats {
+    unsigned long long received;   /*!< Messages passed to the callback or to the queue. */
+    unsigned long long queueDrops; /*!< Messages lost because the queue was full. */
+    unsigned long long overruns;   /*!< Backend buffer overruns. */
+    unsigned int queueHighWater;   /*!< Highest number of messages waiting in the queue. */
+  };
+
+  //! Counters kept by the low-latency (spin-then-sleep) input polling mode.
+  /*!
+    Latency values are the time between the backend timestamping an
+    event and the input thread picking it up, summed per wait path.
+    Comparing the spin and poll averages gives the latency gained,
+    while spinNanoseconds gives the CPU time spent to obtain it.
+  */
+  struct PollingStats {
+    unsigned long long spinHits;               /*!< Events picked up while spinning. */
+    unsigned long long spinMisses;             /*!< Spins that expired and fell back to poll(). */
+    unsigned long long pollWakeups;            /*!< Wakeups from a blocking poll(). */
+    unsigned long long spinNanoseconds;        /*!< Total time spent spinning (CPU cost). */
+    unsigned long long spinLatencyNanoseconds; /*!< Summed pickup latency of events caught while spinning. */
+    unsigned long long spinLatencyCount;       /*!< Number of events in spinLatencyNanoseconds. */
+    unsigned long long pollLatencyNanoseconds; /*!< Summed pickup latency of events delivered after a poll() wakeup. */
+    unsigned long long pollLatencyCount;       /*!< Number of events in pollLatencyNanoseconds. */
+    unsigned int maxSpinMicroseconds;          /*!< The configured spin budget (0 = disabled). */
+    unsigned int currentSpinMicroseconds;      /*!< The adaptive spin budget currently in use. */
+  };
+
   //! Default constructor that allows an optional api, client name and queue size.
   /*!
     An exception will be thrown if a MIDI system initialization
@@ -280,6 +389,19 @@ class RtMidiIn : public RtMidi
   */
   void cancelCallback();
 
+  //! Set a callback function receiving incoming sysex messages chunk by chunk, as they arrive (Linux ALSA only).
+  /*!
+    While set, sysex messages are no longer assembled nor passed to the
+    regular callback or queue.  Each chunk is handed over without being
+    copied, flagged with SysexFlags.  Sysex messages are delivered to this
+    callback even when ignored by ignoreTypes().  A warning is issued for
+    the APIs which do not support streaming.
+  */
+  void setSysexCallback( RtMidiSysexCallback callback, void *userData = 0 );
+
+  //! Cancel use of the current sysex callback function (if one exists).
+  void cancelSysexCallback();
+
   //! Close an open MIDI connection (if one exists).
   void closePort( void );
 
@@ -319,6 +441,33 @@ class RtMidiIn : public RtMidi
   */
   double getMessage( std::vector<unsigned char> *message );
 
+  //! Enable or disable the low-latency (spin-then-sleep) input polling mode (Linux ALSA only).
+  /*!
+    When no input is pending, the input thread busy-polls the backend
+    for up to \e maxSpinMicroseconds before falling back to a blocking
+    poll().  The spin budget adapts between 1/16 of the maximum and the
+    maximum depending on whether recent spins caught an event.  A value
+    of 0 (the default) disables spinning.  Calling this function resets
+    the polling statistics.  A warning is issued for other APIs.
+  */
+  void setSpinPolling( unsigned int maxSpinMicroseconds );
+
+  //! Fill \e stats with the counters of the spin-then-sleep polling mode.
+  /*!
+    \return false if the current API does not support the polling mode.
+  */
+  bool getPollingStats( PollingStats *stats );
+
+  //! Fill \e stats with the input counters.
+  /*!
+    The counters are updated by the input thread without locking and
+    may be read at any time.
+  */
+  void getInputStats( InputStats *stats );
+
+  //! Set the input counters back to zero.
+  void resetInputStats( void );
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is best
@@ -362,6 +511,24 @@ class RtMidiOut : public RtMidi
   RtMidiOut( RtMidi::Api api=UNSPECIFIED,
              const std::string clientName = std::string( "RtMidi Output Client") );
 
+  //! States of a sysex message sent with sendSysexAsync().
+  enum SysexStatus {
+    SYSEX_QUEUED,    /*!< Waiting for the messages queued before it. */
+    SYSEX_SENDING,   /*!< Partially sent. */
+    SYSEX_DONE,      /*!< Completely handed over to the MIDI system. */
+    SYSEX_CANCELLED, /*!< Cancelled by cancelSysex() or the destruction of the instance. */
+    SYSEX_FAILED,    /*!< The MIDI system refused the data. */
+    SYSEX_UNKNOWN    /*!< Unknown identifier, or finished too long ago. */
+  };
+
+  //! Asynchronous sysex progress callback function type definition.
+  /*!
+    Called from the sending thread after each chunk and once the
+    message is finished (status SYSEX_DONE, SYSEX_CANCELLED or
+    SYSEX_FAILED).  It must return quickly.
+  */
+  typedef void (*RtMidiSysexProgressCallback)( unsigned int id, size_t sent, size_t total, int status, void *userData );
+
   //! The destructor closes any open MIDI connections.
   ~RtMidiOut( void ) throw();
 
@@ -410,6 +577,41 @@ class RtMidiOut : public RtMidi
   */
   void sendMessage( std::vector<unsigned char> *message );
 
+  //! Queue a sysex message to be sent in the background, chunk by chunk (Linux ALSA only).
+  /*!
+    The message is copied and the function returns immediately.  A
+    sending thread splits it in chunks paced as set by
+    setSysexPacing(), waiting for room in the MIDI system output pool
+    between chunks, so large dumps neither block the caller nor
+    overrun slower receivers.  Messages are sent one after the other,
+    in order.  While any is queued, the messages given to sendMessage()
+    (but realtime ones, which go through at once) are held back and
+    sent after the sysex messages queued before them, so they never
+    split one and keep the order of the calls.
+
+    \return An identifier for getSysexStatus() and cancelSysex(), or
+    0 if the message could not be queued (a warning is issued).
+  */
+  unsigned int sendSysexAsync( const std::vector<unsigned char> &message,
+                               RtMidiSysexProgressCallback callback = 0, void *userData = 0 );
+
+  //! Set the chunk size in bytes and the minimum delay between two chunks of asynchronous sysex messages.
+  /*!
+    The defaults are 256 bytes and no delay, relying on the output
+    pool flow control only.  Over a 31250 baud MIDI cable, one byte
+    takes 320 microseconds.
+  */
+  void setSysexPacing( unsigned int chunkSize, unsigned int intervalMicroseconds );
+
+  //! Return the status of a message queued with sendSysexAsync(), optionally with its progress in bytes.
+  SysexStatus getSysexStatus( unsigned int id, size_t *sent = 0, size_t *total = 0 );
+
+  //! Cancel a message queued with sendSysexAsync(), or all of them if \e id is 0.
+  /*!
+    A message cancelled while partially sent is terminated with 0xF7.
+  */
+  void cancelSysex( unsigned int id = 0 );
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is best
@@ -448,6 +650,9 @@ class MidiApi
 
   virtual unsigned int getPortCount( void ) = 0;
   virtual std::string getPortName( unsigned int portNumber ) = 0;
+  virtual void getPortNames( std::vector<std::string> &names );
+  virtual void setPortCallback( RtMidiPortCallback callback, void *userData );
+  virtual void cancelPortCallback( void );
 
   inline bool isPortOpen() const { return connected_; }
   void setErrorCallback( RtMidiErrorCallback errorCallback );
@@ -474,6 +679,12 @@ class MidiInApi : public MidiApi
   void cancelCallback( void );
   virtual void ignoreTypes( bool midiSysex, bool midiTime, bool midiSense );
   double getMessage( std::vector<unsigned char> *message );
+  virtual void setSpinPolling( unsigned int maxSpinMicroseconds );
+  virtual bool getPollingStats( RtMidiIn::PollingStats *stats );
+  virtual void setSysexCallback( RtMidiIn::RtMidiSysexCallback callback, void *userData );
+  void cancelSysexCallback( void );
+  void getInputStats( RtMidiIn::InputStats *stats );
+  void resetInputStats( void );
 
   // A MIDI structure used internally by the class to store incoming
   // messages.  Each message represents one and only one MIDI message.
@@ -507,16 +718,57 @@ class MidiInApi : public MidiApi
     bool doInput;
     bool firstMessage;
     void *apiData;
-    bool usingCallback;
+    std::atomic<bool> usingCallback;
     RtMidiIn::RtMidiCallback userCallback;
     void *userData;
     bool continueSysex;
+    std::atomic<RtMidiIn::RtMidiSysexCallback> sysexCallback;
+    void *sysexUserData;
+
+    // Odd while the input thread is inside a user callback (message or
+    // sysex chunk), so that cancelling a callback can wait for the call
+    // in flight before its user data goes away (see waitCallbacks).
+    std::atomic<unsigned long long> callbackEpoch;
+
+    // Statistics, only written by the input thread (relaxed atomics
+    // so that they can be read from any other one).
+    std::atomic<unsigned long long> received;
+    std::atomic<unsigned long long> queueDrops;
+    std::atomic<unsigned long long> overruns;
+    std::atomic<unsigned int> queueHighWater;
 
     // Default constructor.
   RtMidiInData()
   : ignoreFlags(7), doInput(false), firstMessage(true),
       apiData(0), usingCallback(false), userCallback(0), userData(0),
-      continueSysex(false) {}
+      continueSysex(false), sysexCallback(0), sysexUserData(0), callbackEpoch(0),
+      received(0), queueDrops(0), overruns(0), queueHighWater(0) {}
+
+    // Bracket the user callback calls of the input thread: enterCallback
+    // returns false (and needs no leaveCallback) if the message callback
+    // was cancelled in the meantime.
+    bool enterCallback( void ) {
+      callbackEpoch.fetch_add( 1 );
+      if ( usingCallback.load() ) return true;
+      callbackEpoch.fetch_add( 1 );
+      return false;
+    }
+    void leaveCallback( void ) { callbackEpoch.fetch_add( 1 ); }
+    // Wait for the input thread to leave the callback it is in, if any.
+    // Must not be called from a callback.
+    void waitCallbacks( void );
+
+    // Account a message about to be passed to the callback or the queue.
+    void countReceived( void ) { received.fetch_add( 1, std::memory_order_relaxed ); }
+    // Account a message just pushed in the queue.
+    void countQueued( void ) {
+      if ( queue.size > queueHighWater.load( std::memory_order_relaxed ) )
+        queueHighWater.store( queue.size, std::memory_order_relaxed );
+    }
+    // Account a message lost because the queue is full.
+    void countQueueDrop( void ) { queueDrops.fetch_add( 1, std::memory_order_relaxed ); }
+    // Account a backend buffer overrun.
+    void countOverrun( void ) { overruns.fetch_add( 1, std::memory_order_relaxed ); }
   };
 
  protected:
@@ -530,6 +782,11 @@ class MidiOutApi : public MidiApi
   MidiOutApi( void );
   virtual ~MidiOutApi( void );
   virtual void sendMessage( std::vector<unsigned char> *message ) = 0;
+  virtual unsigned int sendSysexAsync( const std::vector<unsigned char> &message,
+                                       RtMidiOut::RtMidiSysexProgressCallback callback, void *userData );
+  virtual void setSysexPacing( unsigned int chunkSize, unsigned int intervalMicroseconds );
+  virtual RtMidiOut::SysexStatus getSysexStatus( unsigned int id, size_t *sent, size_t *total );
+  virtual void cancelSysex( unsigned int id );
 };
 
 // **************************************************************** //
@@ -549,6 +806,12 @@ inline unsigned int RtMidiIn :: getPortCount( void ) { return rtapi_->getPortCou
 inline std::string RtMidiIn :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiIn :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense ) { ((MidiInApi *)rtapi_)->ignoreTypes( midiSysex, midiTime, midiSense ); }
 inline double RtMidiIn :: getMessage( std::vector<unsigned char> *message ) { return ((MidiInApi *)rtapi_)->getMessage( message ); }
+inline void RtMidiIn :: setSpinPolling( unsigned int maxSpinMicroseconds ) { ((MidiInApi *)rtapi_)->setSpinPolling( maxSpinMicroseconds ); }
+inline bool RtMidiIn :: getPollingStats( PollingStats *stats ) { return ((MidiInApi *)rtapi_)->getPollingStats( stats ); }
+inline void RtMidiIn :: setSysexCallback( RtMidiSysexCallback callback, void *userData ) { ((MidiInApi *)rtapi_)->setSysexCallback( callback, userData ); }
+inline void RtMidiIn :: cancelSysexCallback( void ) { ((MidiInApi *)rtapi_)->cancelSysexCallback(); }
+inline void RtMidiIn :: getInputStats( InputStats *stats ) { ((MidiInApi *)rtapi_)->getInputStats( stats ); }
+inline void RtMidiIn :: resetInputStats( void ) { ((MidiInApi *)rtapi_)->resetInputStats(); }
 inline void RtMidiIn :: setErrorCallback( RtMidiErrorCallback errorCallback ) { rtapi_->setErrorCallback(errorCallback); }
 
 inline RtMidi::Api RtMidiOut :: getCurrentApi( void ) throw() { return rtapi_->getCurrentApi(); }
@@ -559,6 +822,10 @@ inline bool RtMidiOut :: isPortOpen() const { return rtapi_->isPortOpen(); }
 inline unsigned int RtMidiOut :: getPortCount( void ) { return rtapi_->getPortCount(); }
 inline std::string RtMidiOut :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiOut :: sendMessage( std::vector<unsigned char> *message ) { ((MidiOutApi *)rtapi_)->sendMessage( message ); }
+inline unsigned int RtMidiOut :: sendSysexAsync( const std::vector<unsigned char> &message, RtMidiSysexProgressCallback callback, void *userData ) { return ((MidiOutApi *)rtapi_)->sendSysexAsync( message, callback, userData ); }
+inline void RtMidiOut :: setSysexPacing( unsigned int chunkSize, unsigned int intervalMicroseconds ) { ((MidiOutApi *)rtapi_)->setSysexPacing( chunkSize, intervalMicroseconds ); }
+inline RtMidiOut::SysexStatus RtMidiOut :: getSysexStatus( unsigned int id, size_t *sent, size_t *total ) { return ((MidiOutApi *)rtapi_)->getSysexStatus( id, sent, total ); }
+inline void RtMidiOut :: cancelSysex( unsigned int id ) { ((MidiOutApi *)rtapi_)->cancelSysex( id ); }
 inline void RtMidiOut :: setErrorCallback( RtMidiErrorCallback errorCallback ) { rtapi_->setErrorCallback(errorCallback); }
 
 // **************************************************************** //
@@ -567,9 +834,14 @@ inline void RtMidiOut :: setErrorCallback( RtMidiErrorCallback errorCallback ) {
 //
 // **************************************************************** //
 
+// The loopback API is always available when no other API is compiled
+// (__RTMIDI_DUMMY__ is still accepted to ask for it).
 #if !defined(__LINUX_ALSA__) && !defined(__UNIX_JACK__) && !defined(__MACOSX_CORE__) && !defined(__WINDOWS_MM__)
   #define __RTMIDI_DUMMY__
 #endif
+#if defined(__RTMIDI_DUMMY__) && !defined(__RTMIDI_LOOPBACK__)
+  #define __RTMIDI_LOOPBACK__
+#endif
 
 #if defined(__MACOSX_CORE__)
 
@@ -621,6 +893,8 @@ class MidiInJack: public MidiInApi
   void closePort( void );
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
+  void setPortCallback( RtMidiPortCallback callback, void *userData );
+  void cancelPortCallback( void );
 
  protected:
   std::string clientName;
@@ -640,6 +914,8 @@ class MidiOutJack: public MidiOutApi
   void closePort( void );
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
+  void setPortCallback( RtMidiPortCallback callback, void *userData );
+  void cancelPortCallback( void );
   void sendMessage( std::vector<unsigned char> *message );
 
  protected:
@@ -664,6 +940,12 @@ class MidiInAlsa: public MidiInApi
   void closePort( void );
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
+  void getPortNames( std::vector<std::string> &names );
+  void setPortCallback( RtMidiPortCallback callback, void *userData );
+  void cancelPortCallback( void );
+  void setSpinPolling( unsigned int maxSpinMicroseconds );
+  bool getPollingStats( RtMidiIn::PollingStats *stats );
+  void setSysexCallback( RtMidiIn::RtMidiSysexCallback callback, void *userData );
 
  protected:
   void initialize( const std::string& clientName );
@@ -680,6 +962,49 @@ class MidiOutAlsa: public MidiOutApi
   void closePort( void );
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
+  void getPortNames( std::vector<std::string> &names );
+  void setPortCallback( RtMidiPortCallback callback, void *userData );
+  void cancelPortCallback( void );
+  void sendMessage( std::vector<unsigned char> *message );
+  unsigned int sendSysexAsync( const std::vector<unsigned char> &message,
+                               RtMidiOut::RtMidiSysexProgressCallback callback, void *userData );
+  void setSysexPacing( unsigned int chunkSize, unsigned int intervalMicroseconds );
+  RtMidiOut::SysexStatus getSysexStatus( unsigned int id, size_t *sent, size_t *total );
+  void cancelSysex( unsigned int id );
+
+ protected:
+  void initialize( const std::string& clientName );
+};
+
+class MidiInAlsaRaw: public MidiInApi
+{
+ public:
+  MidiInAlsaRaw( const std::string clientName, unsigned int queueSizeLimit );
+  ~MidiInAlsaRaw( void );
+  RtMidi::Api getCurrentApi( void ) { return RtMidi::LINUX_ALSA_RAW; };
+  void openPort( unsigned int portNumber, const std::string portName );
+  void openVirtualPort( const std::string portName );
+  void closePort( void );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+  void getPortNames( std::vector<std::string> &names );
+
+ protected:
+  void initialize( const std::string& clientName );
+};
+
+class MidiOutAlsaRaw: public MidiOutApi
+{
+ public:
+  MidiOutAlsaRaw( const std::string clientName );
+  ~MidiOutAlsaRaw( void );
+  RtMidi::Api getCurrentApi( void ) { return RtMidi::LINUX_ALSA_RAW; };
+  void openPort( unsigned int portNumber, const std::string portName );
+  void openVirtualPort( const std::string portName );
+  void closePort( void );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+  void getPortNames( std::vector<std::string> &names );
   void sendMessage( std::vector<unsigned char> *message );
 
  protected:
@@ -725,37 +1050,47 @@ class MidiOutWinMM: public MidiOutApi
 
 #endif
 
-#if defined(__RTMIDI_DUMMY__)
+#if defined(__RTMIDI_LOOPBACK__)
+
+// The loopback ports live in the process: everything sent to an output
+// port is received by the input ports opened on the same port number,
+// through a lock-free queue and a delivery thread, time stamped when
+// sent.  There is always one port, "RtMidi Loopback"; virtual ports add
+// more, shared by inputs and outputs.
 
-class MidiInDummy: public MidiInApi
+class MidiInLoopback: public MidiInApi
 {
  public:
- MidiInDummy( const std::string /*clientName*/, unsigned int queueSizeLimit ) : MidiInApi( queueSizeLimit ) { errorString_ = "MidiInDummy: This class provides no functionality."; error( RtMidiError::WARNING, errorString_ ); }
-  RtMidi::Api getCurrentApi( void ) { return RtMidi::RTMIDI_DUMMY; }
-  void openPort( unsigned int /*portNumber*/, const std::string /*portName*/ ) {}
-  void openVirtualPort( const std::string /*portName*/ ) {}
-  void closePort( void ) {}
-  unsigned int getPortCount( void ) { return 0; }
-  std::string getPortName( unsigned int portNumber ) { return ""; }
+  MidiInLoopback( const std::string clientName, unsigned int queueSizeLimit );
+  ~MidiInLoopback( void );
+  RtMidi::Api getCurrentApi( void ) { return RtMidi::LOOPBACK; };
+  void openPort( unsigned int portNumber, const std::string portName );
+  void openVirtualPort( const std::string portName );
+  void closePort( void );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+  void getPortNames( std::vector<std::string> &names );
 
  protected:
-  void initialize( const std::string& /*clientName*/ ) {}
+  void initialize( const std::string& clientName );
 };
 
-class MidiOutDummy: public MidiOutApi
+class MidiOutLoopback: public MidiOutApi
 {
  public:
-  MidiOutDummy( const std::string /*clientName*/ ) { errorString_ = "MidiOutDummy: This class provides no functionality."; error( RtMidiError::WARNING, errorString_ ); }
-  RtMidi::Api getCurrentApi( void ) { return RtMidi::RTMIDI_DUMMY; }
-  void openPort( unsigned int /*portNumber*/, const std::string /*portName*/ ) {}
-  void openVirtualPort( const std::string /*portName*/ ) {}
-  void closePort( void ) {}
-  unsigned int getPortCount( void ) { return 0; }
-  std::string getPortName( unsigned int /*portNumber*/ ) { return ""; }
-  void sendMessage( std::vector<unsigned char> * /*message*/ ) {}
+  MidiOutLoopback( const std::string clientName );
+  ~MidiOutLoopback( void );
+  RtMidi::Api getCurrentApi( void ) { return RtMidi::LOOPBACK; };
+  void openPort( unsigned int portNumber, const std::string portName );
+  void openVirtualPort( const std::string portName );
+  void closePort( void );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+  void getPortNames( std::vector<std::string> &names );
+  void sendMessage( std::vector<unsigned char> *message );
 
  protected:
-  void initialize( const std::string& /*clientName*/ ) {}
+  void initialize( const std::string& clientName );
 };
 
 #endif